@@ -50,6 +50,15 @@ double aabb::surface_area() const {
     return 2.0 * (x * y + y * z + z * x);
 }
 
+bool aabb::contains(const aabb& other) const {
+    for (int a = 0; a < 3; a++) {
+        if (other.minimum[a] < minimum[a] || other.maximum[a] > maximum[a]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 aabb surrounding_box(const aabb& box0, const aabb& box1) {
     point3 small(
         fmin(box0.min()[0], box1.min()[0]),
@@ -22,6 +22,9 @@ public:
     // Surface area of the box - useful for SAH (Surface Area Heuristic)
     double surface_area() const;
 
+    // True if `other` lies entirely inside this box
+    bool contains(const aabb& other) const;
+
 public:
     point3 minimum;
     point3 maximum;
@@ -0,0 +1,107 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Walker/Vose alias table for O(1) sampling of a discrete distribution
+ *
+ * Built once from a list of non-negative weights. Each sample costs one
+ * random number and two table lookups regardless of the number of entries,
+ * which keeps light selection cheap in scenes with thousands of emissive
+ * triangles.
+ */
+class alias_table {
+public:
+  alias_table() {}
+
+  /**
+   * @brief Build the table from (unnormalized) weights
+   * @param weights Per-entry weights; entries with weight <= 0 are never picked
+   */
+  void build(const std::vector<double> &weights) {
+    const size_t n = weights.size();
+    prob.assign(n, 0.0);
+    alias.assign(n, 0);
+    pmfs.assign(n, 0.0);
+
+    double total = 0.0;
+    for (double w : weights) {
+      total += std::max(w, 0.0);
+    }
+    if (n == 0 || total <= 0.0) {
+      prob.clear();
+      alias.clear();
+      pmfs.clear();
+      return;
+    }
+
+    // Scale weights so the average bucket holds exactly 1
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (size_t i = 0; i < n; i++) {
+      pmfs[i] = std::max(weights[i], 0.0) / total;
+      scaled[i] = pmfs[i] * static_cast<double>(n);
+      (scaled[i] < 1.0 ? small : large).push_back(static_cast<int>(i));
+    }
+
+    // Pair each underfull bucket with an overfull one
+    while (!small.empty() && !large.empty()) {
+      const int s = small.back();
+      small.pop_back();
+      const int l = large.back();
+      large.pop_back();
+
+      prob[s] = scaled[s];
+      alias[s] = l;
+      scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+      (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+
+    // Remaining buckets are full (up to rounding error)
+    for (int i : large) {
+      prob[i] = 1.0;
+      alias[i] = i;
+    }
+    for (int i : small) {
+      prob[i] = 1.0;
+      alias[i] = i;
+    }
+  }
+
+  bool empty() const { return prob.empty(); }
+
+  /**
+   * @brief Pick an entry
+   * @param u Uniform random number in [0,1)
+   * @param index Output entry index
+   * @param pmf Output probability of that entry
+   */
+  void sample(double u, int &index, double &pmf) const {
+    const double scaled = u * static_cast<double>(prob.size());
+    const size_t bucket =
+        std::min(static_cast<size_t>(scaled), prob.size() - 1);
+    const double remainder = scaled - static_cast<double>(bucket);
+    index = (remainder < prob[bucket]) ? static_cast<int>(bucket)
+                                       : alias[bucket];
+    pmf = pmfs[index];
+  }
+
+  /**
+   * @brief Probability of picking `index`
+   */
+  double pmf(int index) const {
+    if (index < 0 || index >= static_cast<int>(pmfs.size())) {
+      return 0.0;
+    }
+    return pmfs[index];
+  }
+
+private:
+  std::vector<double> prob; // Probability of keeping the bucket's own entry
+  std::vector<int> alias;   // Entry used otherwise
+  std::vector<double> pmfs; // Normalized weight of every entry
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "asset_cache.h"
+#include "image_texture.h"
+#include "mesh.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Size and modification time of a file, used to spot edits
+ */
+struct file_stamp {
+  uintmax_t size = 0;
+  int64_t mtime = 0;
+
+  bool operator==(const file_stamp &o) const {
+    return size == o.size && mtime == o.mtime;
+  }
+};
+
+file_stamp stamp_of(const std::string &path) {
+  std::error_code ec;
+  file_stamp s;
+  s.size = std::filesystem::file_size(path, ec);
+  if (ec)
+    return file_stamp();
+  auto time = std::filesystem::last_write_time(path, ec);
+  if (!ec)
+    s.mtime = time.time_since_epoch().count();
+  return s;
+}
+
+std::string canonical_path(const std::string &path) {
+  std::error_code ec;
+  auto p = std::filesystem::weakly_canonical(path, ec);
+  return ec ? path : p.string();
+}
+
+/**
+ * @brief Keyed map of shared assets where concurrent first requests for a
+ *        key wait on a single load
+ */
+template <typename Ptr> class asset_map {
+public:
+  template <typename Load>
+  Ptr get(std::mutex &mutex, const std::string &key, const file_stamp &stamp,
+          size_t &hits, size_t &loads, Load &&load) {
+    return get(mutex, key, stamp, hits, loads, std::forward<Load>(load),
+               [](const Ptr &) { return std::vector<std::string>(); });
+  }
+
+  // `depends(value)` lists further files a value was built from; the entry
+  // is also dropped when one of them changes, and they are recorded on
+  // every lookup, hits included
+  template <typename Load, typename Depends>
+  Ptr get(std::mutex &mutex, const std::string &key, const file_stamp &stamp,
+          size_t &hits, size_t &loads, Load &&load, Depends &&depends) {
+    std::promise<Ptr> promise;
+    std::shared_future<Ptr> future;
+    uint64_t id = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find(key);
+      if (it != entries.end() && it->second.stamp == stamp &&
+          unchanged(it->second.dependencies)) {
+        hits++;
+        future = it->second.value;
+      } else {
+        loads++;
+        id = ++next_id;
+        future = promise.get_future().share();
+        entries[key] = entry{stamp, future, id, {}};
+      }
+    }
+
+    Ptr value = id == 0 ? future.get() : load();
+    std::vector<std::string> files;
+    if (value)
+      files = depends(value);
+    for (const std::string &path : files)
+      asset_cache::record(path);
+    if (id == 0)
+      return value;
+
+    std::vector<std::pair<std::string, file_stamp>> dependencies;
+    for (const std::string &path : files)
+      dependencies.emplace_back(path, stamp_of(path));
+    promise.set_value(value);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.id == id) {
+      if (value)
+        it->second.dependencies = std::move(dependencies);
+      else
+        entries.erase(it); // Failed loads are not cached, the next
+                           // request tries again
+    }
+    return value;
+  }
+
+  // Drop finished entries nobody outside the cache holds any more
+  void trim(bool all) {
+    for (auto it = entries.begin(); it != entries.end();) {
+      const auto &value = it->second.value;
+      const bool ready = value.wait_for(std::chrono::seconds(0)) ==
+                         std::future_status::ready;
+      if (ready && (all || value.get().use_count() <= 1))
+        it = entries.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  void clear() { entries.clear(); }
+
+private:
+  struct entry {
+    file_stamp stamp;
+    std::shared_future<Ptr> value;
+    uint64_t id = 0;
+    std::vector<std::pair<std::string, file_stamp>> dependencies;
+  };
+
+  static bool
+  unchanged(const std::vector<std::pair<std::string, file_stamp>> &files) {
+    for (const auto &file : files) {
+      if (!(stamp_of(file.first) == file.second))
+        return false;
+    }
+    return true;
+  }
+
+  std::unordered_map<std::string, entry> entries;
+  uint64_t next_id = 0;
+};
+
+std::mutex g_asset_mutex;
+asset_map<std::shared_ptr<const obj_mesh_data>> g_objs;
+asset_map<std::shared_ptr<const mesh_geometry>> g_geometry;
+asset_map<std::shared_ptr<material>> g_materials;
+asset_map<std::shared_ptr<image_texture>> g_textures;
+asset_cache::statistics g_stats;
+asset_cache::recorder *g_recorder = nullptr;
+
+} // namespace
+
+std::shared_ptr<const obj_mesh_data> asset_cache::obj(const std::string &path,
+                                                      std::string &error) {
+  const std::string key = canonical_path(path);
+  std::string load_error;
+  record(key);
+  auto data = g_objs.get(g_asset_mutex, key, stamp_of(key), g_stats.obj_hits,
+                         g_stats.obj_loads,
+                         [&]() -> std::shared_ptr<const obj_mesh_data> {
+                           auto out = std::make_shared<obj_mesh_data>();
+                           if (!obj_reader::load(path, *out, load_error))
+                             return nullptr;
+                           return out;
+                         });
+  if (!data)
+    error = load_error.empty() ? "load failed" : load_error;
+  return data;
+}
+
+std::shared_ptr<const mesh_geometry> asset_cache::geometry(
+    const std::string &path, uint64_t options,
+    const std::function<std::shared_ptr<const mesh_geometry>()> &build) {
+  const std::string file = canonical_path(path);
+  const std::string key = file + '|' + std::to_string(options);
+  // Materials come from the MTL libraries, so edits to those invalidate
+  // the geometry as well
+  auto geometry = g_geometry.get(
+      g_asset_mutex, key, stamp_of(file), g_stats.geometry_hits,
+      g_stats.geometry_loads, build,
+      [](const std::shared_ptr<const mesh_geometry> &geometry) {
+        return geometry->mtlFiles;
+      });
+  record(file);
+  return geometry;
+}
+
+std::shared_ptr<material> asset_cache::mtl_material(
+    const obj_material &mtl,
+    const std::function<std::shared_ptr<material>(const obj_material &)>
+        &convert) {
+  if (mtl.library.empty())
+    return convert(mtl);
+  const std::string library = canonical_path(mtl.library);
+  const std::string key = library + '|' + mtl.name;
+  record(library);
+  // `convert` loads the texture maps, so edits to the images invalidate
+  // the material as well
+  return g_materials.get(
+      g_asset_mutex, key, stamp_of(library), g_stats.material_hits,
+      g_stats.material_loads, [&]() { return convert(mtl); },
+      [&](const std::shared_ptr<material> &) {
+        std::vector<std::string> maps;
+        for (const std::string *map :
+             {&mtl.map_Kd, &mtl.map_Ks, &mtl.map_bump, &mtl.map_d}) {
+          std::string path = obj_reader::map_path(mtl, *map);
+          if (!path.empty())
+            maps.push_back(std::move(path));
+        }
+        return maps;
+      });
+}
+
+std::shared_ptr<image_texture> asset_cache::texture(const std::string &path,
+                                                    color_space space) {
+  const std::string file = canonical_path(path);
+  const std::string key =
+      file + (space == color_space::linear ? "|linear" : "|srgb");
+  record(file);
+  return g_textures.get(g_asset_mutex, key, stamp_of(file),
+                        g_stats.texture_hits, g_stats.texture_loads,
+                        [&]() -> std::shared_ptr<image_texture> {
+                          auto tex = std::make_shared<image_texture>();
+                          if (!tex->load(path, space))
+                            return nullptr;
+                          return tex;
+                        });
+}
+
+void asset_cache::trim() {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  g_objs.trim(true);
+  g_geometry.trim(false);
+  g_materials.trim(false);
+  g_textures.trim(false);
+}
+
+asset_cache::recorder::recorder() {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  previous = g_recorder;
+  g_recorder = this;
+}
+
+asset_cache::recorder::~recorder() {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  if (g_recorder == this)
+    g_recorder = previous;
+}
+
+std::vector<std::string> asset_cache::recorder::files() const {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  return paths;
+}
+
+void asset_cache::record(const std::string &path) {
+  if (path.empty())
+    return;
+  const std::string file = canonical_path(path);
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  if (g_recorder && std::find(g_recorder->paths.begin(),
+                              g_recorder->paths.end(),
+                              file) == g_recorder->paths.end())
+    g_recorder->paths.push_back(file);
+}
+
+asset_cache::statistics asset_cache::stats() {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  return g_stats;
+}
+
+void asset_cache::clear() {
+  std::lock_guard<std::mutex> lock(g_asset_mutex);
+  g_objs.clear();
+  g_geometry.clear();
+  g_materials.clear();
+  g_textures.clear();
+  g_stats = statistics();
+}
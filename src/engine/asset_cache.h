@@ -0,0 +1,112 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include "color_space.h"
+#include "material.h"
+#include "obj_reader.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct mesh_geometry;
+class image_texture;
+
+/**
+ * @brief Process-wide cache of loaded assets shared across scene elements
+ *
+ * - Parsed OBJ files (object space) keyed by path
+ * - Baked mesh geometry (transformed buffers + BVH) keyed by path and the
+ *   mesh's build options, so elements with the same file and transform
+ *   share one copy
+ * - Converted MTL materials keyed by (MTL file, material name)
+ * - Image textures (with their mip pyramids) keyed by path and color space
+ *
+ * Lookups are thread-safe. When several threads ask for the same missing
+ * asset, one loads it and the others wait for the result. File-backed
+ * entries are dropped when the file's size or modification time changes;
+ * for baked geometry that includes the OBJ's MTL libraries, and for MTL
+ * materials their texture maps.
+ */
+class asset_cache {
+public:
+  struct statistics {
+    size_t obj_hits = 0, obj_loads = 0;
+    size_t geometry_hits = 0, geometry_loads = 0;
+    size_t material_hits = 0, material_loads = 0;
+    size_t texture_hits = 0, texture_loads = 0;
+  };
+
+  /**
+   * @brief Parsed OBJ for a file, loaded on first use
+   * @return nullptr on failure (`error` is set)
+   */
+  static std::shared_ptr<const obj_mesh_data> obj(const std::string &path,
+                                                  std::string &error);
+
+  /**
+   * @brief Geometry for (path, options), built by `build` on first use
+   */
+  static std::shared_ptr<const mesh_geometry>
+  geometry(const std::string &path, uint64_t options,
+           const std::function<std::shared_ptr<const mesh_geometry>()> &build);
+
+  /**
+   * @brief Engine material for an MTL record, converted once per
+   *        (library, name) and shared by every mesh that uses it
+   */
+  static std::shared_ptr<material> mtl_material(
+      const obj_material &mtl,
+      const std::function<std::shared_ptr<material>(const obj_material &)>
+          &convert);
+
+  /**
+   * @brief Image texture for a file, loaded once per color space and
+   *        shared by every material that references it
+   * @return nullptr when the file cannot be loaded
+   */
+  static std::shared_ptr<image_texture>
+  texture(const std::string &path, color_space space = color_space::srgb);
+
+  /**
+   * @brief Release what is no longer needed once a scene has loaded:
+   *        parsed OBJ data and assets no scene object references
+   */
+  static void trim();
+
+  static statistics stats();
+
+  /**
+   * @brief Collects the files behind every lookup, hits included and from
+   *        any thread, while it is alive (e.g. everything a scene load
+   *        read, so an editor can watch them). One recorder is active at
+   *        a time; a new one pauses the previous until it is destroyed.
+   */
+  class recorder {
+  public:
+    recorder();
+    ~recorder();
+    recorder(const recorder &) = delete;
+    recorder &operator=(const recorder &) = delete;
+
+    // Files in first-use order, without duplicates
+    std::vector<std::string> files() const;
+
+  private:
+    friend class asset_cache;
+    recorder *previous;
+    std::vector<std::string> paths;
+  };
+
+  /**
+   * @brief Add a file read outside the cache (HDRI, volume grid, glTF) to
+   *        the active recorder, if any
+   */
+  static void record(const std::string &path);
+
+  // Forget everything (e.g. before reloading a scene from scratch)
+  static void clear();
+};
+
+#endif
@@ -2,6 +2,20 @@
 #include <algorithm>
 #include <iostream>
 
+namespace {
+
+bvh_node* as_node(const std::shared_ptr<hittable>& h) {
+    return dynamic_cast<bvh_node*>(h.get());
+}
+
+aabb box_of(const std::shared_ptr<hittable>& h) {
+    aabb box;
+    h->bounding_box(box);
+    return box;
+}
+
+} // namespace
+
 // Comparator functions for sorting along each axis
 bool box_compare(const std::shared_ptr<hittable>& a, const std::shared_ptr<hittable>& b, int axis) {
     aabb box_a;
@@ -77,7 +91,12 @@ bvh_node::bvh_node(const std::vector<std::shared_ptr<hittable>>& src_objects,
     if (!left->bounding_box(box_left) || !right->bounding_box(box_right)) {
         std::cerr << "No bounding box in bvh_node constructor.\n";
     }
-    box = surrounding_box(box_left, box_right);
+    update();
+}
+
+bvh_node::bvh_node(std::shared_ptr<hittable> a, std::shared_ptr<hittable> b)
+    : left(std::move(a)), right(std::move(b)) {
+    update();
 }
 
 bool bvh_node::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
@@ -98,6 +117,115 @@ bool bvh_node::bounding_box(aabb& output_box) const {
     return true;
 }
 
+void bvh_node::insert(const std::shared_ptr<hittable>& object) {
+    if (left == right) {
+        // Single-object leaf: the new object becomes its sibling
+        right = object;
+    } else {
+        // Descend into the child whose box grows the least
+        const aabb object_box = box_of(object);
+        auto growth = [&](const std::shared_ptr<hittable>& child) {
+            const aabb child_box = box_of(child);
+            return surrounding_box(child_box, object_box).surface_area() -
+                   child_box.surface_area();
+        };
+        std::shared_ptr<hittable>& target =
+            growth(left) <= growth(right) ? left : right;
+        if (auto node = as_node(target)) {
+            node->insert(object);
+        } else {
+            target = std::make_shared<bvh_node>(target, object);
+        }
+    }
+    update();
+}
+
+bool bvh_node::replace(const hittable* object, const aabb& old_box,
+                       const std::shared_ptr<hittable>& replacement) {
+    if (!box.contains(old_box)) {
+        return false;
+    }
+
+    // Both children hold the object in a single-object leaf
+    bool found = false;
+    for (std::shared_ptr<hittable>* child : {&left, &right}) {
+        if (child->get() == object) {
+            *child = replacement;
+            found = true;
+        }
+    }
+    for (std::shared_ptr<hittable>* child : {&left, &right}) {
+        if (found) {
+            break;
+        }
+        if (auto node = as_node(*child)) {
+            found = node->replace(object, old_box, replacement);
+        }
+    }
+
+    if (found) {
+        update();
+    }
+    return found;
+}
+
+bool bvh_node::remove(const hittable* object, const aabb& old_box) {
+    if (!box.contains(old_box)) {
+        return false;
+    }
+
+    // The object itself, or a single-object leaf holding it
+    auto holds = [object](const std::shared_ptr<hittable>& child) {
+        if (child.get() == object) {
+            return true;
+        }
+        auto node = as_node(child);
+        return node && node->left == node->right && node->left.get() == object;
+    };
+    if (left != right && (holds(left) || holds(right))) {
+        // This node turns into its other child
+        std::shared_ptr<hittable> sibling = holds(left) ? right : left;
+        if (bvh_node* node = as_node(sibling)) {
+            left = node->left;
+            right = node->right;
+        } else {
+            left = right = sibling;
+        }
+        update();
+        return true;
+    }
+
+    for (std::shared_ptr<hittable>* child : {&left, &right}) {
+        auto node = as_node(*child);
+        if (node && node->remove(object, old_box)) {
+            // A child left with a single object is replaced by the object
+            if (node->left == node->right) {
+                *child = node->left;
+            }
+            update();
+            return true;
+        }
+    }
+    return false;
+}
+
+double bvh_node::sahCost() const {
+    return area_sum / std::max(box.surface_area(), 1e-12);
+}
+
+void bvh_node::update() {
+    box = surrounding_box(box_of(left), box_of(right));
+    area_sum = box.surface_area();
+    if (const bvh_node* node = as_node(left)) {
+        area_sum += node->area_sum;
+    }
+    if (right != left) {
+        if (const bvh_node* node = as_node(right)) {
+            area_sum += node->area_sum;
+        }
+    }
+}
+
 void bvh_node::countNodes(int& nodes, int& leaves, int depth, int& maxDepth) const {
     nodes++;
     if (depth > maxDepth) {
@@ -20,9 +20,33 @@ public:
     // Convenience constructor that builds from entire list
     bvh_node(const std::vector<std::shared_ptr<hittable>>& objects)
         : bvh_node(objects, 0, objects.size()) {}
+
+    // Node over two existing subtrees or objects
+    bvh_node(std::shared_ptr<hittable> a, std::shared_ptr<hittable> b);
     
     virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
     virtual bool bounding_box(aabb& output_box) const override;
+
+    // Incremental editing. `old_box` is the object's bounding box as of its
+    // insertion or last refit; every ancestor contains it, so the search
+    // only descends into subtrees that can hold the object.
+
+    // Insert below the child whose box grows the least
+    void insert(const std::shared_ptr<hittable>& object);
+
+    // Swap the leaf `object` for `replacement` (or for itself after it
+    // moved) and refit the boxes on its path, bottom-up
+    bool replace(const hittable* object, const aabb& old_box,
+                 const std::shared_ptr<hittable>& replacement);
+
+    // Remove the leaf `object`; its sibling takes the parent's place.
+    // A root holding only `object` is left as is.
+    bool remove(const hittable* object, const aabb& old_box);
+
+    // Sum of all node surface areas relative to the root's: the SAH
+    // traversal cost up to constant factors, which grows as edits degrade
+    // the tree
+    double sahCost() const;
     
     // Get statistics about the BVH tree
     int getNodeCount() const;
@@ -33,9 +57,12 @@ private:
     std::shared_ptr<hittable> left;
     std::shared_ptr<hittable> right;
     aabb box;
+    double area_sum = 0.0; // Surface areas of this node and all below it
     
     // Helper functions for tree statistics
     void countNodes(int& nodes, int& leaves, int depth, int& maxDepth) const;
+    // Recompute the box and area sum from the children
+    void update();
 };
 
 // Comparator functions for sorting objects along each axis
@@ -39,3 +39,17 @@ ray camera::get_ray(double s, double t) const {
   return ray(origin + offset, lower_left_corner + s * horizontal +
                                   t * vertical - origin - offset);
 }
+
+bool camera::project(const point3 &p, double &s, double &t) const {
+  const vec3 d = p - origin;
+  const double z = -dot(d, w);
+  if (z <= 0.0)
+    return false;
+
+  // Intersect the line of sight with the focus plane, then express the
+  // point in the viewport's (orthogonal) horizontal and vertical axes
+  const vec3 q = origin + d * (focus_dist / z) - lower_left_corner;
+  s = dot(q, horizontal) / horizontal.length_squared();
+  t = dot(q, vertical) / vertical.length_squared();
+  return true;
+}
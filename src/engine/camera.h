@@ -17,6 +17,13 @@ public:
   );
   ray get_ray(double s, double t) const;
 
+  /**
+   * @brief Inverse of get_ray() through the lens centre: the viewport
+   *        coordinates (s, t) a world-space point projects to
+   * @return false when the point lies behind the camera
+   */
+  bool project(const point3 &p, double &s, double &t) const;
+
 public:
   double VIEWPORT_WIDTH;
   double VIEWPORT_HEIGHT;
@@ -0,0 +1,53 @@
+#ifndef COLOR_SPACE_H
+#define COLOR_SPACE_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @brief Encoding of 8-bit texel values
+ *
+ * Color maps (albedo, base color, LDR environments) are authored in sRGB
+ * and must be decoded before shading; data maps (roughness, normals) are
+ * already linear.
+ */
+enum class color_space { srgb, linear };
+
+// Exact sRGB transfer functions, for values in [0, 1]
+inline float srgb_to_linear(float c) {
+  return c <= 0.04045f ? c / 12.92f
+                       : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linear_to_srgb(float c) {
+  return c <= 0.0031308f ? c * 12.92f
+                         : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+/**
+ * @brief 256-entry table turning a stored byte into a linear float
+ *
+ * Bytes decode with one load instead of a pow per channel.
+ */
+inline const float *byte_decode_table(color_space space) {
+  static const auto tables = [] {
+    std::array<std::array<float, 256>, 2> t{};
+    for (int i = 0; i < 256; i++) {
+      t[0][i] = srgb_to_linear(i / 255.0f);
+      t[1][i] = i / 255.0f;
+    }
+    return t;
+  }();
+  return tables[space == color_space::srgb ? 0 : 1].data();
+}
+
+// Nearest byte for a linear value
+inline uint8_t encode_byte(float linear, color_space space) {
+  float c = std::fmin(std::fmax(linear, 0.0f), 1.0f);
+  if (space == color_space::srgb)
+    c = linear_to_srgb(c);
+  return static_cast<uint8_t>(c * 255.0f + 0.5f);
+}
+
+#endif
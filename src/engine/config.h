@@ -11,6 +11,18 @@ enum class AccelerationMethod {
   BVH     // Use Bounding Volume Hierarchy acceleration
 };
 
+// Strategy used to pick the light sampled at each shading point
+enum class LightSampling {
+  TREE, // Light hierarchy: importance by power, distance and orientation
+  POWER // Alias table: proportional to emitted power (area for emitters)
+};
+
+// How material calls are dispatched during shading
+enum class MaterialDispatch {
+  VIRTUAL, // Virtual calls through the material vtable
+  TABLE    // Switch over a packed std::variant table (see material_table.h)
+};
+
 class config {
 public:
   config() {}
@@ -26,8 +38,19 @@ public:
   // compatibility)
   AccelerationMethod acceleration = AccelerationMethod::LINEAR;
 
-  // Enable OIDN AI denoiser (default true if available)
+  // Light selection strategy for next event estimation
+  LightSampling lightSampling = LightSampling::TREE;
+
+  // Material dispatch used by the integrator
+  MaterialDispatch materialDispatch = MaterialDispatch::VIRTUAL;
+
+  // Denoise the final image: OIDN when available, otherwise the a-trous
+  // filter guided by the first-hit features
   bool enableDenoiser = true;
+
+  // a-trous passes (pass i uses taps 2^i pixels apart); also used by the
+  // GUI preview denoiser
+  int denoiseIterations = 5;
 };
 
 #endif
@@ -88,6 +88,7 @@ public:
     rec.normal = vec3(1, 0, 0);
     rec.front_face = true;
     rec.mat_ptr = phase_function;
+    rec.material_slot = material_slot;
 
     return true;
   }
@@ -100,6 +101,7 @@ public:
   shared_ptr<hittable> boundary;
   double neg_inv_density;
   shared_ptr<material> phase_function;
+  int material_slot = -1; // Assigned by world::buildMaterialTable()
 };
 
 #endif
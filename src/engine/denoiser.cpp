@@ -0,0 +1,382 @@
+#include "engine/denoiser.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace denoiser {
+namespace {
+
+// B3-spline weights along one axis
+constexpr float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4,
+                             1.0f / 16};
+
+// Below this the color is not divided by the albedo
+constexpr float min_albedo = 0.01f;
+// Depth of misses (and anything closer) before taking the logarithm
+constexpr float min_depth = 1e-3f;
+
+// Passes beyond this would only spread taps past the image
+constexpr int max_iterations = 16;
+
+// Keeps the luminance term finite where the variance is zero
+constexpr float min_deviation = 1e-4f;
+
+// Demodulated color of one pass as separate planes, with the variance of
+// its luminance
+struct color_planes {
+    std::vector<float> r, g, b, variance;
+
+    void resize(size_t count)
+    {
+        r.resize(count);
+        g.resize(count);
+        b.resize(count);
+        variance.resize(count);
+    }
+};
+
+// Everything one pass reads and writes
+struct pass_context {
+    const float* r;
+    const float* g;
+    const float* b;
+    const float* variance;
+    float* out_r;
+    float* out_g;
+    float* out_b;
+    float* out_variance;
+    const float* nx;
+    const float* ny;
+    const float* nz;
+    const float* log_depth;
+    int width;
+    int height;
+    int step;
+    float luminance_weight;   // 1 / sigma, 0 turns the term off
+    float inv_normal;
+    float inv_depth[5][5];    // Per tap: 1 / (sigma * distance in pixels)
+    float weight[5][5];
+};
+
+inline float luminance(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Luminance differences are measured in standard deviations of the
+// centre pixel's noise
+inline float luminance_scale(const pass_context& c, size_t i)
+{
+    return c.luminance_weight /
+           (std::sqrt(std::max(c.variance[i], 0.0f)) + min_deviation);
+}
+
+// One pixel with its taps clamped to the image
+void filter_pixel(const pass_context& c, int x, int y)
+{
+    const size_t i = static_cast<size_t>(y) * c.width + x;
+    const float lum = luminance(c.r[i], c.g[i], c.b[i]);
+    const float lum_scale = luminance_scale(c, i);
+
+    float sum_r = 0.0f, sum_g = 0.0f, sum_b = 0.0f, sum_w = 0.0f;
+    float sum_variance = 0.0f;
+    for (int ty = 0; ty < 5; ty++) {
+        const int qy = std::clamp(y + (ty - 2) * c.step, 0, c.height - 1);
+        for (int tx = 0; tx < 5; tx++) {
+            const int qx = std::clamp(x + (tx - 2) * c.step, 0, c.width - 1);
+            const size_t q = static_cast<size_t>(qy) * c.width + qx;
+
+            const float dl = std::abs(luminance(c.r[q], c.g[q], c.b[q]) - lum);
+            const float dnx = c.nx[q] - c.nx[i];
+            const float dny = c.ny[q] - c.ny[i];
+            const float dnz = c.nz[q] - c.nz[i];
+            const float dz = std::abs(c.log_depth[q] - c.log_depth[i]);
+            const float dn = dnx * dnx + dny * dny + dnz * dnz;
+            const float arg = dl * lum_scale + dn * c.inv_normal +
+                              dz * c.inv_depth[ty][tx];
+            const float w = c.weight[ty][tx] * std::exp(-arg);
+
+            sum_r += w * c.r[q];
+            sum_g += w * c.g[q];
+            sum_b += w * c.b[q];
+            sum_w += w;
+            sum_variance += w * w * c.variance[q];
+        }
+    }
+
+    // The centre tap always has weight, so sum_w > 0
+    const float inv_w = 1.0f / sum_w;
+    c.out_r[i] = sum_r * inv_w;
+    c.out_g[i] = sum_g * inv_w;
+    c.out_b[i] = sum_b * inv_w;
+    c.out_variance[i] = sum_variance * inv_w * inv_w;
+}
+
+#if defined(__GNUC__)
+#define DENOISER_VECTORIZED 1
+
+typedef float float4 __attribute__((vector_size(16)));
+typedef int32_t int4 __attribute__((vector_size(16)));
+
+inline float4 splat(float v)
+{
+    return float4{v, v, v, v};
+}
+
+inline float4 load4(const float* p)
+{
+    float4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store4(float* p, float4 v)
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline float4 abs4(float4 v)
+{
+    return (float4)((int4)v & 0x7fffffff);
+}
+
+// exp(-x) for x >= 0, to about 2e-4 relative error: 2^t is split into an
+// integer power, added to the exponent bits, and a fraction in (-1, 0]
+// evaluated with its Taylor series
+inline float4 exp_neg4(float4 x)
+{
+    const float4 limit = splat(80.0f);
+    const int4 in_range = x < limit;
+    x = (float4)(((int4)x & in_range) | ((int4)limit & ~in_range));
+
+    const float4 t = x * splat(-1.44269504f);
+    const int4 n = __builtin_convertvector(t, int4); // Rounds towards zero
+    const float4 f = t - __builtin_convertvector(n, float4);
+
+    float4 p = splat(1.33335581e-3f);
+    p = p * f + splat(9.61812911e-3f);
+    p = p * f + splat(5.55041087e-2f);
+    p = p * f + splat(2.40226507e-1f);
+    p = p * f + splat(6.93147181e-1f);
+    p = p * f + splat(1.0f);
+    return (float4)((int4)p + n * (1 << 23));
+}
+
+// Four neighbouring pixels whose taps all lie inside the row
+void filter_block(const pass_context& c, int x, int y)
+{
+    const size_t i = static_cast<size_t>(y) * c.width + x;
+    const float4 wr = splat(0.2126f), wg = splat(0.7152f), wb = splat(0.0722f);
+    const float4 lum =
+        wr * load4(c.r + i) + wg * load4(c.g + i) + wb * load4(c.b + i);
+    const float4 lum_scale = {luminance_scale(c, i), luminance_scale(c, i + 1),
+                              luminance_scale(c, i + 2),
+                              luminance_scale(c, i + 3)};
+    const float4 nx = load4(c.nx + i);
+    const float4 ny = load4(c.ny + i);
+    const float4 nz = load4(c.nz + i);
+    const float4 log_depth = load4(c.log_depth + i);
+    const float4 inv_normal = splat(c.inv_normal);
+
+    float4 sum_r = splat(0.0f), sum_g = splat(0.0f), sum_b = splat(0.0f);
+    float4 sum_w = splat(0.0f), sum_variance = splat(0.0f);
+    for (int ty = 0; ty < 5; ty++) {
+        const int qy = std::clamp(y + (ty - 2) * c.step, 0, c.height - 1);
+        const size_t row = static_cast<size_t>(qy) * c.width + x;
+        for (int tx = 0; tx < 5; tx++) {
+            const size_t q = row + (tx - 2) * c.step;
+
+            const float4 qr = load4(c.r + q);
+            const float4 qg = load4(c.g + q);
+            const float4 qb = load4(c.b + q);
+            const float4 dl = abs4(wr * qr + wg * qg + wb * qb - lum);
+            const float4 dnx = load4(c.nx + q) - nx;
+            const float4 dny = load4(c.ny + q) - ny;
+            const float4 dnz = load4(c.nz + q) - nz;
+            const float4 dz = abs4(load4(c.log_depth + q) - log_depth);
+            const float4 arg =
+                dl * lum_scale +
+                (dnx * dnx + dny * dny + dnz * dnz) * inv_normal +
+                dz * splat(c.inv_depth[ty][tx]);
+            const float4 w = splat(c.weight[ty][tx]) * exp_neg4(arg);
+
+            sum_r += w * qr;
+            sum_g += w * qg;
+            sum_b += w * qb;
+            sum_w += w;
+            sum_variance += w * w * load4(c.variance + q);
+        }
+    }
+
+    const float4 inv_w = splat(1.0f) / sum_w;
+    store4(c.out_r + i, sum_r * inv_w);
+    store4(c.out_g + i, sum_g * inv_w);
+    store4(c.out_b + i, sum_b * inv_w);
+    store4(c.out_variance + i, sum_variance * inv_w * inv_w);
+}
+#endif
+
+void filter_row(const pass_context& c, int y)
+{
+    // Columns whose horizontal taps would leave the image are clamped
+    const int margin = 2 * c.step;
+    int x = 0;
+    for (; x < std::min(margin, c.width); x++)
+        filter_pixel(c, x, y);
+#ifdef DENOISER_VECTORIZED
+    for (; x + 4 <= c.width - margin; x += 4)
+        filter_block(c, x, y);
+#endif
+    for (; x < c.width; x++)
+        filter_pixel(c, x, y);
+}
+
+// Run fn(y0, y1) on contiguous bands of rows, one per thread
+template <typename Fn>
+void parallel_rows(int height, unsigned int threads, const Fn& fn)
+{
+    const int bands = static_cast<int>(
+        std::min<unsigned int>(threads, static_cast<unsigned int>(height)));
+    if (bands <= 1) {
+        fn(0, height);
+        return;
+    }
+    const int band = (height + bands - 1) / bands;
+    std::vector<std::thread> pool;
+    pool.reserve(bands - 1);
+    for (int y0 = band; y0 < height; y0 += band)
+        pool.emplace_back([&fn, y0, band, height] {
+            fn(y0, std::min(y0 + band, height));
+        });
+    fn(0, std::min(band, height));
+    for (auto& th : pool)
+        th.join();
+}
+
+} // namespace
+
+void atrous_filter(float* rgb, const float* albedo, const float* normal,
+                   const float* depth, int width, int height,
+                   const atrous_settings& settings)
+{
+    if (width <= 0 || height <= 0 || settings.iterations <= 0)
+        return;
+
+    unsigned int threads = settings.threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const size_t count = static_cast<size_t>(width) * height;
+    color_planes current, next;
+    current.resize(count);
+    next.resize(count);
+    // Missing guides stay zero, which turns their terms off
+    std::vector<float> nx(count, 0.0f), ny(count, 0.0f), nz(count, 0.0f);
+    std::vector<float> log_depth(count, 0.0f);
+
+    // Split into planes and divide out the albedo. `next` holds the
+    // luminance and its square for the variance estimate below.
+    parallel_rows(height, threads, [&](int y0, int y1) {
+        for (size_t i = static_cast<size_t>(y0) * width;
+             i < static_cast<size_t>(y1) * width; i++) {
+            float c[3] = {rgb[i * 3 + 0], rgb[i * 3 + 1], rgb[i * 3 + 2]};
+            if (albedo) {
+                for (int k = 0; k < 3; k++)
+                    c[k] /= std::max(albedo[i * 3 + k], min_albedo);
+            }
+            current.r[i] = c[0];
+            current.g[i] = c[1];
+            current.b[i] = c[2];
+            const float lum = luminance(c[0], c[1], c[2]);
+            next.r[i] = lum;
+            next.g[i] = lum * lum;
+            next.b[i] = 0.0f;
+            next.variance[i] = 0.0f;
+            if (normal) {
+                nx[i] = normal[i * 3 + 0];
+                ny[i] = normal[i * 3 + 1];
+                nz[i] = normal[i * 3 + 2];
+            }
+            if (depth)
+                log_depth[i] = std::log(std::max(depth[i], min_depth));
+        }
+    });
+
+    pass_context c;
+    c.nx = nx.data();
+    c.ny = ny.data();
+    c.nz = nz.data();
+    c.log_depth = log_depth.data();
+    c.width = width;
+    c.height = height;
+    c.inv_normal =
+        1.0f / std::pow(std::max(settings.sigma_normal, 1e-6f), 2.0f);
+    const float sigma_depth = std::max(settings.sigma_depth, 1e-6f);
+
+    auto run_pass = [&](const color_planes& in, color_planes& out, int step) {
+        c.r = in.r.data();
+        c.g = in.g.data();
+        c.b = in.b.data();
+        c.variance = in.variance.data();
+        c.out_r = out.r.data();
+        c.out_g = out.g.data();
+        c.out_b = out.b.data();
+        c.out_variance = out.variance.data();
+        c.step = step;
+        for (int ty = 0; ty < 5; ty++) {
+            for (int tx = 0; tx < 5; tx++) {
+                const float distance =
+                    step * std::sqrt(static_cast<float>(
+                               (tx - 2) * (tx - 2) + (ty - 2) * (ty - 2)));
+                c.inv_depth[ty][tx] =
+                    distance > 0.0f ? 1.0f / (sigma_depth * distance) : 0.0f;
+                c.weight[ty][tx] = kernel[ty] * kernel[tx];
+            }
+        }
+        parallel_rows(height, threads, [&c](int y0, int y1) {
+            for (int y = y0; y < y1; y++)
+                filter_row(c, y);
+        });
+    };
+
+    // Estimate the noise from the luminance moments of nearby pixels on the
+    // same surface (as SVGF does before it has temporal history)
+    {
+        color_planes moments;
+        moments.resize(count);
+        c.luminance_weight = 0.0f;
+        run_pass(next, moments, 1);
+        parallel_rows(height, threads, [&](int y0, int y1) {
+            for (size_t i = static_cast<size_t>(y0) * width;
+                 i < static_cast<size_t>(y1) * width; i++) {
+                current.variance[i] = std::max(
+                    moments.g[i] - moments.r[i] * moments.r[i], 0.0f);
+            }
+        });
+    }
+
+    // Each pass also filters the variance, so the luminance term tightens
+    // as the noise goes down
+    c.luminance_weight = 1.0f / std::max(settings.sigma_luminance, 1e-6f);
+    const int iterations = std::min(settings.iterations, max_iterations);
+    for (int pass = 0; pass < iterations; pass++) {
+        run_pass(current, next, 1 << pass);
+        std::swap(current, next);
+    }
+
+    // Multiply the albedo back in
+    parallel_rows(height, threads, [&](int y0, int y1) {
+        for (size_t i = static_cast<size_t>(y0) * width;
+             i < static_cast<size_t>(y1) * width; i++) {
+            const float c[3] = {current.r[i], current.g[i], current.b[i]};
+            for (int k = 0; k < 3; k++) {
+                rgb[i * 3 + k] =
+                    albedo ? c[k] * std::max(albedo[i * 3 + k], min_albedo)
+                           : c[k];
+            }
+        }
+    });
+}
+
+} // namespace denoiser
@@ -7,10 +7,11 @@
 #include <algorithm>
 
 /**
- * @brief Simple image denoiser using bilateral filtering
+ * @brief Image denoisers that need no external library
  * 
- * Reduces noise while preserving edges. No external library required.
- * Good for quick previews; for production use OIDN would be better.
+ * Reduces noise while preserving edges. atrous_filter() is the fallback
+ * when OIDN is not available; the simple filters below are kept for quick
+ * experiments.
  */
 namespace denoiser {
 
@@ -158,6 +159,47 @@ inline std::vector<color> median_filter(
     return output;
 }
 
+/**
+ * @brief Parameters of atrous_filter()
+ *
+ * The sigmas are edge-stopping widths: larger values blur more across
+ * differences in that quantity.
+ */
+struct atrous_settings {
+    int iterations = 5;           // Pass i uses taps 2^i pixels apart
+    float sigma_luminance = 4.0f; // In standard deviations of the noise
+    float sigma_normal = 0.3f;    // Length of the unit normals' difference
+    float sigma_depth = 0.05f;    // Relative depth change per pixel apart
+    unsigned int threads = 0;     // 0 uses all cores
+};
+
+/**
+ * @brief Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010)
+ *
+ * Each pass applies the 5x5 B3-spline kernel with its taps spread 2^i
+ * pixels apart, so five passes cover a 125 pixel footprint for about the
+ * cost of five 5x5 filters. Taps are weighted down by differences in
+ * normal and depth from the centre pixel, and by luminance differences
+ * relative to the local noise. As in SVGF, the noise is estimated from the
+ * luminance variance of nearby pixels on the same surface and filtered
+ * along with the color. The color is divided by the albedo before
+ * filtering and multiplied back afterwards, so texture detail survives
+ * while the lighting is smoothed.
+ *
+ * Rows are split across threads, and each thread filters four pixels at a
+ * time with vector instructions where the compiler supports GCC vector
+ * extensions.
+ *
+ * @param rgb width * height * 3 linear floats, overwritten by the result
+ * @param albedo Same layout, or nullptr
+ * @param normal Same layout (unit or zero vectors), or nullptr
+ * @param depth width * height distances to the first hit (0 for a miss),
+ *        or nullptr
+ */
+void atrous_filter(float* rgb, const float* albedo, const float* normal,
+                   const float* depth, int width, int height,
+                   const atrous_settings& settings = atrous_settings());
+
 } // namespace denoiser
 
 #endif
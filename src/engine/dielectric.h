@@ -31,6 +31,12 @@ public:
   virtual bool scatter(const ray &r_in, const hit_record &rec,
                        color &attenuation, ray &scattered) const override;
 
+  virtual bool is_specular() const override { return true; }
+
+  virtual color guide_albedo(const hit_record &rec) const override {
+    return tint;
+  }
+
 public:
   double ir;  // Index of Refraction
   color tint; // Glass tint color (1,1,1 for clear glass)
@@ -1,28 +1,40 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "../../defs.h"
 #include "../../util/logging.h"
+#include "../asset_cache.h"
 #include "../camera.h"
 #include "../config.h"
 #include "../dielectric.h"
 #include "../emissive.h"
 #include "../ggx_material.h"
 #include "../gltf_loader.h"
+#include "../grid_medium.h"
 #include "../hdri_environment.h"
 #include "../lambertian.h"
+#include "../lambertian_textured.h"
 #include "../material.h"
 #include "../mesh.h"
 #include "../metal.h"
+#include "../noise_texture.h"
 #include "../pbr_material.h"
 #include "../point_light.h"
 #include "../quad.h"
+#include "../render_runner.h"
 #include "../sphere.h"
 #include "../sss_material.h"
 #include "../sun.h"
@@ -37,7 +49,9 @@ using namespace std;
 vector<string> g_attempted_meshes;
 vector<string> g_loaded_meshes;
 vector<MeshLoadInfo> g_mesh_stats;
+double g_objects_load_ms = 0.0;
 string g_scene_directory;
+bool g_use_mesh_cache = true;
 
 // Global material map for dynamic material lookup from XML
 map<string, shared_ptr<material>> g_materials;
@@ -46,11 +60,14 @@ shared_ptr<config> LoadConfig(XMLElement *configElem);
 shared_ptr<camera> LoadCamera(XMLElement *cameraElem, float aspect_ratio);
 shared_ptr<sun> LoadSun(XMLElement *lightsElem);
 void LoadMaterials(XMLElement *materialsElem);
-vector<shared_ptr<hittable>> LoadObjects(XMLElement *objectsElem);
+vector<shared_ptr<hittable>> LoadObjects(XMLElement *objectsElem,
+                                         vector<uint64_t> &sources);
 shared_ptr<hittable> LoadSphere(XMLElement *sphereElem);
 shared_ptr<hittable> LoadMesh(XMLElement *meshElem);
+vector<shared_ptr<hittable>> LoadGLTF(XMLElement *gltfElem);
 shared_ptr<hittable> LoadTriangle(XMLElement *triangleElem);
 shared_ptr<hittable> LoadQuad(XMLElement *quadElem);
+shared_ptr<hittable> LoadVolume(XMLElement *volumeElem);
 shared_ptr<material> LoadMaterial(string name);
 
 namespace {
@@ -89,6 +106,80 @@ const std::filesystem::path &AssetsDirectory() {
   static const std::filesystem::path dir = LocateAssetsDirectory();
   return dir;
 }
+
+// Meshes and glTF models are loaded on worker threads; the diagnostic
+// lists are shared between them
+std::mutex g_mesh_stats_mutex;
+
+void RecordMeshAttempt(const std::string &path) {
+  std::lock_guard<std::mutex> lock(g_mesh_stats_mutex);
+  g_attempted_meshes.push_back(path);
+}
+
+void RecordMeshLoaded(const std::string &path, double ms, int triangles) {
+  std::lock_guard<std::mutex> lock(g_mesh_stats_mutex);
+  g_loaded_meshes.push_back(path);
+  MeshLoadInfo info;
+  info.name = path;
+  info.load_ms = ms;
+  info.triangles = triangles;
+  g_mesh_stats.push_back(info);
+}
+
+// Mix the printed form of an element (attributes, children and text) into
+// `seed`; a null element leaves the seed alone
+uint64_t HashElement(const XMLElement *elem, uint64_t seed = 0) {
+  if (!elem) {
+    return seed;
+  }
+  XMLPrinter printer(nullptr, true);
+  elem->Accept(&printer);
+  const uint64_t h = std::hash<std::string_view>{}(
+      std::string_view(printer.CStr(), printer.CStrSize() - 1));
+  return seed ^ (h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+// Definition in <Materials> of the material an object element names
+const XMLElement *MaterialDefinition(const XMLElement *objectElem) {
+  const XMLElement *ref = objectElem->FirstChildElement("Material");
+  const char *name = ref ? ref->Attribute("name") : nullptr;
+  const XMLNode *root = objectElem->Parent() ? objectElem->Parent()->Parent()
+                                             : nullptr;
+  const XMLElement *materials =
+      root ? root->FirstChildElement("Materials") : nullptr;
+  if (!name || !materials) {
+    return nullptr;
+  }
+  for (const XMLElement *item = materials->FirstChildElement(); item;
+       item = item->NextSiblingElement()) {
+    const char *itemName = item->Attribute("name");
+    if (itemName && strcmp(itemName, name) == 0) {
+      return item;
+    }
+  }
+  return nullptr;
+}
+
+// Run independent load tasks on a small pool of threads
+void RunLoadTasks(const std::vector<std::function<void()>> &tasks) {
+  const size_t workers = std::min<size_t>(
+      tasks.size(), std::max(1u, std::thread::hardware_concurrency()));
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i = next++; i < tasks.size(); i = next++) {
+      tasks[i]();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t w = 1; w < workers; w++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : pool) {
+    t.join();
+  }
+}
 } // namespace
 
 shared_ptr<world> LoadScene(string fileName) {
@@ -104,6 +195,15 @@ shared_ptr<world> LoadScene(string fileName) {
 
   shared_ptr<world> pworld = make_shared<world>();
 
+  // Diagnostics and dependencies describe this load only
+  {
+    std::lock_guard<std::mutex> lock(g_mesh_stats_mutex);
+    g_attempted_meshes.clear();
+    g_loaded_meshes.clear();
+    g_mesh_stats.clear();
+  }
+  asset_cache::recorder dependencies;
+
   // Record scene directory for resolving relative mesh filenames
   try {
     std::filesystem::path scenePath(fileName);
@@ -199,7 +299,11 @@ shared_ptr<world> LoadScene(string fileName) {
     cerr << "LoadScene: missing <Objects> element in " << fileName << endl;
     return shared_ptr<world>();
   }
-  pworld->objects = LoadObjects(objectsElem);
+  vector<uint64_t> sources;
+  pworld->objects = LoadObjects(objectsElem, sources);
+  for (size_t i = 0; i < pworld->objects.size(); ++i) {
+    pworld->objectSources[pworld->objects[i].get()] = sources[i];
+  }
 
   // Load HDRI environment map (optional)
   XMLElement *envElem = configElem->NextSiblingElement("Environment");
@@ -212,11 +316,14 @@ shared_ptr<world> LoadScene(string fileName) {
           g_scene_directory.empty()
               ? hdriPath
               : (std::filesystem::path(g_scene_directory) / hdriPath).string();
-      if (!pworld->hdri->load(fullPath)) {
+      if (pworld->hdri->load(fullPath)) {
+        asset_cache::record(fullPath);
+      } else {
         // Try from assets directory
         auto assetsDir = AssetsDirectory();
-        if (!assetsDir.empty()) {
-          pworld->hdri->load((assetsDir / hdriPath).string());
+        if (!assetsDir.empty() &&
+            pworld->hdri->load((assetsDir / hdriPath).string())) {
+          asset_cache::record((assetsDir / hdriPath).string());
         }
       }
       // Optional intensity setting
@@ -231,9 +338,92 @@ shared_ptr<world> LoadScene(string fileName) {
     }
   }
 
+  // Everything but the objects and materials, for ReloadScene()
+  uint64_t settings = HashElement(configElem);
+  settings = HashElement(cameraElem, settings);
+  settings = HashElement(lightsElem, settings);
+  settings = HashElement(envElem, settings);
+  pworld->settingsSource = settings;
+
+  // Gather point lights and emissive primitives for light sampling
+  pworld->buildLights();
+
+  // Replace per-sample noise evaluation with grid lookups where requested
+  pworld->bakeTextures();
+
+  pworld->sourceFiles = dependencies.files();
   return pworld;
 }
 
+bool ReloadScene(world &current, const string &fileName,
+                 SceneChanges &changes) {
+  // Unchanged meshes come straight from the asset cache, since `current`
+  // still holds their geometry
+  shared_ptr<world> fresh = LoadScene(fileName);
+  if (!fresh) {
+    return false;
+  }
+  changes = SceneChanges();
+
+  if (fresh->settingsSource != current.settingsSource) {
+    changes.settings = true;
+    current.pconfig = fresh->pconfig;
+    current.pcamera = fresh->pcamera;
+    current.psun = fresh->psun;
+    current.pointLights = fresh->pointLights;
+    current.hdri = fresh->hdri;
+    current.settingsSource = fresh->settingsSource;
+  }
+  current.sourceFiles = fresh->sourceFiles;
+
+  // Match loaded objects to the new description by source hash; identical
+  // elements may appear several times, hence the multimap
+  std::unordered_multimap<uint64_t, size_t> unmatched;
+  for (size_t i = 0; i < fresh->objects.size(); ++i) {
+    unmatched.emplace(fresh->objectSources[fresh->objects[i].get()], i);
+  }
+  for (size_t i = current.objects.size(); i-- > 0;) {
+    auto source = current.objectSources.find(current.objects[i].get());
+    auto match = source == current.objectSources.end()
+                     ? unmatched.end()
+                     : unmatched.find(source->second);
+    if (match != unmatched.end()) {
+      unmatched.erase(match);
+      ++changes.kept;
+    } else {
+      current.removeObject(i);
+      ++changes.removed;
+    }
+  }
+
+  // New and edited objects, in document order
+  vector<size_t> added;
+  for (const auto &entry : unmatched) {
+    added.push_back(entry.second);
+  }
+  std::sort(added.begin(), added.end());
+  for (size_t i : added) {
+    const shared_ptr<hittable> &object = fresh->objects[i];
+    current.objectSources[object.get()] = fresh->objectSources[object.get()];
+    current.addObject(object);
+    ++changes.added;
+  }
+
+  // Object edits re-gather emissive lights themselves; point lights and the
+  // packed materials are only refreshed here
+  if (changes.settings && current.hasLights()) {
+    current.buildLights();
+  }
+  if (changes.added > 0 && current.materialTable.enabled) {
+    current.buildMaterialTable();
+  }
+  // A new config may select another acceleration or material dispatch
+  if (changes.settings) {
+    render::PrepareScene(current);
+  }
+  return true;
+}
+
 shared_ptr<config> LoadConfig(XMLElement *configElem) {
 
   if (!configElem) {
@@ -276,6 +466,44 @@ shared_ptr<config> LoadConfig(XMLElement *configElem) {
   pconfig->SAMPLES_PER_PIXEL = samples;
   pconfig->MAX_DEPTH = depth;
 
+  // Light selection strategy (optional, "tree" or "power")
+  XMLElement *lightSamplingElem = configElem->FirstChildElement("Light_Sampling");
+  if (lightSamplingElem && lightSamplingElem->Attribute("value")) {
+    const std::string mode = lightSamplingElem->Attribute("value");
+    if (mode == "power") {
+      pconfig->lightSampling = LightSampling::POWER;
+    } else if (mode != "tree") {
+      cerr << "LoadConfig: unknown Light_Sampling '" << mode
+           << "', using tree" << endl;
+    }
+  }
+
+  // Material dispatch (optional, "virtual" or "table")
+  XMLElement *dispatchElem = configElem->FirstChildElement("Material_Dispatch");
+  if (dispatchElem && dispatchElem->Attribute("value")) {
+    const std::string mode = dispatchElem->Attribute("value");
+    if (mode == "table") {
+      pconfig->materialDispatch = MaterialDispatch::TABLE;
+    } else if (mode != "virtual") {
+      cerr << "LoadConfig: unknown Material_Dispatch '" << mode
+           << "', using virtual" << endl;
+    }
+  }
+
+  // a-trous denoiser passes (optional, at least 1)
+  XMLElement *iterationsElem =
+      configElem->FirstChildElement("Denoise_Iterations");
+  if (iterationsElem && iterationsElem->Attribute("value")) {
+    const int iterations = atoi(iterationsElem->Attribute("value"));
+    if (iterations >= 1) {
+      pconfig->denoiseIterations = iterations;
+    } else {
+      cerr << "LoadConfig: invalid Denoise_Iterations '"
+           << iterationsElem->Attribute("value") << "', using "
+           << pconfig->denoiseIterations << endl;
+    }
+  }
+
   return pconfig;
 }
 
@@ -409,82 +637,149 @@ shared_ptr<sun> LoadSun(XMLElement *lightsElem) {
   return psun;
 }
 
-vector<shared_ptr<hittable>> LoadObjects(XMLElement *objectsElem) {
+vector<shared_ptr<hittable>> LoadObjects(XMLElement *objectsElem,
+                                         vector<uint64_t> &sources) {
 
-  vector<shared_ptr<hittable>> list;
+  // Every element gets its own slot so the list keeps document order even
+  // though meshes and glTF models finish loading in any order
+  vector<vector<shared_ptr<hittable>>> slots;
+  vector<uint64_t> slotSources;
+  vector<function<void()>> tasks;
+  g_objects_load_ms = 0.0;
 
   XMLElement *item = objectsElem->FirstChildElement();
   while (item) {
     string type = item->Name();
+    slots.emplace_back();
+    slotSources.push_back(
+        HashElement(item, HashElement(MaterialDefinition(item))));
+    const size_t index = slots.size() - 1;
     if (type == "Sphere") {
       auto obj = LoadSphere(item);
       if (obj)
-        list.push_back(obj);
+        slots[index].push_back(obj);
     } else if (type == "Mesh") {
-      auto obj = LoadMesh(item);
-      if (obj)
-        list.push_back(obj);
+      tasks.push_back([item, index, &slots]() {
+        auto obj = LoadMesh(item);
+        if (obj)
+          slots[index].push_back(obj);
+      });
     } else if (type == "Triangle") {
       auto obj = LoadTriangle(item);
       if (obj)
-        list.push_back(obj);
+        slots[index].push_back(obj);
     } else if (type == "Quad") {
       auto obj = LoadQuad(item);
       if (obj)
-        list.push_back(obj);
+        slots[index].push_back(obj);
     } else if (type == "GLTF") {
-      // Load glTF 2.0 model
-      const char *file = item->Attribute("file");
-      if (file) {
-        float x = 0, y = 0, z = 0;
-        float sx = 1, sy = 1, sz = 1;
-        float rx = 0, ry = 0, rz = 0;
-
-        XMLElement *posElem = item->FirstChildElement("Position");
-        if (posElem) {
-          if (posElem->Attribute("x"))
-            x = atof(posElem->Attribute("x"));
-          if (posElem->Attribute("y"))
-            y = atof(posElem->Attribute("y"));
-          if (posElem->Attribute("z"))
-            z = atof(posElem->Attribute("z"));
-        }
-        XMLElement *scaleElem = item->FirstChildElement("Scale");
-        if (scaleElem) {
-          if (scaleElem->Attribute("x"))
-            sx = atof(scaleElem->Attribute("x"));
-          if (scaleElem->Attribute("y"))
-            sy = atof(scaleElem->Attribute("y"));
-          if (scaleElem->Attribute("z"))
-            sz = atof(scaleElem->Attribute("z"));
-        }
-        XMLElement *rotElem = item->FirstChildElement("Rotation");
-        if (rotElem) {
-          if (rotElem->Attribute("x"))
-            rx = atof(rotElem->Attribute("x"));
-          if (rotElem->Attribute("y"))
-            ry = atof(rotElem->Attribute("y"));
-          if (rotElem->Attribute("z"))
-            rz = atof(rotElem->Attribute("z"));
-        }
+      tasks.push_back(
+          [item, index, &slots]() { slots[index] = LoadGLTF(item); });
+    } else if (type == "Volume") {
+      tasks.push_back([item, index, &slots]() {
+        auto obj = LoadVolume(item);
+        if (obj)
+          slots[index].push_back(obj);
+      });
+    }
 
-        // Resolve path
-        std::string gltfPath = file;
-        if (!g_scene_directory.empty()) {
-          gltfPath = (std::filesystem::path(g_scene_directory) / file).string();
-        }
+    item = item->NextSiblingElement();
+  }
 
-        auto result = gltf_loader::load(gltfPath, vec3(x, y, z),
-                                        vec3(sx, sy, sz), vec3(rx, ry, rz));
-        if (result.success) {
-          for (auto &obj : result.objects) {
-            list.push_back(obj);
-          }
-        }
+  if (!tasks.empty()) {
+    // Loaders may try several candidate paths; suppress the mesh's own
+    // per-file prints so we only show final results from the scene loader.
+    struct MeshMessageGuard {
+      MeshMessageGuard() {
+        previous = g_suppress_mesh_messages.load();
+        g_suppress_mesh_messages = true;
       }
+      ~MeshMessageGuard() { g_suppress_mesh_messages = previous; }
+      bool previous{false};
+    } guard;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    RunLoadTasks(tasks);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    g_objects_load_ms =
+        std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+    // Repeated files have been shared by now; keep only what the scene uses
+    asset_cache::trim();
+  }
+
+  vector<shared_ptr<hittable>> list;
+  sources.clear();
+  for (size_t s = 0; s < slots.size(); ++s) {
+    list.insert(list.end(), slots[s].begin(), slots[s].end());
+    // glTF elements yield several objects; tell them apart by position
+    for (size_t j = 0; j < slots[s].size(); ++j) {
+      sources.push_back(slotSources[s] + j * 0x9e3779b97f4a7c15ull);
     }
+  }
+  return list;
+}
 
-    item = item->NextSiblingElement();
+vector<shared_ptr<hittable>> LoadGLTF(XMLElement *gltfElem) {
+  vector<shared_ptr<hittable>> list;
+
+  // Load glTF 2.0 model
+  const char *file = gltfElem->Attribute("file");
+  if (!file) {
+    return list;
+  }
+
+  float x = 0, y = 0, z = 0;
+  float sx = 1, sy = 1, sz = 1;
+  float rx = 0, ry = 0, rz = 0;
+
+  XMLElement *posElem = gltfElem->FirstChildElement("Position");
+  if (posElem) {
+    if (posElem->Attribute("x"))
+      x = atof(posElem->Attribute("x"));
+    if (posElem->Attribute("y"))
+      y = atof(posElem->Attribute("y"));
+    if (posElem->Attribute("z"))
+      z = atof(posElem->Attribute("z"));
+  }
+  XMLElement *scaleElem = gltfElem->FirstChildElement("Scale");
+  if (scaleElem) {
+    if (scaleElem->Attribute("x"))
+      sx = atof(scaleElem->Attribute("x"));
+    if (scaleElem->Attribute("y"))
+      sy = atof(scaleElem->Attribute("y"));
+    if (scaleElem->Attribute("z"))
+      sz = atof(scaleElem->Attribute("z"));
+  }
+  XMLElement *rotElem = gltfElem->FirstChildElement("Rotation");
+  if (rotElem) {
+    if (rotElem->Attribute("x"))
+      rx = atof(rotElem->Attribute("x"));
+    if (rotElem->Attribute("y"))
+      ry = atof(rotElem->Attribute("y"));
+    if (rotElem->Attribute("z"))
+      rz = atof(rotElem->Attribute("z"));
+  }
+
+  // Resolve path
+  std::string gltfPath = file;
+  if (!g_scene_directory.empty()) {
+    gltfPath = (std::filesystem::path(g_scene_directory) / file).string();
+  }
+
+  RecordMeshAttempt(gltfPath);
+  asset_cache::record(gltfPath);
+  auto t0 = std::chrono::high_resolution_clock::now();
+  auto result = gltf_loader::load(gltfPath, vec3(x, y, z), vec3(sx, sy, sz),
+                                  vec3(rx, ry, rz));
+  if (result.success) {
+    auto t1 = std::chrono::high_resolution_clock::now();
+    RecordMeshLoaded(gltfPath,
+                     std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                     static_cast<int>(result.triangle_count));
+    for (auto &obj : result.objects) {
+      list.push_back(obj);
+    }
   }
 
   return list;
@@ -688,6 +983,88 @@ shared_ptr<hittable> LoadQuad(XMLElement *quadElem) {
   return make_shared<quad>(Q, u, v, mat);
 }
 
+shared_ptr<hittable> LoadVolume(XMLElement *volumeElem) {
+  XMLElement *gridElem = volumeElem->FirstChildElement("Grid");
+  if (!gridElem || !gridElem->Attribute("file")) {
+    cerr << "LoadVolume: missing <Grid file=...>" << endl;
+    return shared_ptr<hittable>();
+  }
+
+  // Grid box: minimum corner and size
+  float x = 0.0f, y = 0.0f, z = 0.0f;
+  XMLElement *posElem = volumeElem->FirstChildElement("Position");
+  if (posElem) {
+    if (posElem->Attribute("x"))
+      x = atof(posElem->Attribute("x"));
+    if (posElem->Attribute("y"))
+      y = atof(posElem->Attribute("y"));
+    if (posElem->Attribute("z"))
+      z = atof(posElem->Attribute("z"));
+  }
+  point3 corner(x, y, z);
+
+  x = y = z = 1.0f;
+  XMLElement *sizeElem = volumeElem->FirstChildElement("Size");
+  if (sizeElem) {
+    if (sizeElem->Attribute("x"))
+      x = atof(sizeElem->Attribute("x"));
+    if (sizeElem->Attribute("y"))
+      y = atof(sizeElem->Attribute("y"));
+    if (sizeElem->Attribute("z"))
+      z = atof(sizeElem->Attribute("z"));
+  }
+  vec3 size(x, y, z);
+
+  // Voxel counts and layout of the raw file
+  int nx = gridElem->IntAttribute("x", 0);
+  int ny = gridElem->IntAttribute("y", 0);
+  int nz = gridElem->IntAttribute("z", 0);
+  if (nx <= 0 || ny <= 0 || nz <= 0 || size.x() <= 0 || size.y() <= 0 ||
+      size.z() <= 0) {
+    cerr << "LoadVolume: grid dimensions and size must be positive" << endl;
+    return shared_ptr<hittable>();
+  }
+  auto format = grid_medium::voxel_format::float32;
+  if (gridElem->Attribute("format", "uint8"))
+    format = grid_medium::voxel_format::uint8;
+
+  float density = 1.0f;
+  XMLElement *densityElem = volumeElem->FirstChildElement("Density");
+  if (densityElem && densityElem->Attribute("value"))
+    density = atof(densityElem->Attribute("value"));
+
+  float r = 1.0f, g = 1.0f, b = 1.0f;
+  XMLElement *colorElem = volumeElem->FirstChildElement("Color");
+  if (colorElem) {
+    if (colorElem->Attribute("r"))
+      r = atof(colorElem->Attribute("r"));
+    if (colorElem->Attribute("g"))
+      g = atof(colorElem->Attribute("g"));
+    if (colorElem->Attribute("b"))
+      b = atof(colorElem->Attribute("b"));
+  }
+
+  std::string gridPath = gridElem->Attribute("file");
+  if (!g_scene_directory.empty()) {
+    gridPath = (std::filesystem::path(g_scene_directory) / gridPath).string();
+  }
+
+  vector<float> voxels;
+  asset_cache::record(gridPath);
+  if (!grid_medium::load_raw(gridPath, nx, ny, nz, format, voxels))
+    return shared_ptr<hittable>();
+
+  auto medium =
+      make_shared<grid_medium>(corner, corner + size, nx, ny, nz,
+                               std::move(voxels), density, color(r, g, b));
+  if (!g_quiet.load()) {
+    cerr << "Loaded volume " << gridPath << " (" << nx << "x" << ny << "x"
+         << nz << ", " << medium->majorant_cells() << " majorant cells)"
+         << endl;
+  }
+  return medium;
+}
+
 shared_ptr<hittable> LoadMesh(XMLElement *meshElem) {
   if (!meshElem) {
     cerr << "LoadMesh: null mesh element" << endl;
@@ -793,30 +1170,14 @@ shared_ptr<hittable> LoadMesh(XMLElement *meshElem) {
       make_shared<mesh>(fileName, position, scale, rotation, material);
   shared_ptr<mesh> derived = dynamic_pointer_cast<mesh>(pmesh);
 
-  // When trying multiple candidates, suppress mesh's own per-file prints so
-  // we only show final results from the scene loader.
-  struct MeshMessageGuard {
-    MeshMessageGuard() {
-      previous = g_suppress_mesh_messages.load();
-      g_suppress_mesh_messages = true;
-    }
-    ~MeshMessageGuard() { g_suppress_mesh_messages = previous; }
-    bool previous{false};
-  } guard;
-
   for (auto &candidate : candidates) {
     // record attempt
-    g_attempted_meshes.push_back(candidate);
+    RecordMeshAttempt(candidate);
     auto t0 = std::chrono::high_resolution_clock::now();
-    if (derived->load(candidate)) {
+    if (derived->load(candidate, g_use_mesh_cache)) {
       auto t1 = std::chrono::high_resolution_clock::now();
       double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
-      g_loaded_meshes.push_back(candidate);
-      MeshLoadInfo info;
-      info.name = candidate;
-      info.load_ms = ms;
-      info.triangles = derived->getTriangleCount();
-      g_mesh_stats.push_back(info);
+      RecordMeshLoaded(candidate, ms, derived->getTriangleCount());
       return pmesh;
     }
   }
@@ -857,18 +1218,13 @@ shared_ptr<hittable> LoadMesh(XMLElement *meshElem) {
           break; // don't scan forever in very large trees
         if (ent.path().filename() == basename) {
           std::string found = ent.path().string();
-          g_attempted_meshes.push_back(found);
+          RecordMeshAttempt(found);
           auto t0 = std::chrono::high_resolution_clock::now();
-          if (derived->load(found)) {
+          if (derived->load(found, g_use_mesh_cache)) {
             auto t1 = std::chrono::high_resolution_clock::now();
             double ms =
                 std::chrono::duration<double, std::milli>(t1 - t0).count();
-            g_loaded_meshes.push_back(found);
-            MeshLoadInfo info;
-            info.name = found;
-            info.load_ms = ms;
-            info.triangles = derived->getTriangleCount();
-            g_mesh_stats.push_back(info);
+            RecordMeshLoaded(found, ms, derived->getTriangleCount());
             return pmesh;
           }
           // if failed, continue searching
@@ -994,6 +1350,24 @@ void LoadMaterials(XMLElement *materialsElem) {
         roughness = atof(roughnessElem->Attribute("value"));
       }
       mat = make_shared<ggx_material>(color(r, g, b), roughness, metallic);
+    } else if (type == "Marble" || type == "Turbulence") {
+      // Perlin noise albedo, optionally baked into a 3D grid over the
+      // objects that use it: <Bake resolution="128" />
+      float scale = 1.0f;
+      XMLElement *scaleElem = item->FirstChildElement("Scale");
+      if (scaleElem && scaleElem->Attribute("value")) {
+        scale = atof(scaleElem->Attribute("value"));
+      }
+      shared_ptr<bakeable_noise_texture> noise;
+      if (type == "Marble")
+        noise = make_shared<noise_texture>(scale);
+      else
+        noise = make_shared<turb_texture>(scale);
+      XMLElement *bakeElem = item->FirstChildElement("Bake");
+      if (bakeElem && bakeElem->Attribute("resolution")) {
+        noise->set_bake_resolution(atoi(bakeElem->Attribute("resolution")));
+      }
+      mat = make_shared<lambertian_textured>(noise);
     }
 
     if (mat) {
@@ -7,7 +7,8 @@
 #include <vector>
 
 // Lists populated by the scene loader for diagnostics. The definitions are in
-// factory_methods.cpp and are safe to read after calling LoadScene().
+// factory_methods.cpp and are safe to read after calling LoadScene(); each
+// call starts them afresh.
 extern std::vector<std::string> g_attempted_meshes;
 extern std::vector<std::string> g_loaded_meshes;
 
@@ -15,6 +16,10 @@ extern std::vector<std::string> g_loaded_meshes;
 // will try filenames relative to this directory as a fallback.
 extern std::string g_scene_directory;
 
+// When true (default), OBJ meshes are loaded from / saved to .rtmesh caches
+// next to the source file.
+extern bool g_use_mesh_cache;
+
 struct MeshLoadInfo {
 	std::string name;
 	double load_ms;
@@ -23,9 +28,30 @@ struct MeshLoadInfo {
 
 extern std::vector<MeshLoadInfo> g_mesh_stats;
 
+// Wall-clock time LoadScene spent on the (concurrent) mesh and glTF loads;
+// compare with the sum of g_mesh_stats load times for the speedup.
+extern double g_objects_load_ms;
+
 class world;
 
 std::shared_ptr<world> LoadScene(std::string fileName);
 
+// What ReloadScene() changed in the loaded world
+struct SceneChanges {
+  bool settings = false; // Config, camera, lights or environment
+  size_t kept = 0;       // Objects left in place (with their BVH nodes)
+  size_t removed = 0;
+  size_t added = 0;
+  bool any() const { return settings || removed > 0 || added > 0; }
+};
+
+// Re-read `fileName` into `current` (call only while no rays are being
+// traced). Objects whose XML and material definition are unchanged stay in
+// place; the others are removed and added through the world's incremental
+// BVH edits. Mesh files are not compared: a changed OBJ needs LoadScene().
+// Returns false, leaving `current` untouched, if the file fails to load.
+bool ReloadScene(world &current, const std::string &fileName,
+                 SceneChanges &changes);
+
 
 #endif
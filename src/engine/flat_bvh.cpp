@@ -0,0 +1,212 @@
+#include "flat_bvh.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <numeric>
+
+namespace {
+
+constexpr int kBins = 16;
+constexpr uint32_t kMaxLeafCount = 0xFFFF;
+
+// From this depth on nodes are split at the object median, which halves
+// the primitive count, so fewer than 2^32 primitives never reach past
+// flat_bvh_builder::max_depth
+constexpr int kMedianDepth = flat_bvh_builder::max_depth - 32;
+
+struct box3 {
+  float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+  void grow(const float *mn, const float *mx) {
+    for (int a = 0; a < 3; a++) {
+      lo[a] = std::min(lo[a], mn[a]);
+      hi[a] = std::max(hi[a], mx[a]);
+    }
+  }
+
+  void grow(const box3 &b) { grow(b.lo, b.hi); }
+
+  float area() const {
+    if (hi[0] < lo[0])
+      return 0.0f;
+    float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+  }
+};
+
+struct build_context {
+  const std::vector<float> &bounds;
+  std::vector<float> centroids;
+  std::vector<uint32_t> &order;
+  std::vector<flat_bvh_node> &nodes;
+  uint32_t max_leaf;
+
+  const float *prim_min(uint32_t p) const { return &bounds[p * 6]; }
+  const float *prim_max(uint32_t p) const { return &bounds[p * 6 + 3]; }
+  float centroid(uint32_t p, int axis) const { return centroids[p * 3 + axis]; }
+};
+
+void make_leaf(flat_bvh_node &node, uint32_t begin, uint32_t end) {
+  node.offset = begin;
+  node.count = static_cast<uint16_t>(end - begin);
+  node.axis = 0;
+}
+
+void build_recursive(build_context &ctx, uint32_t node_index, uint32_t begin,
+                     uint32_t end, int depth) {
+  box3 box, centroid_box;
+  for (uint32_t i = begin; i < end; i++) {
+    const uint32_t p = ctx.order[i];
+    box.grow(ctx.prim_min(p), ctx.prim_max(p));
+    const float *c = &ctx.centroids[p * 3];
+    centroid_box.grow(c, c);
+  }
+
+  {
+    flat_bvh_node &node = ctx.nodes[node_index];
+    std::copy(box.lo, box.lo + 3, node.bounds_min);
+    std::copy(box.hi, box.hi + 3, node.bounds_max);
+  }
+
+  const uint32_t count = end - begin;
+  if (count <= ctx.max_leaf || depth >= flat_bvh_builder::max_depth) {
+    make_leaf(ctx.nodes[node_index], begin, end);
+    return;
+  }
+
+  // Split along the axis with the largest centroid spread
+  int axis = 0;
+  float extent[3];
+  for (int a = 0; a < 3; a++)
+    extent[a] = centroid_box.hi[a] - centroid_box.lo[a];
+  if (extent[1] > extent[axis])
+    axis = 1;
+  if (extent[2] > extent[axis])
+    axis = 2;
+
+  uint32_t mid = begin;
+  if (extent[axis] > 0.0f && depth < kMedianDepth) {
+    // Bin the centroids and evaluate the SAH at every bin boundary
+    std::array<box3, kBins> bin_box;
+    std::array<uint32_t, kBins> bin_count{};
+    const float scale = kBins / extent[axis];
+    auto bin_of = [&](uint32_t p) {
+      int b = static_cast<int>((ctx.centroid(p, axis) - centroid_box.lo[axis]) *
+                               scale);
+      return std::clamp(b, 0, kBins - 1);
+    };
+    for (uint32_t i = begin; i < end; i++) {
+      const uint32_t p = ctx.order[i];
+      const int b = bin_of(p);
+      bin_count[b]++;
+      bin_box[b].grow(ctx.prim_min(p), ctx.prim_max(p));
+    }
+
+    std::array<float, kBins - 1> left_cost{};
+    box3 acc;
+    uint32_t acc_count = 0;
+    for (int b = 0; b < kBins - 1; b++) {
+      acc.grow(bin_box[b]);
+      acc_count += bin_count[b];
+      left_cost[b] = acc.area() * acc_count;
+    }
+
+    float best_cost = FLT_MAX;
+    int best_split = -1;
+    acc = box3();
+    acc_count = 0;
+    for (int b = kBins - 1; b > 0; b--) {
+      acc.grow(bin_box[b]);
+      acc_count += bin_count[b];
+      const float cost = left_cost[b - 1] + acc.area() * acc_count;
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_split = b;
+      }
+    }
+
+    // Traversal step costs about as much as one triangle test
+    const float leaf_cost = static_cast<float>(count);
+    const float split_cost = 1.0f + best_cost / std::max(box.area(), 1e-20f);
+    if (split_cost >= leaf_cost && count <= 4 * ctx.max_leaf) {
+      make_leaf(ctx.nodes[node_index], begin, end);
+      return;
+    }
+
+    mid = static_cast<uint32_t>(
+        std::partition(ctx.order.begin() + begin, ctx.order.begin() + end,
+                       [&](uint32_t p) { return bin_of(p) < best_split; }) -
+        ctx.order.begin());
+  }
+
+  if (mid == begin || mid == end) {
+    // All centroids coincide (or fell into one bin): split by count
+    if (extent[axis] <= 0.0f && count <= kMaxLeafCount &&
+        count <= 4 * ctx.max_leaf) {
+      make_leaf(ctx.nodes[node_index], begin, end);
+      return;
+    }
+    mid = begin + count / 2;
+    std::nth_element(ctx.order.begin() + begin, ctx.order.begin() + mid,
+                     ctx.order.begin() + end, [&](uint32_t a, uint32_t b) {
+                       return ctx.centroid(a, axis) < ctx.centroid(b, axis);
+                     });
+  }
+
+  // Depth-first layout: left child follows the parent directly
+  const uint32_t left = static_cast<uint32_t>(ctx.nodes.size());
+  ctx.nodes.emplace_back();
+  build_recursive(ctx, left, begin, mid, depth + 1);
+
+  const uint32_t right = static_cast<uint32_t>(ctx.nodes.size());
+  ctx.nodes.emplace_back();
+  build_recursive(ctx, right, mid, end, depth + 1);
+
+  flat_bvh_node &node = ctx.nodes[node_index];
+  node.offset = right;
+  node.count = 0;
+  node.axis = static_cast<uint16_t>(axis);
+}
+
+} // namespace
+
+void flat_bvh_builder::build(const std::vector<float> &bounds,
+                             std::vector<uint32_t> &order,
+                             std::vector<flat_bvh_node> &nodes,
+                             int max_leaf_size) {
+  const size_t count = bounds.size() / 6;
+  order.resize(count);
+  std::iota(order.begin(), order.end(), 0u);
+  nodes.clear();
+  if (count == 0)
+    return;
+
+  build_context ctx{bounds, {}, order, nodes,
+                    static_cast<uint32_t>(std::max(max_leaf_size, 1))};
+  ctx.centroids.resize(count * 3);
+  for (size_t p = 0; p < count; p++) {
+    for (int a = 0; a < 3; a++) {
+      ctx.centroids[p * 3 + a] =
+          0.5f * (bounds[p * 6 + a] + bounds[p * 6 + 3 + a]);
+    }
+  }
+
+  nodes.reserve(count * 2 / std::max<size_t>(ctx.max_leaf / 2, 1));
+  nodes.emplace_back();
+  build_recursive(ctx, 0, 0, static_cast<uint32_t>(count), 0);
+}
+
+int flat_bvh_builder::depth(const flat_bvh_node *nodes, size_t count) {
+  // Parents precede their children, so one forward pass suffices
+  std::vector<int> node_depth(count, 0);
+  int deepest = 0;
+  for (size_t i = 0; i < count; i++) {
+    deepest = std::max(deepest, node_depth[i]);
+    if (nodes[i].is_leaf())
+      continue;
+    for (size_t child : {i + 1, size_t(nodes[i].offset)})
+      node_depth[child] = std::max(node_depth[child], node_depth[i] + 1);
+  }
+  return deepest;
+}
@@ -0,0 +1,58 @@
+#ifndef FLAT_BVH_H
+#define FLAT_BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Node of a pointer-free BVH stored in depth-first order
+ *
+ * The first child of an interior node is the next node in the array and
+ * `offset` holds the index of the second child. For leaves `offset` is the
+ * first primitive and `count` the number of primitives. The layout is
+ * plain-old-data so the array can be written to disk and used in place
+ * from a memory-mapped file.
+ */
+struct flat_bvh_node {
+  float bounds_min[3];
+  uint32_t offset;
+  float bounds_max[3];
+  uint16_t count; // 0 for interior nodes
+  uint16_t axis;  // Split axis, used to visit the nearer child first
+
+  bool is_leaf() const { return count > 0; }
+};
+
+static_assert(sizeof(flat_bvh_node) == 32, "flat_bvh_node is serialized");
+
+/**
+ * @brief Binned SAH builder for flat_bvh_node arrays
+ */
+class flat_bvh_builder {
+public:
+  // Deepest leaf build() creates (the root is at depth 0), so traversal
+  // stacks of this many entries cannot overflow
+  static constexpr int max_depth = 64;
+
+  /**
+   * @brief Build a BVH over primitive bounds
+   * @param bounds 6 floats per primitive (min xyz, max xyz)
+   * @param order Output permutation: leaves reference primitives in this
+   *              order, so callers should reorder their data accordingly
+   * @param nodes Output nodes (root at index 0)
+   * @param max_leaf_size Leaves are split until they hold at most this many
+   *                      primitives (unless SAH prefers a larger leaf)
+   */
+  static void build(const std::vector<float> &bounds,
+                    std::vector<uint32_t> &order,
+                    std::vector<flat_bvh_node> &nodes, int max_leaf_size = 4);
+
+  /**
+   * @brief Depth of the deepest node of a depth-first node array whose
+   *        child indices have been checked to lie past their parent
+   */
+  static int depth(const flat_bvh_node *nodes, size_t count);
+};
+
+#endif
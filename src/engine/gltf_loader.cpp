@@ -6,11 +6,17 @@
 
 #include "gltf_loader.h"
 #include "../3rdParty/tiny_gltf.h"
+#include "asset_cache.h"
+#include "instance.h"
+#include "mesh.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstring>
+#include <filesystem>
+#include <functional>
 #include <iostream>
 
 namespace {
@@ -30,6 +36,254 @@ glm::mat4 buildTransform(const vec3 &pos, const vec3 &scale, const vec3 &rot) {
   return T * RX * RY * RZ * S;
 }
 
+// Local transform of a node: either a matrix or TRS (rotation is a
+// quaternion x, y, z, w)
+glm::mat4 nodeTransform(const tinygltf::Node &node) {
+  glm::mat4 m(1.0f);
+  if (node.matrix.size() == 16) {
+    for (int i = 0; i < 16; i++)
+      m[i / 4][i % 4] = static_cast<float>(node.matrix[i]);
+    return m;
+  }
+  if (node.translation.size() == 3) {
+    m = glm::translate(m, glm::vec3(node.translation[0], node.translation[1],
+                                    node.translation[2]));
+  }
+  if (node.rotation.size() == 4) {
+    const float x = static_cast<float>(node.rotation[0]);
+    const float y = static_cast<float>(node.rotation[1]);
+    const float z = static_cast<float>(node.rotation[2]);
+    const float w = static_cast<float>(node.rotation[3]);
+    glm::mat4 r(1.0f);
+    r[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w),
+                     2 * (x * z - y * w), 0);
+    r[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z),
+                     2 * (y * z + x * w), 0);
+    r[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w),
+                     1 - 2 * (x * x + y * y), 0);
+    m = m * r;
+  }
+  if (node.scale.size() == 3) {
+    m = glm::scale(m, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+  }
+  return m;
+}
+
+/**
+ * @brief Typed, stride-aware view of an accessor's data
+ *
+ * Reads straight out of the tinygltf buffer, so attributes are never copied
+ * into intermediate arrays, and interleaved buffer views (byteStride) work.
+ * Invalid or out-of-range accessors produce an empty view.
+ */
+class accessor_view {
+public:
+  accessor_view() = default;
+
+  accessor_view(const tinygltf::Model &model, int index) {
+    if (index < 0 || index >= static_cast<int>(model.accessors.size()))
+      return;
+    const auto &accessor = model.accessors[index];
+    if (accessor.sparse.isSparse || accessor.bufferView < 0 ||
+        accessor.bufferView >= static_cast<int>(model.bufferViews.size()))
+      return;
+    const auto &view = model.bufferViews[accessor.bufferView];
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size()))
+      return;
+    const auto &buffer = model.buffers[view.buffer];
+
+    const int component_size = tinygltf::GetComponentSizeInBytes(
+        static_cast<uint32_t>(accessor.componentType));
+    const int component_count = tinygltf::GetNumComponentsInType(
+        static_cast<uint32_t>(accessor.type));
+    if (component_size <= 0 || component_count <= 0)
+      return;
+
+    const size_t element = size_t(component_size) * component_count;
+    const size_t step = view.byteStride ? view.byteStride : element;
+    if (accessor.count > 0 &&
+        (view.byteOffset + view.byteLength > buffer.data.size() ||
+         accessor.byteOffset + step * (accessor.count - 1) + element >
+             view.byteLength))
+      return;
+
+    base = buffer.data.data() + view.byteOffset + accessor.byteOffset;
+    stride = step;
+    count = accessor.count;
+    type = accessor.componentType;
+    components = component_count;
+    normalized = accessor.normalized;
+  }
+
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+  int width() const { return components; }
+
+  // First `n` components of element i as floats (normalized integers map
+  // to [0, 1] or [-1, 1])
+  void read(size_t i, float *out, int n) const {
+    const uint8_t *p = base + i * stride;
+    n = std::min(n, components);
+    if (type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      std::memcpy(out, p, sizeof(float) * n);
+      return;
+    }
+    for (int c = 0; c < n; c++)
+      out[c] = integer(p, c);
+  }
+
+  // Element i of a scalar index accessor
+  uint32_t index(size_t i) const {
+    const uint8_t *p = base + i * stride;
+    switch (type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return *p;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t v;
+      std::memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+      uint32_t v;
+      std::memcpy(&v, p, sizeof(v));
+      return v;
+    }
+    default:
+      return UINT32_MAX;
+    }
+  }
+
+private:
+  float integer(const uint8_t *p, int c) const {
+    switch (type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      return normalized ? p[c] / 255.0f : p[c];
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+      const float v = static_cast<int8_t>(p[c]);
+      return normalized ? std::max(v / 127.0f, -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      uint16_t v;
+      std::memcpy(&v, p + c * 2, sizeof(v));
+      return normalized ? v / 65535.0f : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+      int16_t v;
+      std::memcpy(&v, p + c * 2, sizeof(v));
+      return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+      uint32_t v;
+      std::memcpy(&v, p + c * 4, sizeof(v));
+      return static_cast<float>(v);
+    }
+    default:
+      return 0.0f;
+    }
+  }
+
+  const uint8_t *base = nullptr;
+  size_t stride = 0;
+  size_t count = 0;
+  int type = 0;
+  int components = 0;
+  bool normalized = false;
+};
+
+/**
+ * @brief Convert every triangle primitive of a glTF mesh into one indexed
+ *        engine mesh; each distinct glTF material becomes a slot
+ */
+std::shared_ptr<mesh>
+buildMesh(const tinygltf::Model &model, const tinygltf::Mesh &gltfMesh,
+          const glm::mat4 &transform,
+          const std::vector<std::shared_ptr<material>> &materials) {
+  std::vector<float> positions, texcoords;
+  std::vector<uint32_t> indices, triangleMaterials;
+  std::vector<std::shared_ptr<material>> slots;
+  std::vector<int> slot_of(materials.size(), -1);
+
+  for (const auto &primitive : gltfMesh.primitives) {
+    if (primitive.mode != TINYGLTF_MODE_TRIANGLES) {
+      std::cerr << "glTF Warning: skipping non-triangle primitive in mesh '"
+                << gltfMesh.name << "'" << std::endl;
+      continue;
+    }
+
+    auto posIt = primitive.attributes.find("POSITION");
+    if (posIt == primitive.attributes.end())
+      continue;
+    accessor_view pos(model, posIt->second);
+    if (pos.empty())
+      continue;
+
+    accessor_view uv;
+    auto uvIt = primitive.attributes.find("TEXCOORD_0");
+    if (uvIt != primitive.attributes.end())
+      uv = accessor_view(model, uvIt->second);
+    const bool hasUV = uv.size() >= pos.size();
+
+    // Get material
+    int matIdx = primitive.material >= 0 ? primitive.material : 0;
+    matIdx = std::min(matIdx, static_cast<int>(materials.size()) - 1);
+    if (slot_of[matIdx] < 0) {
+      slot_of[matIdx] = static_cast<int>(slots.size());
+      slots.push_back(materials[matIdx]);
+    }
+    const uint32_t slot = static_cast<uint32_t>(slot_of[matIdx]);
+
+    const uint32_t first = static_cast<uint32_t>(positions.size() / 3);
+    const size_t vertex_count = pos.size();
+    positions.resize(positions.size() + vertex_count * 3);
+    texcoords.resize(texcoords.size() + vertex_count * 2, 0.0f);
+    for (size_t i = 0; i < vertex_count; i++) {
+      float p[3] = {0, 0, 0};
+      pos.read(i, p, 3);
+      glm::vec4 w = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+      float *dst = &positions[(first + i) * 3];
+      dst[0] = w.x;
+      dst[1] = w.y;
+      dst[2] = w.z;
+      if (hasUV) {
+        // glTF puts v = 0 at the top of the image, OBJ (and image_texture)
+        // at the bottom
+        float *t = &texcoords[(first + i) * 2];
+        uv.read(i, t, 2);
+        t[1] = 1.0f - t[1];
+      }
+    }
+
+    if (primitive.indices >= 0) {
+      // Indexed geometry; triangles referencing missing vertices are skipped
+      accessor_view idx(model, primitive.indices);
+      for (size_t i = 0; i + 2 < idx.size(); i += 3) {
+        const uint32_t i0 = idx.index(i), i1 = idx.index(i + 1),
+                       i2 = idx.index(i + 2);
+        if (i0 >= vertex_count || i1 >= vertex_count || i2 >= vertex_count)
+          continue;
+        indices.insert(indices.end(), {first + i0, first + i1, first + i2});
+        triangleMaterials.push_back(slot);
+      }
+    } else {
+      // Non-indexed geometry
+      for (uint32_t i = 0; i + 2 < vertex_count; i += 3) {
+        indices.insert(indices.end(), {first + i, first + i + 1, first + i + 2});
+        triangleMaterials.push_back(slot);
+      }
+    }
+  }
+
+  if (indices.empty())
+    return nullptr;
+
+  auto geometry = mesh::buildGeometry(std::move(positions), std::move(texcoords),
+                                      std::move(indices),
+                                      std::move(triangleMaterials));
+  if (geometry->view.triangle_count == 0)
+    return nullptr;
+  return std::make_shared<mesh>(std::move(geometry), std::move(slots));
+}
+
 } // namespace
 
 gltf_loader::LoadResult gltf_loader::load(const std::string &filename,
@@ -46,6 +300,36 @@ gltf_loader::LoadResult gltf_loader::load(const std::string &filename,
   bool binary =
       filename.size() > 4 && filename.substr(filename.size() - 4) == ".glb";
 
+  // Images are decoded into mip-mapped textures while tinygltf reads them;
+  // external files go through the shared texture registry
+  std::vector<std::shared_ptr<image_texture>> images;
+  const std::filesystem::path baseDir =
+      std::filesystem::path(filename).parent_path();
+  loader.SetImageLoader(
+      [&](tinygltf::Image *image, const int index, std::string *,
+          std::string *imageWarn, int, int, const unsigned char *bytes,
+          int size, void *) {
+        std::shared_ptr<image_texture> tex;
+        if (!image->uri.empty() && image->uri.rfind("data:", 0) != 0) {
+          tex = asset_cache::texture((baseDir / image->uri).string());
+        } else {
+          tex = std::make_shared<image_texture>();
+          if (!tex->load_from_memory(bytes, size, image->name))
+            tex = nullptr;
+        }
+        if (!tex && imageWarn)
+          *imageWarn += "Could not decode image[" + std::to_string(index) +
+                        "]\n";
+        if (index >= 0) {
+          if (images.size() <= static_cast<size_t>(index))
+            images.resize(index + 1);
+          images[index] = tex;
+        }
+        // A missing image leaves its materials untextured
+        return true;
+      },
+      nullptr);
+
   bool success;
   if (binary) {
     success = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
@@ -83,7 +367,25 @@ gltf_loader::LoadResult gltf_loader::load(const std::string &filename,
     float metallic = static_cast<float>(pbr.metallicFactor);
     float roughness = static_cast<float>(pbr.roughnessFactor);
 
-    auto mat = std::make_shared<pbr_material>(baseColor, metallic, roughness);
+    // The base color factor tints the base color texture when there is one
+    std::shared_ptr<image_texture> albedoMap;
+    const int texIdx = pbr.baseColorTexture.index;
+    if (texIdx >= 0 && texIdx < static_cast<int>(model.textures.size())) {
+      const int source = model.textures[texIdx].source;
+      if (source >= 0 && source < static_cast<int>(images.size()))
+        albedoMap = images[source];
+    }
+
+    std::shared_ptr<pbr_material> mat;
+    if (albedoMap) {
+      std::shared_ptr<texture> albedo = albedoMap;
+      if (baseColor.x() != 1.0 || baseColor.y() != 1.0 || baseColor.z() != 1.0)
+        albedo = std::make_shared<scaled_texture>(albedoMap, baseColor);
+      mat = std::make_shared<pbr_material>(albedo, metallic, roughness);
+      result.textures.push_back(albedoMap);
+    } else {
+      mat = std::make_shared<pbr_material>(baseColor, metallic, roughness);
+    }
     materials.push_back(mat);
     result.materials.push_back(mat);
 
@@ -97,120 +399,69 @@ gltf_loader::LoadResult gltf_loader::load(const std::string &filename,
         std::make_shared<pbr_material>(color(0.8, 0.8, 0.8), 0.0f, 0.5f));
   }
 
-  // Load meshes
-  for (const auto &mesh : model.meshes) {
-    for (const auto &primitive : mesh.primitives) {
-      // Get indices
-      std::vector<uint32_t> indices;
-      if (primitive.indices >= 0) {
-        const auto &accessor = model.accessors[primitive.indices];
-        const auto &bufferView = model.bufferViews[accessor.bufferView];
-        const auto &buffer = model.buffers[bufferView.buffer];
-        const uint8_t *data =
-            buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
-
-        for (size_t i = 0; i < accessor.count; i++) {
-          uint32_t idx = 0;
-          switch (accessor.componentType) {
-          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-            idx = reinterpret_cast<const uint16_t *>(data)[i];
-            break;
-          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-            idx = reinterpret_cast<const uint32_t *>(data)[i];
-            break;
-          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-            idx = data[i];
-            break;
-          }
-          indices.push_back(idx);
-        }
-      }
-
-      // Get positions
-      std::vector<glm::vec3> positions;
-      auto posIt = primitive.attributes.find("POSITION");
-      if (posIt != primitive.attributes.end()) {
-        const auto &accessor = model.accessors[posIt->second];
-        const auto &bufferView = model.bufferViews[accessor.bufferView];
-        const auto &buffer = model.buffers[bufferView.buffer];
-        const float *data = reinterpret_cast<const float *>(
-            buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-
-        for (size_t i = 0; i < accessor.count; i++) {
-          positions.emplace_back(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]);
-        }
-      }
+  // Walk the node hierarchy of the default scene and collect the world
+  // transform of every node that references a mesh
+  std::vector<std::pair<int, glm::mat4>> placements;
+  std::function<void(int, const glm::mat4 &, int)> visit =
+      [&](int nodeIdx, const glm::mat4 &parent, int depth) {
+        if (nodeIdx < 0 || nodeIdx >= static_cast<int>(model.nodes.size()) ||
+            depth > 256)
+          return;
+        const auto &node = model.nodes[nodeIdx];
+        const glm::mat4 world = parent * nodeTransform(node);
+        if (node.mesh >= 0 && node.mesh < static_cast<int>(model.meshes.size()))
+          placements.emplace_back(node.mesh, world);
+        for (int child : node.children)
+          visit(child, world, depth + 1);
+      };
+
+  if (!model.scenes.empty()) {
+    const int sceneIdx =
+        model.defaultScene >= 0 &&
+                model.defaultScene < static_cast<int>(model.scenes.size())
+            ? model.defaultScene
+            : 0;
+    for (int root : model.scenes[sceneIdx].nodes)
+      visit(root, transform, 0);
+  } else {
+    // No scene graph: place every mesh once
+    for (int m = 0; m < static_cast<int>(model.meshes.size()); m++)
+      placements.emplace_back(m, transform);
+  }
 
-      // Get texture coordinates
-      std::vector<glm::vec2> texcoords;
-      auto uvIt = primitive.attributes.find("TEXCOORD_0");
-      if (uvIt != primitive.attributes.end()) {
-        const auto &accessor = model.accessors[uvIt->second];
-        const auto &bufferView = model.bufferViews[accessor.bufferView];
-        const auto &buffer = model.buffers[bufferView.buffer];
-        const float *data = reinterpret_cast<const float *>(
-            buffer.data.data() + bufferView.byteOffset + accessor.byteOffset);
-
-        for (size_t i = 0; i < accessor.count; i++) {
-          texcoords.emplace_back(data[i * 2], data[i * 2 + 1]);
-        }
+  std::vector<int> uses(model.meshes.size(), 0);
+  for (const auto &placement : placements)
+    uses[placement.first]++;
+
+  // A mesh placed once is baked straight into world space. Meshes placed
+  // several times are built once in object space and shared by instances.
+  std::vector<std::shared_ptr<mesh>> shared(model.meshes.size());
+  for (const auto &[meshIdx, world] : placements) {
+    const auto &gltfMesh = model.meshes[meshIdx];
+    if (uses[meshIdx] == 1) {
+      auto baked = buildMesh(model, gltfMesh, world, materials);
+      if (baked) {
+        result.triangle_count += baked->getTriangleCount();
+        result.objects.push_back(baked);
       }
+      continue;
+    }
 
-      // Get material
-      int matIdx = primitive.material >= 0 ? primitive.material : 0;
-      matIdx = std::min(matIdx, static_cast<int>(materials.size()) - 1);
-      auto mat = materials[matIdx];
-
-      // Create triangles
-      if (indices.empty()) {
-        // Non-indexed geometry
-        for (size_t i = 0; i + 2 < positions.size(); i += 3) {
-          glm::vec4 v0 = transform * glm::vec4(positions[i], 1.0f);
-          glm::vec4 v1 = transform * glm::vec4(positions[i + 1], 1.0f);
-          glm::vec4 v2 = transform * glm::vec4(positions[i + 2], 1.0f);
-
-          vec3 uv0(0, 0, 0), uv1(0, 0, 0), uv2(0, 0, 0);
-          if (!texcoords.empty()) {
-            uv0 = vec3(texcoords[i].x, texcoords[i].y, 0);
-            uv1 = vec3(texcoords[i + 1].x, texcoords[i + 1].y, 0);
-            uv2 = vec3(texcoords[i + 2].x, texcoords[i + 2].y, 0);
-          }
-
-          result.objects.push_back(std::make_shared<triangle>(
-              vec3(v0.x, v0.y, v0.z), vec3(v1.x, v1.y, v1.z),
-              vec3(v2.x, v2.y, v2.z), uv0, uv1, uv2, mat));
-        }
-      } else {
-        // Indexed geometry
-        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
-          size_t i0 = indices[i], i1 = indices[i + 1], i2 = indices[i + 2];
-
-          if (i0 >= positions.size() || i1 >= positions.size() ||
-              i2 >= positions.size())
-            continue;
-
-          glm::vec4 v0 = transform * glm::vec4(positions[i0], 1.0f);
-          glm::vec4 v1 = transform * glm::vec4(positions[i1], 1.0f);
-          glm::vec4 v2 = transform * glm::vec4(positions[i2], 1.0f);
-
-          vec3 uv0(0, 0, 0), uv1(0, 0, 0), uv2(0, 0, 0);
-          if (!texcoords.empty() && i0 < texcoords.size() &&
-              i1 < texcoords.size() && i2 < texcoords.size()) {
-            uv0 = vec3(texcoords[i0].x, texcoords[i0].y, 0);
-            uv1 = vec3(texcoords[i1].x, texcoords[i1].y, 0);
-            uv2 = vec3(texcoords[i2].x, texcoords[i2].y, 0);
-          }
-
-          result.objects.push_back(std::make_shared<triangle>(
-              vec3(v0.x, v0.y, v0.z), vec3(v1.x, v1.y, v1.z),
-              vec3(v2.x, v2.y, v2.z), uv0, uv1, uv2, mat));
-        }
+    if (!shared[meshIdx]) {
+      shared[meshIdx] = buildMesh(model, gltfMesh, glm::mat4(1.0f), materials);
+      if (!shared[meshIdx]) {
+        uses[meshIdx] = 0;
+        continue;
       }
+      result.triangle_count += shared[meshIdx]->getTriangleCount();
     }
+    result.objects.push_back(std::make_shared<instance>(shared[meshIdx], world));
+    result.instance_count++;
   }
 
-  std::cerr << "  Created " << result.objects.size() << " triangles"
-            << std::endl;
+  std::cerr << "  Created " << result.triangle_count << " triangles in "
+            << result.objects.size() << " objects (" << result.instance_count
+            << " instances)" << std::endl;
   result.success = true;
   return result;
 }
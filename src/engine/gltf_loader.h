@@ -17,7 +17,8 @@
  * @brief glTF 2.0 model loader
  *
  * Loads glTF/GLB files with:
- * - Mesh geometry (triangles)
+ * - Mesh geometry as indexed meshes with a flat BVH; meshes referenced by
+ *   several nodes are shared through instances
  * - PBR materials (metallic-roughness workflow)
  * - Textures (albedo, normal, metallic-roughness)
  */
@@ -27,6 +28,8 @@ public:
     std::vector<std::shared_ptr<hittable>> objects;
     std::vector<std::shared_ptr<material>> materials;
     std::vector<std::shared_ptr<texture>> textures;
+    size_t triangle_count = 0; // Unique triangles (shared meshes count once)
+    size_t instance_count = 0;
     bool success = false;
     std::string error;
   };
@@ -0,0 +1,188 @@
+#include "grid_medium.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+grid_medium::grid_medium(const point3 &min, const point3 &max, int nx, int ny,
+                         int nz, std::vector<float> voxels, double scale,
+                         color albedo)
+    : phase_function(make_shared<isotropic>(albedo)), box(min, max),
+      n{nx, ny, nz}, scale(scale), voxels(std::move(voxels)) {
+  const vec3 size = max - min;
+  to_voxel = vec3(nx / size.x(), ny / size.y(), nz / size.z());
+  build_majorants();
+}
+
+bool grid_medium::load_raw(const std::string &path, int nx, int ny, int nz,
+                           voxel_format format, std::vector<float> &voxels) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Volume: cannot open " << path << std::endl;
+    return false;
+  }
+  const size_t count = size_t(nx) * ny * nz;
+  const size_t bytes = count * (format == voxel_format::float32 ? 4 : 1);
+  const auto file_size = static_cast<size_t>(file.tellg());
+  if (file_size != bytes) {
+    std::cerr << "Volume: " << path << " is " << file_size
+              << " bytes, expected " << bytes << " for " << nx << "x" << ny
+              << "x" << nz << std::endl;
+    return false;
+  }
+  file.seekg(0);
+
+  voxels.resize(count);
+  if (format == voxel_format::float32) {
+    file.read(reinterpret_cast<char *>(voxels.data()), bytes);
+  } else {
+    std::vector<unsigned char> raw(count);
+    file.read(reinterpret_cast<char *>(raw.data()), bytes);
+    for (size_t i = 0; i < count; i++)
+      voxels[i] = raw[i] / 255.0f;
+  }
+  if (!file) {
+    std::cerr << "Volume: failed to read " << path << std::endl;
+    return false;
+  }
+  // Negative or NaN densities would break the majorant bound
+  for (float &v : voxels)
+    v = v > 0.0f ? v : 0.0f;
+  return true;
+}
+
+void grid_medium::build_majorants() {
+  for (int a = 0; a < 3; a++)
+    m[a] = (n[a] + block - 1) / block;
+  majorants.assign(size_t(m[0]) * m[1] * m[2], 0.0f);
+
+  // A point in cell c interpolates voxels c * block - 1 .. (c + 1) * block
+  for (int cz = 0; cz < m[2]; cz++) {
+    for (int cy = 0; cy < m[1]; cy++) {
+      for (int cx = 0; cx < m[0]; cx++) {
+        const int x0 = std::max(cx * block - 1, 0);
+        const int x1 = std::min((cx + 1) * block, n[0] - 1);
+        const int y0 = std::max(cy * block - 1, 0);
+        const int y1 = std::min((cy + 1) * block, n[1] - 1);
+        const int z0 = std::max(cz * block - 1, 0);
+        const int z1 = std::min((cz + 1) * block, n[2] - 1);
+        float peak = 0.0f;
+        for (int z = z0; z <= z1; z++)
+          for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+              peak = std::max(peak, voxel(x, y, z));
+        majorants[(size_t(cz) * m[1] + cy) * m[0] + cx] =
+            static_cast<float>(peak * scale);
+      }
+    }
+  }
+}
+
+double grid_medium::density(const vec3 &g) const {
+  int i0[3], i1[3];
+  double t[3];
+  for (int a = 0; a < 3; a++) {
+    const double c = g[a] - 0.5; // Voxel values sit at voxel centres
+    const double f = std::floor(c);
+    t[a] = c - f;
+    i0[a] = std::clamp(static_cast<int>(f), 0, n[a] - 1);
+    i1[a] = std::clamp(static_cast<int>(f) + 1, 0, n[a] - 1);
+  }
+  const double c00 = voxel(i0[0], i0[1], i0[2]) +
+                     (voxel(i1[0], i0[1], i0[2]) - voxel(i0[0], i0[1], i0[2])) *
+                         t[0];
+  const double c10 = voxel(i0[0], i1[1], i0[2]) +
+                     (voxel(i1[0], i1[1], i0[2]) - voxel(i0[0], i1[1], i0[2])) *
+                         t[0];
+  const double c01 = voxel(i0[0], i0[1], i1[2]) +
+                     (voxel(i1[0], i0[1], i1[2]) - voxel(i0[0], i0[1], i1[2])) *
+                         t[0];
+  const double c11 = voxel(i0[0], i1[1], i1[2]) +
+                     (voxel(i1[0], i1[1], i1[2]) - voxel(i0[0], i1[1], i1[2])) *
+                         t[0];
+  const double c0 = c00 + (c10 - c00) * t[1];
+  const double c1 = c01 + (c11 - c01) * t[1];
+  return (c0 + (c1 - c0) * t[2]) * scale;
+}
+
+bool grid_medium::hit(const ray &r, double t_min, double t_max,
+                      hit_record &rec) const {
+  // Clip the ray to the grid box
+  const point3 lo = box.min(), hi = box.max();
+  double t0 = std::max(t_min, 0.0), t1 = t_max;
+  for (int a = 0; a < 3; a++) {
+    const double inv_d = 1.0 / r.direction()[a];
+    double ta = (lo[a] - r.origin()[a]) * inv_d;
+    double tb = (hi[a] - r.origin()[a]) * inv_d;
+    if (inv_d < 0.0)
+      std::swap(ta, tb);
+    t0 = ta > t0 ? ta : t0;
+    t1 = tb < t1 ? tb : t1;
+    if (t1 <= t0)
+      return false;
+  }
+
+  // Walk the majorant cells (block voxels wide) with a 3D DDA
+  const vec3 origin_v = (r.origin() - lo) * to_voxel / block;
+  const vec3 dir_v = r.direction() * to_voxel / block;
+  const vec3 start = origin_v + t0 * dir_v;
+  int cell[3], step[3];
+  double t_next[3], t_delta[3];
+  for (int a = 0; a < 3; a++) {
+    cell[a] = std::clamp(static_cast<int>(std::floor(start[a])), 0, m[a] - 1);
+    if (dir_v[a] > 0.0) {
+      step[a] = 1;
+      t_delta[a] = 1.0 / dir_v[a];
+      t_next[a] = t0 + (cell[a] + 1 - start[a]) * t_delta[a];
+    } else if (dir_v[a] < 0.0) {
+      step[a] = -1;
+      t_delta[a] = -1.0 / dir_v[a];
+      t_next[a] = t0 + (start[a] - cell[a]) * t_delta[a];
+    } else {
+      step[a] = 0;
+      t_delta[a] = std::numeric_limits<double>::infinity();
+      t_next[a] = std::numeric_limits<double>::infinity();
+    }
+  }
+
+  const double ray_length = r.direction().length();
+  double t = t0;
+  while (t < t1) {
+    const int axis = t_next[0] < t_next[1]
+                         ? (t_next[0] < t_next[2] ? 0 : 2)
+                         : (t_next[1] < t_next[2] ? 1 : 2);
+    const double cell_exit = std::min(t_next[axis], t1);
+    const double majorant =
+        majorants[(size_t(cell[2]) * m[1] + cell[1]) * m[0] + cell[0]];
+
+    // Delta tracking inside the cell; the exponential is memoryless, so
+    // restarting at the cell boundary with the next majorant is unbiased
+    if (majorant > 0.0) {
+      const double inv_majorant = 1.0 / (majorant * ray_length);
+      while (true) {
+        t -= std::log(1.0 - random_double()) * inv_majorant;
+        if (t >= cell_exit)
+          break;
+        const vec3 g = (r.at(t) - lo) * to_voxel;
+        if (random_double() * majorant < density(g)) {
+          rec.t = t;
+          rec.p = r.at(t);
+          // Arbitrary normal (not used for isotropic scattering)
+          rec.normal = vec3(1, 0, 0);
+          rec.front_face = true;
+          rec.mat_ptr = phase_function;
+          rec.material_slot = material_slot;
+          return true;
+        }
+      }
+    }
+
+    t = cell_exit;
+    cell[axis] += step[axis];
+    if (cell[axis] < 0 || cell[axis] >= m[axis])
+      break;
+    t_next[axis] += t_delta[axis];
+  }
+  return false;
+}
@@ -0,0 +1,80 @@
+#ifndef GRID_MEDIUM_H
+#define GRID_MEDIUM_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "isotropic.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Heterogeneous medium whose density comes from a dense voxel grid
+ *
+ * The grid spans an axis-aligned box; voxel values are samples at voxel
+ * centres, interpolated trilinearly and multiplied by a density scale to
+ * give the extinction per world unit.
+ *
+ * Free-flight distances are sampled with delta tracking against a coarse
+ * majorant grid (the largest density each block of voxels can produce).
+ * Rays walk the majorant cells with a 3D DDA: cells with zero majorant
+ * are skipped outright and each other cell is tracked against its own
+ * bound, so thin smoke inside a mostly empty box costs few lookups.
+ * The bounding box is the grid box, so the BVH culls rays that miss.
+ */
+class grid_medium : public hittable {
+public:
+  enum class voxel_format { float32, uint8 };
+
+  /**
+   * @param min,max World-space corners of the grid
+   * @param nx,ny,nz Voxel counts; `voxels` is x-fastest, then y, then z
+   * @param scale Extinction per world unit of a voxel value of 1
+   */
+  grid_medium(const point3 &min, const point3 &max, int nx, int ny, int nz,
+              std::vector<float> voxels, double scale, color albedo);
+
+  /**
+   * @brief Read a headerless raw grid (uint8 values are mapped to 0..1)
+   * @return false when the file is missing or its size does not match
+   */
+  static bool load_raw(const std::string &path, int nx, int ny, int nz,
+                       voxel_format format, std::vector<float> &voxels);
+
+  virtual bool hit(const ray &r, double t_min, double t_max,
+                   hit_record &rec) const override;
+
+  virtual bool bounding_box(aabb &output_box) const override {
+    output_box = box;
+    return true;
+  }
+
+  size_t voxel_count() const { return voxels.size(); }
+  size_t majorant_cells() const { return majorants.size(); }
+
+public:
+  shared_ptr<material> phase_function;
+  int material_slot = -1; // Assigned by world::buildMaterialTable()
+
+private:
+  // Voxels per majorant cell along each axis
+  static constexpr int block = 8;
+
+  void build_majorants();
+
+  // Scaled density at a point given in voxel coordinates
+  double density(const vec3 &g) const;
+
+  float voxel(int x, int y, int z) const {
+    return voxels[(size_t(z) * n[1] + y) * n[0] + x];
+  }
+
+  aabb box;
+  int n[3];
+  int m[3];       // Majorant cells along each axis
+  vec3 to_voxel;  // Voxels per world unit along each axis
+  double scale;
+  std::vector<float> voxels;
+  std::vector<float> majorants; // Scaled, m[0] * m[1] * m[2]
+};
+
+#endif
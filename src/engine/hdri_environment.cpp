@@ -1,29 +1,145 @@
 #include "hdri_environment.h"
 #include "../3rdParty/stb_image.h"
+#include "color_space.h"
+#include <algorithm>
 
 bool hdri_environment::load(const std::string &filename) {
   int components;
 
-  // Load image via stb_image
-  unsigned char *img_data =
-      stbi_load(filename.c_str(), &width, &height, &components, 3);
+  if (stbi_is_hdr(filename.c_str())) {
+    // Radiance HDR: keep the full linear float range (bright suns > 1.0)
+    float *hdr_data =
+        stbi_loadf(filename.c_str(), &width, &height, &components, 3);
+    if (!hdr_data) {
+      std::cerr << "Failed to load environment: " << filename << std::endl;
+      return false;
+    }
+    data.assign(hdr_data, hdr_data + width * height * 3);
+    stbi_image_free(hdr_data);
+  } else {
+    // Load image via stb_image
+    unsigned char *img_data =
+        stbi_load(filename.c_str(), &width, &height, &components, 3);
 
-  if (!img_data) {
-    std::cerr << "Failed to load environment: " << filename << std::endl;
-    return false;
-  }
+    if (!img_data) {
+      std::cerr << "Failed to load environment: " << filename << std::endl;
+      return false;
+    }
+
+    // Convert to linear float data (sRGB decode)
+    const float *decode = byte_decode_table(color_space::srgb);
+    data.resize(width * height * 3);
+    for (int i = 0; i < width * height * 3; i++) {
+      data[i] = decode[img_data[i]];
+    }
 
-  // Convert to linear float data (gamma decode)
-  data.resize(width * height * 3);
-  for (int i = 0; i < width * height * 3; i++) {
-    // Approximate sRGB to linear conversion
-    data[i] = static_cast<float>(pow(img_data[i] / 255.0, 2.2));
+    stbi_image_free(img_data);
   }
 
-  stbi_image_free(img_data);
+  build_distribution();
 
   std::cerr << "Loaded environment: " << filename << " (" << width << "x"
             << height << ")" << std::endl;
 
   return true;
 }
+
+void hdri_environment::build_distribution() {
+  conditional_cdf.assign(static_cast<size_t>(height) * (width + 1), 0.0f);
+  marginal_cdf.assign(height + 1, 0.0);
+
+  for (int j = 0; j < height; j++) {
+    // Rows near the poles cover less solid angle
+    const double sin_theta = sin(M_PI * (j + 0.5) / height);
+    float *row = &conditional_cdf[static_cast<size_t>(j) * (width + 1)];
+    double sum = 0.0;
+    for (int i = 0; i < width; i++) {
+      const float *texel = &data[(static_cast<size_t>(j) * width + i) * 3];
+      const double lum =
+          0.2126 * texel[0] + 0.7152 * texel[1] + 0.0722 * texel[2];
+      sum += std::max(lum, 0.0) * sin_theta;
+      row[i + 1] = static_cast<float>(sum);
+    }
+    marginal_cdf[j + 1] = marginal_cdf[j] + sum;
+  }
+
+  total_weight = marginal_cdf[height];
+}
+
+vec3 hdri_environment::sample_direction(double u1, double u2,
+                                        double &pdf) const {
+  // Pick a row from the marginal CDF
+  const double row_target = u1 * total_weight;
+  int j = static_cast<int>(std::upper_bound(marginal_cdf.begin() + 1,
+                                            marginal_cdf.end(), row_target) -
+                           (marginal_cdf.begin() + 1));
+  j = std::min(j, height - 1);
+  // Skip zero-weight rows that upper_bound can land on at the boundary
+  while (j < height - 1 && marginal_cdf[j + 1] <= marginal_cdf[j]) {
+    j++;
+  }
+
+  // Pick a column from that row's conditional CDF
+  const float *row = &conditional_cdf[static_cast<size_t>(j) * (width + 1)];
+  const double row_weight = row[width];
+  const double col_target = u2 * row_weight;
+  int i = static_cast<int>(
+      std::upper_bound(row + 1, row + width + 1, col_target) - (row + 1));
+  i = std::min(i, width - 1);
+
+  // Uniform position inside the texel
+  const double col_span = row[i + 1] - row[i];
+  const double du = col_span > 0.0 ? (col_target - row[i]) / col_span : 0.5;
+  const double row_span = marginal_cdf[j + 1] - marginal_cdf[j];
+  const double dv =
+      row_span > 0.0 ? (row_target - marginal_cdf[j]) / row_span : 0.5;
+  const double u = (i + std::clamp(du, 0.0, 1.0)) / width;
+  const double v = (j + std::clamp(dv, 0.0, 1.0)) / height;
+
+  // Invert the equirectangular mapping
+  const double theta = v * M_PI;
+  const double phi = u * 2.0 * M_PI - M_PI;
+  const double sin_theta = sin(theta);
+  vec3 dir(sin_theta * cos(phi), cos(theta), sin_theta * sin(phi));
+
+  // Undo the rotation applied in texel_of()
+  if (rotation != 0.0) {
+    double cos_r = cos(rotation);
+    double sin_r = sin(rotation);
+    dir = vec3(dir.x() * cos_r + dir.z() * sin_r, dir.y(),
+               -dir.x() * sin_r + dir.z() * cos_r);
+  }
+
+  if (sin_theta <= 0.0) {
+    pdf = 0.0;
+    return dir;
+  }
+
+  // Density over the unit square is constant within a texel; convert it to
+  // solid angle (dω = 2π² sinθ du dv)
+  const double texel_weight = row[i + 1] - row[i];
+  const double pdf_uv = texel_weight / total_weight * width * height;
+  pdf = pdf_uv / (2.0 * M_PI * M_PI * sin_theta);
+  return dir;
+}
+
+double hdri_environment::pdf_value(const vec3 &direction) const {
+  if (!has_distribution()) {
+    return 0.0;
+  }
+
+  int i, j;
+  texel_of(direction, i, j);
+
+  const double sin_theta =
+      sqrt(std::max(0.0, 1.0 - direction.y() * direction.y() /
+                                   direction.length_squared()));
+  if (sin_theta <= 0.0) {
+    return 0.0;
+  }
+
+  const float *row = &conditional_cdf[static_cast<size_t>(j) * (width + 1)];
+  const double texel_weight = row[i + 1] - row[i];
+  const double pdf_uv = texel_weight / total_weight * width * height;
+  return pdf_uv / (2.0 * M_PI * M_PI * sin_theta);
+}
@@ -22,12 +22,33 @@ public:
 
   /**
    * @brief Load environment map from file
-   * Supports PNG, JPG formats. HDR/EXR would need additional library.
+   * Radiance .hdr files are loaded as linear floats; PNG/JPG are
+   * gamma-decoded from 8 bits. Also builds the sampling distribution.
    */
   bool load(const std::string &filename);
 
   bool is_valid() const { return !data.empty(); }
 
+  /**
+   * @brief Whether the map can be importance-sampled (non-black map)
+   */
+  bool has_distribution() const { return total_weight > 0.0; }
+
+  /**
+   * @brief Importance-sample a direction proportional to luminance x
+   * sin(theta) using the marginal/conditional CDFs
+   * @param u1 Uniform random number selecting the row
+   * @param u2 Uniform random number selecting the column
+   * @param pdf Output solid-angle pdf of the returned direction
+   * @return Unit direction in world space (rotation applied)
+   */
+  vec3 sample_direction(double u1, double u2, double &pdf) const;
+
+  /**
+   * @brief Solid-angle pdf of sample_direction() generating `direction`
+   */
+  double pdf_value(const vec3 &direction) const;
+
   /**
    * @brief Sample environment map from a direction
    * Uses equirectangular mapping (lat/long).
@@ -39,6 +60,28 @@ public:
       return (1.0 - t) * color(1.0, 1.0, 1.0) + t * color(0.5, 0.7, 1.0);
     }
 
+    int i, j;
+    texel_of(direction, i, j);
+    int idx = (j * width + i) * 3;
+
+    // Return color with intensity multiplier
+    return color(data[idx], data[idx + 1], data[idx + 2]) * intensity;
+  }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+  // Intensity multiplier for the environment
+  double intensity;
+
+  // Rotation offset (radians around Y axis)
+  double rotation;
+
+private:
+  /**
+   * @brief Texel hit by a world-space direction (equirectangular mapping)
+   */
+  void texel_of(const vec3 &direction, int &i, int &j) const {
     // Apply rotation around Y axis
     vec3 dir = direction;
     if (rotation != 0.0) {
@@ -57,31 +100,25 @@ public:
     double v = theta / M_PI;                // 0 to 1
 
     // Convert to pixel coordinates
-    int i = static_cast<int>(u * width) % width;
-    int j = static_cast<int>(v * height) % height;
+    i = static_cast<int>(u * width) % width;
+    j = static_cast<int>(v * height) % height;
     if (i < 0)
       i += width;
     if (j < 0)
       j += height;
-
-    int idx = (j * width + i) * 3;
-
-    // Return color with intensity multiplier
-    return color(data[idx], data[idx + 1], data[idx + 2]) * intensity;
   }
 
-  int get_width() const { return width; }
-  int get_height() const { return height; }
-
-  // Intensity multiplier for the environment
-  double intensity;
+  // Build the marginal (rows) and conditional (columns per row) CDFs
+  void build_distribution();
 
-  // Rotation offset (radians around Y axis)
-  double rotation;
-
-private:
   std::vector<float> data; // Stored as linear RGB floats
   int width, height;
+
+  // Sampling distribution: unnormalized running sums of luminance x
+  // sin(theta). conditional_cdf has width+1 entries per row.
+  std::vector<float> conditional_cdf;
+  std::vector<double> marginal_cdf; // height+1 entries
+  double total_weight = 0.0;
 };
 
 #endif
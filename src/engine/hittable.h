@@ -5,15 +5,20 @@
 
 class material;
 class aabb;
+class hittable;
 
 struct hit_record {
   point3 p;
   vec3 normal;
   shared_ptr<material> mat_ptr;
+  int material_slot = -1; // mat_ptr's slot in world::materialTable (-1: none)
   double t;
   double u; // Texture U coordinate
   double v; // Texture V coordinate
   bool front_face;
+  const hittable *object = nullptr; // Primitive that produced this hit
+  double uv_density = 0.0; // UV units per world unit (0 when unknown)
+  double footprint = 0.0;  // Texture filter width in UV units (0 = finest)
 
   inline void set_face_normal(const ray &r, const vec3 &outward_normal) {
     front_face = dot(r.direction(), outward_normal) < 0;
@@ -29,6 +34,16 @@ public:
   // Compute bounding box for BVH acceleration
   // Returns true if the object has a finite bounding box, false otherwise
   virtual bool bounding_box(aabb &output_box) const = 0;
+
+  // Solid-angle pdf of sampling `direction` from `origin` towards this
+  // object. Only primitives usable as area lights override this.
+  virtual double pdf_value(const point3 &origin, const vec3 &direction) const {
+    return 0.0;
+  }
+
+  // Random direction from `origin` towards a uniformly chosen point on the
+  // object's surface.
+  virtual vec3 random(const point3 &origin) const { return vec3(1, 0, 0); }
 };
 
 #endif
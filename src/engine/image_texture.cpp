@@ -0,0 +1,490 @@
+#include "image_texture.h"
+#include "../util/logging.h"
+#include "color_space.h"
+#include "mesh_cache.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+// stb_image for loading - implementation is in stb_image_impl.cpp
+#include "../3rdParty/stb_image.h"
+
+namespace {
+
+constexpr int kTileShift = 5; // log2(image_texture::tile_size)
+constexpr int kTileMask = image_texture::tile_size - 1;
+constexpr int kTileTexels = image_texture::tile_size * image_texture::tile_size;
+static_assert(kTileTexels == texture_cache::tile_texels,
+              "texture_cache tiles must match image_texture tiles");
+
+constexpr char kMagic[8] = {'R', 'T', 'T', 'E', 'X', 0, 0, 0};
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kByteOrder = 0x01020304;
+
+/**
+ * @brief Header of a .rttex tile file; tiles follow at offset tile_bytes,
+ *        level by level and row by row within a level
+ */
+struct rttex_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t width, height;
+  uint32_t level_count, tile_count;
+  uint32_t space; // color_space of the stored bytes
+  uint32_t reserved;
+  uint64_t source_size;
+  int64_t source_mtime;
+};
+
+// Low 5 bits of v spread to the even bit positions, for every v < 32
+constexpr std::array<uint16_t, 32> kSpread = [] {
+  std::array<uint16_t, 32> table{};
+  for (uint32_t v = 0; v < 32; v++)
+    for (int bit = 0; bit < 5; bit++)
+      table[v] |= static_cast<uint16_t>(((v >> bit) & 1u) << (2 * bit));
+  return table;
+}();
+
+// Morton (Z-order) index of a texel inside its tile
+inline uint32_t morton(int x, int y) {
+  return kSpread[x & kTileMask] | (uint32_t(kSpread[y & kTileMask]) << 1);
+}
+
+/**
+ * @brief Build the mip pyramid of an RGB image and hand out its tiles in
+ *        file order
+ *
+ * Levels are averaged in linear space and stored back in `space`, so sRGB
+ * textures do not darken as they shrink.
+ */
+bool emit_tiles(const unsigned char *rgb, int width, int height,
+                color_space space,
+                const std::function<bool(const uint8_t *)> &emit) {
+  const float *decode = byte_decode_table(space);
+  // Untiled RGBA copy of the level being built (bytes in `space`)
+  std::vector<uint8_t> level(size_t(width) * height * 4);
+  for (size_t i = 0; i < size_t(width) * height; i++) {
+    level[i * 4] = rgb[i * 3];
+    level[i * 4 + 1] = rgb[i * 3 + 1];
+    level[i * 4 + 2] = rgb[i * 3 + 2];
+    level[i * 4 + 3] = 255;
+  }
+
+  std::vector<uint8_t> tile(texture_cache::tile_bytes);
+  while (true) {
+    const int tiles_x = (width + kTileMask) >> kTileShift;
+    const int tiles_y = (height + kTileMask) >> kTileShift;
+    for (int ty = 0; ty < tiles_y; ty++) {
+      for (int tx = 0; tx < tiles_x; tx++) {
+        std::fill(tile.begin(), tile.end(), 0);
+        const int x_end = std::min(width, (tx + 1) * image_texture::tile_size);
+        const int y_end = std::min(height, (ty + 1) * image_texture::tile_size);
+        for (int y = ty * image_texture::tile_size; y < y_end; y++) {
+          for (int x = tx * image_texture::tile_size; x < x_end; x++) {
+            std::copy_n(&level[(size_t(y) * width + x) * 4], 4,
+                        &tile[size_t(morton(x, y)) * 4]);
+          }
+        }
+        if (!emit(tile.data()))
+          return false;
+      }
+    }
+
+    if (width == 1 && height == 1)
+      return true;
+
+    // 2x2 box filter (edge texels are reused for odd sizes)
+    const int next_w = std::max(1, width / 2);
+    const int next_h = std::max(1, height / 2);
+    std::vector<uint8_t> next(size_t(next_w) * next_h * 4);
+    for (int y = 0; y < next_h; y++) {
+      const int y0 = std::min(2 * y, height - 1);
+      const int y1 = std::min(2 * y + 1, height - 1);
+      for (int x = 0; x < next_w; x++) {
+        const int x0 = std::min(2 * x, width - 1);
+        const int x1 = std::min(2 * x + 1, width - 1);
+        const uint8_t *p00 = &level[(size_t(y0) * width + x0) * 4];
+        const uint8_t *p10 = &level[(size_t(y0) * width + x1) * 4];
+        const uint8_t *p01 = &level[(size_t(y1) * width + x0) * 4];
+        const uint8_t *p11 = &level[(size_t(y1) * width + x1) * 4];
+        uint8_t *out = &next[(size_t(y) * next_w + x) * 4];
+        for (int c = 0; c < 3; c++) {
+          const float sum = decode[p00[c]] + decode[p10[c]] +
+                            decode[p01[c]] + decode[p11[c]];
+          out[c] = encode_byte(sum * 0.25f, space);
+        }
+        out[3] =
+            static_cast<uint8_t>((p00[3] + p10[3] + p01[3] + p11[3] + 2) / 4);
+      }
+    }
+    level = std::move(next);
+    width = next_w;
+    height = next_h;
+  }
+}
+
+} // namespace
+
+image_texture::~image_texture() {
+  // Detach first so no cache miss can read from the file while it closes
+  table.reset();
+  if (tiles)
+    std::fclose(tiles);
+}
+
+bool image_texture::load(const std::string &filename, color_space space) {
+  int width = 0, height = 0, components = 0;
+  if (!stbi_info(filename.c_str(), &width, &height, &components)) {
+    std::cerr << "ERROR: Could not load texture image: " << filename
+              << std::endl;
+    levels.clear();
+    return false;
+  }
+
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  name = filename;
+  this->space = space;
+  decode = byte_decode_table(space);
+  encoded.clear();
+  source_size = fs::file_size(filename, ec);
+  const auto mtime = fs::last_write_time(filename, ec);
+  source_mtime = ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+  layout(width, height);
+
+  if (!g_quiet.load())
+    std::cerr << "Loaded texture: " << filename << " (" << width << "x"
+              << height << ", " << levels.size() << " mip levels)"
+              << std::endl;
+  return true;
+}
+
+bool image_texture::load_from_memory(const unsigned char *bytes, size_t size,
+                                     const std::string &name,
+                                     color_space space) {
+  int width = 0, height = 0, components = 0;
+  if (!stbi_info_from_memory(bytes, static_cast<int>(size), &width, &height,
+                             &components)) {
+    std::cerr << "ERROR: Could not decode texture image: " << name
+              << std::endl;
+    levels.clear();
+    return false;
+  }
+
+  this->name = name;
+  this->space = space;
+  decode = byte_decode_table(space);
+  encoded.assign(bytes, bytes + size);
+  source_size = size;
+  source_mtime = 0;
+  layout(width, height);
+  return true;
+}
+
+void image_texture::layout(int width, int height) {
+  levels.clear();
+  tile_count = 0;
+  while (true) {
+    mip_level level;
+    level.width = width;
+    level.height = height;
+    level.tiles_x = (width + kTileMask) >> kTileShift;
+    level.first_tile = tile_count;
+    tile_count += uint32_t(level.tiles_x) * ((height + kTileMask) >> kTileShift);
+    levels.push_back(level);
+    if (width == 1 && height == 1)
+      break;
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+  }
+}
+
+bool image_texture::ensure_tiles() const {
+  std::call_once(prepared, [this] { ready = prepare(); });
+  return ready;
+}
+
+bool image_texture::open_tile_file(const std::string &path) const {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  rttex_header header;
+  const bool valid =
+      std::fread(&header, sizeof(header), 1, file) == 1 &&
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+      header.version == kVersion && header.byte_order == kByteOrder &&
+      header.width == uint32_t(levels[0].width) &&
+      header.height == uint32_t(levels[0].height) &&
+      header.level_count == levels.size() && header.tile_count == tile_count &&
+      header.space == uint32_t(space) &&
+      header.source_size == source_size &&
+      header.source_mtime == source_mtime;
+  if (!valid) {
+    std::fclose(file);
+    return false;
+  }
+  tiles = file;
+  return true;
+}
+
+bool image_texture::prepare() const {
+  if (levels.empty())
+    return false;
+
+  // Next to the image when possible, otherwise in the temp directory under
+  // a name derived from the image (embedded images use their content)
+  namespace fs = std::filesystem;
+  const std::string suffix =
+      space == color_space::linear ? ".linear.rttex" : ".rttex";
+  std::vector<std::string> candidates;
+  if (encoded.empty())
+    candidates.push_back(name + suffix);
+  {
+    const uint64_t seed = uint64_t(space);
+    const uint64_t hash =
+        encoded.empty()
+            ? mesh_cache::hash_bytes(name.data(), name.size(), seed)
+            : mesh_cache::hash_bytes(encoded.data(), encoded.size(), seed);
+    char file[32];
+    std::snprintf(file, sizeof(file), "%016llx",
+                  static_cast<unsigned long long>(hash));
+    std::error_code ec;
+    const fs::path temp = fs::temp_directory_path(ec);
+    if (!ec)
+      candidates.push_back((temp / file).string() + suffix);
+  }
+
+  bool opened = false;
+  for (const auto &path : candidates) {
+    if ((opened = open_tile_file(path)))
+      break;
+  }
+
+  if (!opened) {
+    int width = 0, height = 0, components = 0;
+    unsigned char *rgb =
+        encoded.empty()
+            ? stbi_load(name.c_str(), &width, &height, &components, 3)
+            : stbi_load_from_memory(encoded.data(),
+                                    static_cast<int>(encoded.size()), &width,
+                                    &height, &components, 3);
+    if (!rgb || width != levels[0].width || height != levels[0].height) {
+      std::cerr << "ERROR: Could not decode texture image: " << name
+                << std::endl;
+      stbi_image_free(rgb);
+      return false;
+    }
+
+    for (const auto &path : candidates) {
+      // Written under a unique temporary name, then renamed, so concurrent
+      // renders never read a partial file
+      const std::string tmp =
+          path + ".tmp" +
+          std::to_string(
+              std::hash<std::thread::id>()(std::this_thread::get_id()) &
+              0xffffff);
+      std::FILE *out = std::fopen(tmp.c_str(), "wb");
+      if (!out)
+        continue;
+      rttex_header header{};
+      std::memcpy(header.magic, kMagic, sizeof(kMagic));
+      header.version = kVersion;
+      header.byte_order = kByteOrder;
+      header.width = uint32_t(width);
+      header.height = uint32_t(height);
+      header.level_count = uint32_t(levels.size());
+      header.tile_count = tile_count;
+      header.space = uint32_t(space);
+      header.source_size = source_size;
+      header.source_mtime = source_mtime;
+      std::vector<uint8_t> first(texture_cache::tile_bytes, 0);
+      std::memcpy(first.data(), &header, sizeof(header));
+      bool ok = std::fwrite(first.data(), first.size(), 1, out) == 1 &&
+                emit_tiles(rgb, width, height, space, [&](const uint8_t *tile) {
+                  return std::fwrite(tile, texture_cache::tile_bytes, 1,
+                                     out) == 1;
+                });
+      ok = std::fclose(out) == 0 && ok;
+      std::error_code ec;
+      if (ok)
+        fs::rename(tmp, path, ec);
+      if (!ok || ec) {
+        fs::remove(tmp, ec);
+        continue;
+      }
+      if ((opened = open_tile_file(path)))
+        break;
+    }
+
+    if (!opened) {
+      // Nowhere to write: keep the pyramid in memory (outside the budget)
+      resident.reserve(size_t(tile_count) * texture_cache::tile_bytes);
+      emit_tiles(rgb, width, height, space, [&](const uint8_t *tile) {
+        resident.insert(resident.end(), tile,
+                        tile + texture_cache::tile_bytes);
+        return true;
+      });
+      if (g_verbose.load())
+        std::cerr << "Texture " << name
+                  << ": no writable tile file, keeping it in memory"
+                  << std::endl;
+    }
+    stbi_image_free(rgb);
+  }
+
+  encoded.clear();
+  encoded.shrink_to_fit();
+  table = texture_cache::instance().attach(
+      tile_count,
+      [this](uint32_t tile, uint8_t *dst) { return read_tile(tile, dst); });
+  return true;
+}
+
+bool image_texture::read_tile(uint32_t tile, uint8_t *dst) const {
+  // Called by texture_cache without its mutex, possibly from several
+  // threads at once
+  if (!resident.empty()) {
+    std::memcpy(dst, &resident[size_t(tile) * texture_cache::tile_bytes],
+                texture_cache::tile_bytes);
+    return true;
+  }
+  const uint64_t offset = (uint64_t(tile) + 1) * texture_cache::tile_bytes;
+#ifndef _WIN32
+  // Positional reads leave the shared file position alone
+  const int fd = fileno(tiles);
+  size_t done = 0;
+  while (done < texture_cache::tile_bytes) {
+    const ssize_t n = ::pread(fd, dst + done, texture_cache::tile_bytes - done,
+                              static_cast<off_t>(offset + done));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    done += size_t(n);
+  }
+  return true;
+#else
+  std::lock_guard<std::mutex> lock(tiles_mutex);
+  return std::fseek(tiles, static_cast<long>(offset), SEEK_SET) == 0 &&
+         std::fread(dst, texture_cache::tile_bytes, 1, tiles) == 1;
+#endif
+}
+
+void image_texture::fetch(const mip_level &level, const int x[2],
+                          const int y[2], uint32_t out[4]) const {
+  // out = (x0,y0), (x1,y0), (x0,y1), (x1,y1) as packed RGBA8
+  texture_cache &cache = texture_cache::instance();
+  auto tile_of = [&](int tx, int ty) {
+    return level.first_tile + uint32_t(ty >> kTileShift) * level.tiles_x +
+           uint32_t(tx >> kTileShift);
+  };
+  const uint32_t texels[4] = {morton(x[0], y[0]), morton(x[1], y[0]),
+                              morton(x[0], y[1]), morton(x[1], y[1])};
+
+  bool ok;
+  if ((x[0] >> kTileShift) == (x[1] >> kTileShift) &&
+      (y[0] >> kTileShift) == (y[1] >> kTileShift)) {
+    // Common case: the whole quad lies in one tile
+    ok = cache.read(*table, tile_of(x[0], y[0]), texels, 4, out);
+  } else {
+    ok = true;
+    for (int i = 0; i < 4; i++)
+      ok &= cache.read(*table, tile_of(x[i & 1], y[i >> 1]), &texels[i], 1,
+                       &out[i]);
+  }
+  if (!ok) {
+    const uint8_t magenta[4] = {255, 0, 255, 255};
+    for (int i = 0; i < 4; i++)
+      std::memcpy(&out[i], magenta, 4);
+  }
+}
+
+void image_texture::bilinear(const mip_level &level, double u, double v,
+                             rgba &out) const {
+  // Repeat wrapping, then flip V (image is stored top-to-bottom)
+  u = u - std::floor(u);
+  v = v - std::floor(v);
+  v = 1.0 - v;
+
+  double fx = u * level.width - 0.5;
+  double fy = v * level.height - 0.5;
+
+  int x0 = static_cast<int>(std::floor(fx));
+  int y0 = static_cast<int>(std::floor(fy));
+
+  // Fractional parts for interpolation
+  const float tx = static_cast<float>(fx - x0);
+  const float ty = static_cast<float>(fy - y0);
+
+  // Clamp to valid range
+  const int x[2] = {std::clamp(x0, 0, level.width - 1),
+                    std::clamp(x0 + 1, 0, level.width - 1)};
+  const int y[2] = {std::clamp(y0, 0, level.height - 1),
+                    std::clamp(y0 + 1, 0, level.height - 1)};
+  uint32_t packed[4];
+  fetch(level, x, y, packed);
+
+  // Decode through the color space table, then blend all four channels at
+  // once
+  const float weight[4] = {(1.0f - tx) * (1.0f - ty), tx * (1.0f - ty),
+                           (1.0f - tx) * ty, tx * ty};
+  rgba sum{{0.0f, 0.0f, 0.0f, 0.0f}};
+  for (int i = 0; i < 4; i++) {
+    uint8_t pixel[4];
+    std::memcpy(pixel, &packed[i], 4);
+    const rgba c{{decode[pixel[0]], decode[pixel[1]], decode[pixel[2]],
+                  pixel[3] * (1.0f / 255.0f)}};
+    for (int k = 0; k < 4; k++)
+      sum.c[k] += c.c[k] * weight[i];
+  }
+  out = sum;
+}
+
+color image_texture::value(double u, double v, const point3 &p) const {
+  (void)p; // Unused for image textures
+
+  // Return magenta for missing texture (easy to spot)
+  if (!ensure_tiles()) {
+    return color(1.0, 0.0, 1.0);
+  }
+  rgba c;
+  bilinear(levels[0], u, v, c);
+  return color(c.c[0], c.c[1], c.c[2]);
+}
+
+color image_texture::filtered_value(double u, double v, const point3 &p,
+                                    double width) const {
+  if (width <= 0.0 || !ensure_tiles()) {
+    return value(u, v, p);
+  }
+
+  // Level whose texel size matches the footprint
+  const int size = std::max(levels[0].width, levels[0].height);
+  const double lod = std::log2(width * size);
+  const int last = static_cast<int>(levels.size()) - 1;
+  rgba c;
+  if (lod <= 0.0 || lod >= last) {
+    bilinear(levels[lod <= 0.0 ? 0 : last], u, v, c);
+    return color(c.c[0], c.c[1], c.c[2]);
+  }
+
+  const int l0 = static_cast<int>(lod);
+  const float t = static_cast<float>(lod - l0);
+  rgba fine, coarse;
+  bilinear(levels[l0], u, v, fine);
+  bilinear(levels[l0 + 1], u, v, coarse);
+  for (int k = 0; k < 4; k++)
+    c.c[k] = fine.c[k] + (coarse.c[k] - fine.c[k]) * t;
+  return color(c.c[0], c.c[1], c.c[2]);
+}
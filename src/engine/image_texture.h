@@ -1,119 +1,109 @@
 #ifndef IMAGE_TEXTURE_H
 #define IMAGE_TEXTURE_H
 
+#include "color_space.h"
 #include "texture.h"
-#include <cmath>
-#include <iostream>
+#include "texture_cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
-// stb_image for loading - implementation is in stb_image_impl.cpp
-#include "../3rdParty/stb_image.h"
-
 /**
  * @brief Image-based texture loaded from file
  *
- * Supports PNG, JPG, and other common formats via stb_image.
- * Provides bilinear filtering for smooth sampling.
+ * Supports PNG, JPG, and other common formats via stb_image. Texels are
+ * stored as bytes in the texture's declared color space and decoded to
+ * linear floats through a 256-entry table on lookup. Loading only
+ * reads the image header. The first lookup decodes the image into a mip
+ * pyramid (2x2 box filter down to 1x1) of 32x32 tiles, texels of a tile
+ * in Morton order, and writes it to a tile file (image.png.rttex) that
+ * later runs reuse. Texels are then paged in a tile at a time through the
+ * shared texture_cache, which bounds resident texture memory. Mip levels
+ * are averaged in linear space.
+ *
+ * value() is a bilinear lookup of the full-resolution level.
+ * filtered_value() blends the two levels whose texel size brackets the
+ * footprint (trilinear filtering).
  */
 class image_texture : public texture {
 public:
-  image_texture() : data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
-
-  image_texture(const std::string &filename) { load(filename); }
-
-  ~image_texture() {
-    if (data) {
-      stbi_image_free(data);
-    }
-  }
+  static constexpr int tile_size = 32; // Texels per tile side
 
-  bool load(const std::string &filename) {
-    int components_per_pixel = 3;
-    data =
-        stbi_load(filename.c_str(), &width, &height, &components_per_pixel, 3);
-
-    if (!data) {
-      std::cerr << "ERROR: Could not load texture image: " << filename
-                << std::endl;
-      width = height = 0;
-      return false;
-    }
-
-    bytes_per_scanline = 3 * width;
-    std::cerr << "Loaded texture: " << filename << " (" << width << "x"
-              << height << ")" << std::endl;
-    return true;
+  image_texture() {}
+  image_texture(const std::string &filename,
+                color_space space = color_space::srgb) {
+    load(filename, space);
   }
+  ~image_texture();
 
-  bool is_valid() const { return data != nullptr; }
-
-  virtual color value(double u, double v, const point3 &p) const override {
-    (void)p; // Unused for image textures
-
-    // Return magenta for missing texture (easy to spot)
-    if (!data) {
-      return color(1.0, 0.0, 1.0);
-    }
-
-    // Clamp UV coordinates to [0,1] with repeat wrapping
-    u = u - std::floor(u);
-    v = v - std::floor(v);
+  bool load(const std::string &filename,
+            color_space space = color_space::srgb);
 
-    // Flip V coordinate (image is stored top-to-bottom)
-    v = 1.0 - v;
+  /**
+   * @brief Use an encoded image (PNG, JPG, ...) held in memory, e.g. an
+   *        image embedded in a GLB buffer. The bytes are copied and decoded
+   *        on first use.
+   */
+  bool load_from_memory(const unsigned char *bytes, size_t size,
+                        const std::string &name,
+                        color_space space = color_space::srgb);
 
-    // Bilinear filtering: sample 4 neighboring pixels and interpolate
-    double fx = u * width - 0.5;
-    double fy = v * height - 0.5;
+  bool is_valid() const { return !levels.empty(); }
 
-    int x0 = static_cast<int>(std::floor(fx));
-    int y0 = static_cast<int>(std::floor(fy));
-    int x1 = x0 + 1;
-    int y1 = y0 + 1;
+  virtual color value(double u, double v, const point3 &p) const override;
+  virtual color filtered_value(double u, double v, const point3 &p,
+                               double width) const override;
 
-    // Fractional parts for interpolation
-    double tx = fx - x0;
-    double ty = fy - y0;
-
-    // Sample 4 corners with wrapping
-    color c00 = sample_pixel(x0, y0);
-    color c10 = sample_pixel(x1, y0);
-    color c01 = sample_pixel(x0, y1);
-    color c11 = sample_pixel(x1, y1);
-
-    // Bilinear interpolation
-    color c0 = c00 * (1.0 - tx) + c10 * tx; // Top edge
-    color c1 = c01 * (1.0 - tx) + c11 * tx; // Bottom edge
-    return c0 * (1.0 - ty) + c1 * ty;       // Final blend
-  }
-
-  int get_width() const { return width; }
-  int get_height() const { return height; }
+  int get_width() const { return levels.empty() ? 0 : levels[0].width; }
+  int get_height() const { return levels.empty() ? 0 : levels[0].height; }
+  int level_count() const { return static_cast<int>(levels.size()); }
+  color_space encoding() const { return space; }
 
 private:
-  // Helper to sample a single pixel with clamping
-  color sample_pixel(int i, int j) const {
-    // Clamp to valid range
-    if (i < 0)
-      i = 0;
-    if (i >= width)
-      i = width - 1;
-    if (j < 0)
-      j = 0;
-    if (j >= height)
-      j = height - 1;
-
-    const double color_scale = 1.0 / 255.0;
-    unsigned char *pixel = data + j * bytes_per_scanline + i * 3;
-
-    return color(color_scale * pixel[0], color_scale * pixel[1],
-                 color_scale * pixel[2]);
-  }
-
-  unsigned char *data;
-  int width, height;
-  int bytes_per_scanline;
+  struct mip_level {
+    int width = 0, height = 0;
+    int tiles_x = 0;
+    uint32_t first_tile = 0; // Index of the level's first tile
+  };
+
+  // Linear RGBA, aligned so blends compile to vector ops
+  struct alignas(16) rgba {
+    float c[4];
+  };
+
+  void layout(int width, int height);
+  bool ensure_tiles() const;
+  bool prepare() const;
+  bool open_tile_file(const std::string &path) const;
+  bool read_tile(uint32_t tile, uint8_t *dst) const;
+  void fetch(const mip_level &level, const int x[2], const int y[2],
+             uint32_t out[4]) const;
+  void bilinear(const mip_level &level, double u, double v, rgba &out) const;
+
+  std::string name;
+  color_space space = color_space::srgb;
+  const float *decode = byte_decode_table(color_space::srgb);
+  uint64_t source_size = 0;
+  int64_t source_mtime = 0;
+  std::vector<mip_level> levels;
+  uint32_t tile_count = 0;
+
+  // Bytes from load_from_memory, released once decoded
+  mutable std::vector<unsigned char> encoded;
+
+  // Set up by the first lookup
+  mutable std::once_flag prepared;
+  mutable bool ready = false;
+  mutable std::FILE *tiles = nullptr;
+#ifdef _WIN32
+  mutable std::mutex tiles_mutex; // No pread: seek and read as one step
+#endif
+  mutable std::vector<uint8_t> resident; // When no tile file is writable
+  mutable std::unique_ptr<texture_cache::table> table;
 };
 
 #endif
@@ -0,0 +1,127 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+#include <unordered_map>
+
+/**
+ * @brief Instance wrapper that places a hittable with an affine transform
+ *
+ * Like translate and rotate_y, the ray is moved into object space instead
+ * of moving the geometry, so many instances can share one mesh and its
+ * BVH. The direction is not renormalized, which keeps t identical in
+ * both spaces.
+ */
+class instance : public hittable {
+public:
+  instance(shared_ptr<hittable> p, const glm::mat4 &object_to_world)
+      : ptr(p) {
+    set_transform(object_to_world);
+  }
+
+  // Replace the transform in place (the wrapped object's BVH is untouched)
+  void set_transform(const glm::mat4 &object_to_world) {
+    const glm::mat4 world_to_object = glm::inverse(object_to_world);
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++) {
+        // glm is column-major: m[col][row]
+        to_world[row][col] = object_to_world[col][row];
+        to_object[row][col] = world_to_object[col][row];
+      }
+    }
+
+    // Transform the 8 corners of the object-space box
+    aabb box;
+    has_box = ptr->bounding_box(box);
+    if (has_box) {
+      const double inf = std::numeric_limits<double>::infinity();
+      point3 min_p(inf, inf, inf), max_p(-inf, -inf, -inf);
+      for (int i = 0; i < 8; i++) {
+        point3 corner((i & 1) ? box.max().x() : box.min().x(),
+                      (i & 2) ? box.max().y() : box.min().y(),
+                      (i & 4) ? box.max().z() : box.min().z());
+        point3 p = apply(to_world, corner, 1.0);
+        for (int c = 0; c < 3; c++) {
+          min_p[c] = fmin(min_p[c], p[c]);
+          max_p[c] = fmax(max_p[c], p[c]);
+        }
+      }
+      bbox = aabb(min_p, max_p);
+    }
+  }
+
+  virtual bool hit(const ray &r, double t_min, double t_max,
+                   hit_record &rec) const override {
+    ray local(apply(to_object, r.origin(), 1.0),
+              apply(to_object, r.direction(), 0.0), r.time());
+
+    if (!ptr->hit(local, t_min, t_max, rec))
+      return false;
+
+    // Hits on a shared emitter are reported as this placement's light
+    if (!light_surfaces.empty()) {
+      auto it = light_surfaces.find(rec.object);
+      if (it != light_surfaces.end())
+        rec.object = it->second;
+    }
+
+    // Normals transform with the inverse transpose
+    const vec3 outward = rec.front_face ? rec.normal : -rec.normal;
+    vec3 n(to_object[0][0] * outward.x() + to_object[1][0] * outward.y() +
+               to_object[2][0] * outward.z(),
+           to_object[0][1] * outward.x() + to_object[1][1] * outward.y() +
+               to_object[2][1] * outward.z(),
+           to_object[0][2] * outward.x() + to_object[1][2] * outward.y() +
+               to_object[2][2] * outward.z());
+
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, unit_vector(n));
+    return true;
+  }
+
+  virtual bool bounding_box(aabb &output_box) const override {
+    output_box = bbox;
+    return has_box;
+  }
+
+  point3 world_point(const point3 &p) const { return apply(to_world, p, 1.0); }
+
+  glm::mat4 transform() const {
+    glm::mat4 object_to_world(1.0f);
+    for (int row = 0; row < 3; row++) {
+      for (int col = 0; col < 4; col++) {
+        object_to_world[col][row] = static_cast<float>(to_world[row][col]);
+      }
+    }
+    return object_to_world;
+  }
+
+public:
+  shared_ptr<hittable> ptr;
+  double to_world[3][4];
+  double to_object[3][4];
+  bool has_box = false;
+  aabb bbox;
+
+  // Object-space emitter -> the world-space copy world::buildLights samples
+  // for this instance. The wrapped primitives are shared by every
+  // instance, so this is what tells their lights apart.
+  std::unordered_map<const hittable *, const hittable *> light_surfaces;
+
+private:
+  // w = 1 for points, 0 for directions
+  static vec3 apply(const double m[3][4], const vec3 &v, double w) {
+    return vec3(m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z() +
+                    m[0][3] * w,
+                m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z() +
+                    m[1][3] * w,
+                m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z() +
+                    m[2][3] * w);
+  }
+};
+
+#endif
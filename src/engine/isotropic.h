@@ -24,6 +24,36 @@ public:
     return true;
   }
 
+  // Phase function value (no cosine term inside a medium)
+  virtual color eval(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return albedo->value(rec.u, rec.v, rec.p) / (4.0 * M_PI);
+  }
+
+  virtual double pdf(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return 1.0 / (4.0 * M_PI);
+  }
+
+  virtual bool sample(const hit_record &rec, const vec3 &wo, double u1,
+                      double u2, bsdf_sample &s) const override {
+    // Uniform direction on the sphere
+    double z = 1.0 - 2.0 * u1;
+    double r = sqrt(fmax(0.0, 1.0 - z * z));
+    double phi = 2.0 * M_PI * u2;
+    s.wi = vec3(r * cos(phi), r * sin(phi), z);
+    s.pdf = 1.0 / (4.0 * M_PI);
+    s.weight = albedo->value(rec.u, rec.v, rec.p);
+    s.is_delta = false;
+    return true;
+  }
+
+  virtual bool is_surface() const override { return false; }
+
+  virtual color guide_albedo(const hit_record &rec) const override {
+    return albedo->value(rec.u, rec.v, rec.p);
+  }
+
 public:
   shared_ptr<texture> albedo;
 };
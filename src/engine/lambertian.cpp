@@ -1,5 +1,6 @@
 
 #include "lambertian.h"
+#include "onb.h"
 
 bool lambertian::scatter(
     const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
@@ -12,4 +13,28 @@ bool lambertian::scatter(
     scattered = ray(rec.p, scatter_direction);
     attenuation = albedo;
     return true;
+}
+
+color lambertian::eval(const hit_record& rec, const vec3& wo, const vec3& wi) const {
+    double cosine = dot(rec.normal, wi);
+    return cosine > 0 ? albedo * (cosine / M_PI) : color(0, 0, 0);
+}
+
+double lambertian::pdf(const hit_record& rec, const vec3& wo, const vec3& wi) const {
+    double cosine = dot(rec.normal, wi);
+    return cosine > 0 ? cosine / M_PI : 0.0;
+}
+
+bool lambertian::sample(
+    const hit_record& rec, const vec3& wo, double u1, double u2, bsdf_sample& s) const {
+    // Cosine-weighted hemisphere: eval / pdf reduces to the albedo
+    onb uvw;
+    uvw.build_from_w(rec.normal);
+    double phi = 2 * M_PI * u1;
+    double r = sqrt(u2);
+    s.wi = uvw.local(r * cos(phi), r * sin(phi), sqrt(1 - u2));
+    s.pdf = pdf(rec, wo, s.wi);
+    s.weight = albedo;
+    s.is_delta = false;
+    return s.pdf > 0;
 }
\ No newline at end of file
@@ -12,6 +12,12 @@ class lambertian : public material {
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override ;
 
+        virtual color eval(const hit_record& rec, const vec3& wo, const vec3& wi) const override;
+        virtual double pdf(const hit_record& rec, const vec3& wo, const vec3& wi) const override;
+        virtual bool sample(
+            const hit_record& rec, const vec3& wo, double u1, double u2, bsdf_sample& s) const override;
+        virtual color guide_albedo(const hit_record& rec) const override { return albedo; }
+
     public:
         color albedo;
 };
@@ -4,6 +4,7 @@
 #include "../util/vec3.h"
 #include "hittable.h"
 #include "material.h"
+#include "onb.h"
 #include "texture.h"
 
 /**
@@ -33,11 +34,44 @@ public:
     scattered = ray(rec.p, scatter_direction);
 
     // Sample texture at UV coordinates
-    attenuation = albedo->value(rec.u, rec.v, rec.p);
+    attenuation = albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint);
 
     return true;
   }
 
+  virtual color eval(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    double cosine = dot(rec.normal, wi);
+    if (cosine <= 0)
+      return color(0, 0, 0);
+    return albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint) *
+           (cosine / M_PI);
+  }
+
+  virtual double pdf(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    double cosine = dot(rec.normal, wi);
+    return cosine > 0 ? cosine / M_PI : 0.0;
+  }
+
+  virtual bool sample(const hit_record &rec, const vec3 &wo, double u1,
+                      double u2, bsdf_sample &s) const override {
+    // Cosine-weighted hemisphere: eval / pdf reduces to the texture color
+    onb uvw;
+    uvw.build_from_w(rec.normal);
+    double phi = 2.0 * M_PI * u1;
+    double r = sqrt(u2);
+    s.wi = uvw.local(r * cos(phi), r * sin(phi), sqrt(1.0 - u2));
+    s.pdf = pdf(rec, wo, s.wi);
+    s.weight = albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint);
+    s.is_delta = false;
+    return s.pdf > 0;
+  }
+
+  virtual color guide_albedo(const hit_record &rec) const override {
+    return albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint);
+  }
+
 public:
   shared_ptr<texture> albedo;
 };
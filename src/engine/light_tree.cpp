@@ -0,0 +1,156 @@
+#include "light_tree.h"
+
+#include <algorithm>
+#include <cmath>
+
+void light_tree::build(const std::vector<scene_light> &lights) {
+  nodes.clear();
+  leaf_of_light.assign(lights.size(), -1);
+  max_depth = 0;
+
+  if (lights.empty()) {
+    return;
+  }
+
+  std::vector<int> order(lights.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = static_cast<int>(i);
+  }
+
+  nodes.reserve(2 * lights.size());
+  build_recursive(lights, order, 0, order.size(), -1, 0);
+}
+
+int light_tree::build_recursive(const std::vector<scene_light> &lights,
+                                std::vector<int> &order, size_t start,
+                                size_t end, int parent, int depth) {
+  const int index = static_cast<int>(nodes.size());
+  nodes.emplace_back();
+  nodes[index].parent = parent;
+  max_depth = std::max(max_depth, depth);
+
+  if (end - start == 1) {
+    const scene_light &light = lights[order[start]];
+    nodes[index].bounds = light.bounds;
+    nodes[index].power = light.power;
+    nodes[index].light = order[start];
+    leaf_of_light[order[start]] = index;
+    return index;
+  }
+
+  // Split at the median along the longest axis of the light centroids
+  aabb centroid_bounds;
+  for (size_t i = start; i < end; i++) {
+    const aabb &b = lights[order[i]].bounds;
+    point3 c = 0.5 * (b.min() + b.max());
+    centroid_bounds =
+        (i == start) ? aabb(c, c) : surrounding_box(centroid_bounds, aabb(c, c));
+  }
+  const int axis = centroid_bounds.longest_axis();
+  const size_t mid = start + (end - start) / 2;
+  std::nth_element(order.begin() + start, order.begin() + mid,
+                   order.begin() + end, [&](int a, int b) {
+                     const aabb &ba = lights[a].bounds;
+                     const aabb &bb = lights[b].bounds;
+                     return ba.min()[axis] + ba.max()[axis] <
+                            bb.min()[axis] + bb.max()[axis];
+                   });
+
+  const int left = build_recursive(lights, order, start, mid, index, depth + 1);
+  const int right = build_recursive(lights, order, mid, end, index, depth + 1);
+
+  nodes[index].left = left;
+  nodes[index].right = right;
+  nodes[index].bounds = surrounding_box(nodes[left].bounds, nodes[right].bounds);
+  nodes[index].power = nodes[left].power + nodes[right].power;
+  return index;
+}
+
+double light_tree::importance(const node &nd, const point3 &p,
+                              const vec3 &n) const {
+  if (nd.power <= 0.0) {
+    return 0.0;
+  }
+
+  const point3 lo = nd.bounds.min();
+  const point3 hi = nd.bounds.max();
+
+  // Reject clusters that lie completely below the shading hemisphere
+  if (!n.near_zero()) {
+    double max_height = -INF;
+    for (int corner = 0; corner < 8; corner++) {
+      point3 c((corner & 1) ? hi.x() : lo.x(), (corner & 2) ? hi.y() : lo.y(),
+               (corner & 4) ? hi.z() : lo.z());
+      max_height = std::max(max_height, dot(c - p, n));
+    }
+    if (max_height <= 0.0) {
+      return 0.0;
+    }
+  }
+
+  // Power over squared distance, clamped to the cluster radius so the
+  // estimate stays finite when the point is inside (or very near) the box
+  const point3 center = 0.5 * (lo + hi);
+  const double dist_sq = (center - p).length_squared();
+  const double radius_sq = 0.25 * (hi - lo).length_squared();
+  return nd.power / std::max({dist_sq, radius_sq, 1e-8});
+}
+
+bool light_tree::sample(const point3 &p, const vec3 &n, double u,
+                        int &light_index, double &pmf) const {
+  if (nodes.empty()) {
+    return false;
+  }
+
+  int current = 0;
+  pmf = 1.0;
+  while (nodes[current].light < 0) {
+    const node &nd = nodes[current];
+    const double w_left = importance(nodes[nd.left], p, n);
+    const double w_right = importance(nodes[nd.right], p, n);
+    const double total = w_left + w_right;
+    if (total <= 0.0) {
+      return false;
+    }
+
+    // Reuse the random number for the next level
+    const double p_left = w_left / total;
+    if (u < p_left) {
+      u = std::min(u / p_left, 1.0 - 1e-12);
+      pmf *= p_left;
+      current = nd.left;
+    } else {
+      u = std::min((u - p_left) / (1.0 - p_left), 1.0 - 1e-12);
+      pmf *= 1.0 - p_left;
+      current = nd.right;
+    }
+  }
+
+  light_index = nodes[current].light;
+  return pmf > 0.0;
+}
+
+double light_tree::pmf(const point3 &p, const vec3 &n, int light_index) const {
+  if (light_index < 0 ||
+      light_index >= static_cast<int>(leaf_of_light.size())) {
+    return 0.0;
+  }
+
+  // Walk from the leaf up to the root, multiplying the branch probabilities
+  double result = 1.0;
+  int child = leaf_of_light[light_index];
+  int parent = nodes[child].parent;
+  while (parent >= 0) {
+    const node &nd = nodes[parent];
+    const double w_left = importance(nodes[nd.left], p, n);
+    const double w_right = importance(nodes[nd.right], p, n);
+    const double total = w_left + w_right;
+    if (total <= 0.0) {
+      return 0.0;
+    }
+    result *= ((child == nd.left) ? w_left : w_right) / total;
+    child = parent;
+    parent = nd.parent;
+  }
+  return result;
+}
@@ -0,0 +1,93 @@
+#ifndef LIGHT_TREE_H
+#define LIGHT_TREE_H
+
+#include "../util/vec3.h"
+#include "aabb.h"
+#include <memory>
+#include <vector>
+
+class hittable;
+class PointLight;
+
+/**
+ * @brief A light source that can be picked by the light tree
+ *
+ * Exactly one of `point` or `emitter` is set. Emitters are primitives
+ * (triangles, quads) whose material has non-zero emission; they are sampled
+ * through hittable::random / hittable::pdf_value.
+ */
+struct scene_light {
+  std::shared_ptr<PointLight> point;
+  std::shared_ptr<hittable> emitter;
+  // Primitive that rays report in hit_record::object for this light: the
+  // emitter itself, also for the world-space copies of instanced emitters
+  // (see instance::light_surfaces)
+  const hittable *surface = nullptr;
+  aabb bounds;
+  double power; // Luminance-weighted emitted power used for importance
+};
+
+/**
+ * @brief Light hierarchy (light BVH) for many-light sampling
+ *
+ * Lights are clustered into a binary tree of bounding boxes. To pick a light
+ * for a shading point, the tree is traversed from the root and at every node
+ * a child is chosen with probability proportional to an importance estimate
+ * (cluster power over squared distance, zero when the cluster lies entirely
+ * below the surface). Cost per shading point is O(log n) instead of one
+ * shadow ray per light, and the returned probability is exact so the
+ * estimator stays unbiased.
+ */
+class light_tree {
+public:
+  light_tree() {}
+
+  /**
+   * @brief Build the hierarchy over the given lights
+   * @param lights Light list; indices into it are returned by sample()
+   */
+  void build(const std::vector<scene_light> &lights);
+
+  bool empty() const { return nodes.empty(); }
+
+  /**
+   * @brief Pick one light for the shading point (p, n)
+   * @param p Shading position
+   * @param n Surface normal (zero vector disables the hemisphere test)
+   * @param u Uniform random number in [0,1)
+   * @param light_index Output index into the light list
+   * @param pmf Output probability of having picked that light
+   * @return false if no light can contribute to this point
+   */
+  bool sample(const point3 &p, const vec3 &n, double u, int &light_index,
+              double &pmf) const;
+
+  /**
+   * @brief Probability that sample() picks `light_index` at (p, n)
+   */
+  double pmf(const point3 &p, const vec3 &n, int light_index) const;
+
+  int depth() const { return max_depth; }
+
+private:
+  struct node {
+    aabb bounds;
+    double power = 0.0;
+    int left = -1;  // Child node indices (-1 for leaves)
+    int right = -1;
+    int parent = -1;
+    int light = -1; // Light index for leaves
+  };
+
+  std::vector<node> nodes;
+  std::vector<int> leaf_of_light; // Light index -> leaf node index
+  int max_depth = 0;
+
+  int build_recursive(const std::vector<scene_light> &lights,
+                      std::vector<int> &order, size_t start, size_t end,
+                      int parent, int depth);
+
+  double importance(const node &nd, const point3 &p, const vec3 &n) const;
+};
+
+#endif
@@ -6,6 +6,15 @@
 
 struct hit_record;
 
+// Result of sampling a material's BSDF
+struct bsdf_sample {
+  vec3 wi;          // Sampled direction (unit, pointing away from surface)
+  color weight;     // eval(wo, wi) / pdf, or the lobe's throughput if delta
+  double pdf = 0.0; // Solid-angle pdf of wi (0 for delta lobes)
+  bool is_delta = false; // Specular lobe: cannot be combined with light
+                         // sampling
+};
+
 class material {
 public:
   virtual bool scatter(const ray &r_in, const hit_record &rec,
@@ -16,6 +25,51 @@ public:
     return color(0, 0, 0);
   }
 
+  // BSDF interface used by the integrator. wo points towards the viewer and
+  // wi towards the light; both are unit vectors.
+
+  // BSDF value times |cos(theta_i)| (zero for delta lobes)
+  virtual color eval(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const {
+    return color(0, 0, 0);
+  }
+
+  // Solid-angle pdf of sample() generating wi (zero for delta lobes)
+  virtual double pdf(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const {
+    return 0.0;
+  }
+
+  // Sample an incident direction from two uniform random numbers. Materials
+  // without an analytic BSDF fall back to scatter() and report a delta lobe,
+  // so they are never MIS-combined with area or environment light sampling.
+  virtual bool sample(const hit_record &rec, const vec3 &wo, double u1,
+                      double u2, bsdf_sample &s) const {
+    ray scattered;
+    if (!scatter(ray(point3(0, 0, 0), -wo), rec, s.weight, scattered)) {
+      return false;
+    }
+    s.wi = unit_vector(scattered.direction());
+    s.pdf = 0.0;
+    s.is_delta = true;
+    return true;
+  }
+
+  // True when scatter() only follows a single mirror or refraction direction.
+  // Non-specular materials that fall back to scatter() still receive point
+  // lights, which need no MIS, through a diffuse approximation.
+  virtual bool is_specular() const { return false; }
+
+  // False for participating media (phase functions), where the hit normal
+  // is arbitrary and must not be used for hemisphere tests
+  virtual bool is_surface() const { return true; }
+
+  // Base color at the hit, used for guide images (preview upsampling,
+  // denoising). Materials without one (lights) report white.
+  virtual color guide_albedo(const hit_record &rec) const {
+    return color(1, 1, 1);
+  }
+
   virtual ~material() = default;
 };
 
@@ -0,0 +1,51 @@
+#include "material_table.h"
+#include <typeinfo>
+
+namespace {
+
+// Append a by-value copy of `m` if it is exactly of type T
+template <typename T>
+bool pack_as(const std::shared_ptr<material> &m,
+             std::vector<material_table::entry> &entries) {
+  // Subclasses may override the shading calls, so they are not packed
+  if (typeid(*m) != typeid(T)) {
+    return false;
+  }
+  entries.emplace_back(std::in_place_type<T>, static_cast<const T &>(*m));
+  return true;
+}
+
+} // namespace
+
+size_t material_table::build(
+    const std::vector<std::shared_ptr<material>> &materials) {
+  clear();
+
+  for (const auto &m : materials) {
+    if (!m || slots.count(m.get())) {
+      continue; // Null or already packed (shared between objects)
+    }
+
+    const int slot = static_cast<int>(entries.size());
+    const bool packed =
+        pack_as<lambertian>(m, entries) ||
+        pack_as<lambertian_textured>(m, entries) ||
+        pack_as<metal>(m, entries) || pack_as<dielectric>(m, entries) ||
+        pack_as<pbr_material>(m, entries) ||
+        pack_as<ggx_material>(m, entries) ||
+        pack_as<sss_material>(m, entries) || pack_as<emissive>(m, entries) ||
+        pack_as<isotropic>(m, entries);
+    if (packed) {
+      slots.emplace(m.get(), slot);
+      sources.push_back(m);
+    }
+  }
+
+  return entries.size();
+}
+
+void material_table::clear() {
+  slots.clear();
+  sources.clear();
+  entries.clear();
+}
@@ -0,0 +1,178 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include "dielectric.h"
+#include "emissive.h"
+#include "ggx_material.h"
+#include "hittable.h"
+#include "isotropic.h"
+#include "lambertian.h"
+#include "lambertian_textured.h"
+#include "material.h"
+#include "metal.h"
+#include "pbr_material.h"
+#include "sss_material.h"
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Closed, contiguous copy of the scene's materials
+ *
+ * Every known material type is stored by value in a std::variant, and
+ * calls are dispatched with a switch on the variant index followed by a
+ * qualified (non-virtual) member call. This lets the compiler inline the
+ * shading code instead of going through the material vtable on every
+ * bounce. Materials of unknown types have no slot and use the virtual
+ * path. Slots are kept in the table, not in the materials, so a material
+ * shared by several worlds can be packed by each of them.
+ *
+ * build() only assigns the slots; world::buildMaterialTable() then stores
+ * each one in the primitives using that material, which copy it into
+ * hit_record::material_slot, so no lookup happens while shading. All entry
+ * points take the hit record and fall back to virtual dispatch when the
+ * table is disabled or the hit carries no slot of this table, so the
+ * integrator can call them unconditionally.
+ */
+class material_table {
+public:
+  using entry =
+      std::variant<lambertian, lambertian_textured, metal, dielectric,
+                   pbr_material, ggx_material, sss_material, emissive,
+                   isotropic>;
+
+  material_table() {}
+  ~material_table() { clear(); }
+  material_table(const material_table &) = delete;
+  material_table &operator=(const material_table &) = delete;
+
+  /**
+   * @brief Pack the given materials and assign them table slots
+   * @return Number of materials packed
+   */
+  size_t build(const std::vector<std::shared_ptr<material>> &materials);
+
+  void clear();
+
+  size_t size() const { return entries.size(); }
+
+  // Slot assigned to `m` by build(), or -1 when it was not packed
+  int slot_of(const material *m) const {
+    auto it = slots.find(m);
+    return it == slots.end() ? -1 : it->second;
+  }
+
+  // Use the packed copies (false: always go through the vtable)
+  bool enabled = false;
+
+  color emitted(const hit_record &rec) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::emitted(rec.u, rec.v, rec.p);
+      });
+    }
+    return rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+  }
+
+  color eval(const hit_record &rec, const vec3 &wo, const vec3 &wi) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::eval(rec, wo, wi);
+      });
+    }
+    return rec.mat_ptr->eval(rec, wo, wi);
+  }
+
+  double pdf(const hit_record &rec, const vec3 &wo, const vec3 &wi) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::pdf(rec, wo, wi);
+      });
+    }
+    return rec.mat_ptr->pdf(rec, wo, wi);
+  }
+
+  bool sample(const hit_record &rec, const vec3 &wo, double u1, double u2,
+              bsdf_sample &s) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::sample(rec, wo, u1, u2, s);
+      });
+    }
+    return rec.mat_ptr->sample(rec, wo, u1, u2, s);
+  }
+
+  bool is_surface(const hit_record &rec) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::is_surface();
+      });
+    }
+    return rec.mat_ptr->is_surface();
+  }
+
+  bool is_specular(const hit_record &rec) const {
+    if (const entry *e = find(rec)) {
+      return dispatch(*e, [&](const auto &mat) {
+        using T = std::decay_t<decltype(mat)>;
+        return mat.T::is_specular();
+      });
+    }
+    return rec.mat_ptr->is_specular();
+  }
+
+private:
+  std::vector<entry> entries;
+  std::unordered_map<const material *, int> slots;
+  // Material packed in each slot; keeps it alive, so addresses stay unique
+  std::vector<std::shared_ptr<material>> sources;
+
+  const entry *find(const hit_record &rec) const {
+    const int slot = rec.material_slot;
+    if (!enabled || slot < 0 || slot >= static_cast<int>(entries.size())) {
+      return nullptr;
+    }
+    // A primitive shared with another world may carry that world's slot
+    return sources[slot].get() == rec.mat_ptr.get() ? &entries[slot]
+                                                    : nullptr;
+  }
+
+  static_assert(std::variant_size_v<entry> == 9,
+                "update dispatch() when adding material types");
+
+  // Switch on the variant index; each case calls the lambda with the
+  // concrete type so member calls can be resolved statically
+  template <typename F>
+  static std::invoke_result_t<F, const lambertian &> dispatch(const entry &e,
+                                                              F &&f) {
+    switch (e.index()) {
+    case 0:
+      return f(*std::get_if<0>(&e));
+    case 1:
+      return f(*std::get_if<1>(&e));
+    case 2:
+      return f(*std::get_if<2>(&e));
+    case 3:
+      return f(*std::get_if<3>(&e));
+    case 4:
+      return f(*std::get_if<4>(&e));
+    case 5:
+      return f(*std::get_if<5>(&e));
+    case 6:
+      return f(*std::get_if<6>(&e));
+    case 7:
+      return f(*std::get_if<7>(&e));
+    default:
+      return f(*std::get_if<8>(&e));
+    }
+  }
+};
+
+#endif
@@ -6,22 +6,41 @@
 #include <glm/gtx/transform2.hpp>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "../3rdParty/ObjLoader/OBJ_Loader.h"
-
 #include "../util/logging.h"
-#include "bvh_node.h"
+#include "asset_cache.h"
 #include "dielectric.h"
 #include "emissive.h"
+#include "image_texture.h"
 #include "lambertian.h"
+#include "lambertian_textured.h"
 #include "material.h"
 #include "mesh.h"
 #include "metal.h"
+#include "obj_reader.h"
 #include "pbr_material.h"
 
 using namespace std;
 
+namespace {
+
+inline vec3 load_vec3(const float *p) { return vec3(p[0], p[1], p[2]); }
+
+// Texture map named in an MTL file, resolved next to the MTL. Missing
+// images leave the material untextured.
+std::shared_ptr<texture> LoadMtlTexture(const obj_material &mat,
+                                        const std::string &map) {
+  const std::string path = obj_reader::map_path(mat, map);
+  if (path.empty()) {
+    return nullptr;
+  }
+  return asset_cache::texture(path);
+}
+
+} // namespace
+
 mesh::mesh(string file, vec3 p, vec3 s, vec3 r, shared_ptr<material> mat) {
   position = p;
   scale = s;
@@ -30,27 +49,60 @@ mesh::mesh(string file, vec3 p, vec3 s, vec3 r, shared_ptr<material> mat) {
   fileName = file;
 }
 
+mesh::mesh(shared_ptr<const mesh_geometry> shared,
+           vector<shared_ptr<material>> slots) {
+  position = vec3(0, 0, 0);
+  scale = vec3(1, 1, 1);
+  rotation = vec3(0, 0, 0);
+  material_ptr = slots.empty() ? nullptr : slots[0];
+  baked = std::move(shared);
+  geometry = baked->view;
+  materialSlots = std::move(slots);
+  collectEmitters();
+}
+
+shared_ptr<mesh_geometry>
+mesh::buildGeometry(vector<float> positions, vector<float> texcoords,
+                    vector<uint32_t> indices,
+                    vector<uint32_t> triangleMaterials) {
+  auto out = make_shared<mesh_geometry>();
+  const size_t vertex_count = positions.size() / 3;
+  out->positions = std::move(positions);
+  out->texcoords = std::move(texcoords);
+  out->texcoords.resize(vertex_count * 2, 0.0f);
+  out->indices = std::move(indices);
+  out->triangleMaterials = std::move(triangleMaterials);
+  out->triangleMaterials.resize(out->indices.size() / 3, 0);
+  finishGeometry(*out);
+  return out;
+}
+
 int mesh::getTriangleCount() const {
-  return static_cast<int>(triangleList.size());
+  return static_cast<int>(geometry.triangle_count);
 }
 
 // Helper to convert OBJ material to Engine Material
-// Helper to convert OBJ material to Engine Material
-std::shared_ptr<material> ConvertMaterial(const objl::Material &mat) {
+std::shared_ptr<material> ConvertMaterial(const obj_material &mat) {
   // 1. Emissive (Light Source)
   // Strict check: if Ke is present, it's an emissive material.
   // We use the raw Ke values from the MTL file.
-  if (mat.Ke.X > 0.001f || mat.Ke.Y > 0.001f || mat.Ke.Z > 0.001f) {
-    return make_shared<emissive>(color(mat.Ke.X, mat.Ke.Y, mat.Ke.Z));
+  if (mat.Ke.x() > 0.001f || mat.Ke.y() > 0.001f || mat.Ke.z() > 0.001f) {
+    return make_shared<emissive>(mat.Ke);
   }
 
   // Handle illum models
   int illum = mat.illum;
 
+  // Diffuse map replaces Kd as the albedo
+  std::shared_ptr<texture> albedoMap = LoadMtlTexture(mat, mat.map_Kd);
+
   // illum 0: Color on and Ambient off
   // illum 1: Color on and Ambient on
   if (illum == 0 || illum == 1) {
-    return make_shared<lambertian>(color(mat.Kd.X, mat.Kd.Y, mat.Kd.Z));
+    if (albedoMap) {
+      return make_shared<lambertian_textured>(albedoMap);
+    }
+    return make_shared<lambertian>(mat.Kd);
   }
 
   // illum 2: Highlight on (Blinn-Phong) -> Diffuse + Specular
@@ -65,8 +117,10 @@ std::shared_ptr<material> ConvertMaterial(const objl::Material &mat) {
 
     // Check for PBR metallic map or param
     float metallic = mat.Pm;
-    return make_shared<pbr_material>(color(mat.Kd.X, mat.Kd.Y, mat.Kd.Z),
-                                     metallic, roughness);
+    if (albedoMap) {
+      return make_shared<pbr_material>(albedoMap, metallic, roughness);
+    }
+    return make_shared<pbr_material>(mat.Kd, metallic, roughness);
   }
 
   // illum 4: Transparency: Glass on, Reflection: Ray trace on
@@ -76,10 +130,11 @@ std::shared_ptr<material> ConvertMaterial(const objl::Material &mat) {
   if (illum == 4 || illum == 6 || illum == 7) {
     float ior = (mat.Ni > 0.0f) ? mat.Ni : 1.5f;
     // Strict: Use Tf as tint.
-    color tint(mat.Tf.X, mat.Tf.Y, mat.Tf.Z);
+    color tint(mat.Tf.x(), mat.Tf.y(), mat.Tf.z());
     // If Tf is zero (invalid for glass usually), default to clear white to
     // avoid invisible object or black hole
-    if (mat.Tf.X <= 0.001f && mat.Tf.Y <= 0.001f && mat.Tf.Z <= 0.001f) {
+    if (mat.Tf.x() <= 0.001f && mat.Tf.y() <= 0.001f &&
+        mat.Tf.z() <= 0.001f) {
       tint = color(1.0, 1.0, 1.0);
     }
     return make_shared<dielectric>(ior, tint);
@@ -90,13 +145,12 @@ std::shared_ptr<material> ConvertMaterial(const objl::Material &mat) {
     // Mirror is Metallic = 1.0, Roughness = 0.0.
     // Albedo comes from Ks (Specular Color) because ideal mirrors reflect
     // specularly. Kd is usually 0 for mirrors in OBJ.
-    return make_shared<pbr_material>(color(mat.Ks.X, mat.Ks.Y, mat.Ks.Z), 1.0f,
-                                     0.0f);
+    return make_shared<pbr_material>(mat.Ks, 1.0f, 0.0f);
   }
 
   // Default fallback / illum 8, 9, 10
   // PBR with properties read from file
-  color albedo(mat.Kd.X, mat.Kd.Y, mat.Kd.Z);
+  color albedo(mat.Kd.x(), mat.Kd.y(), mat.Kd.z());
 
   float roughness = mat.Pr;
   float metallic = mat.Pm;
@@ -109,26 +163,94 @@ std::shared_ptr<material> ConvertMaterial(const objl::Material &mat) {
     }
   }
 
+  if (albedoMap) {
+    return make_shared<pbr_material>(albedoMap, metallic, roughness);
+  }
   return make_shared<pbr_material>(albedo, metallic, roughness);
 }
 
-bool mesh::load(string fileName) {
-  objl::Loader loader;
-
-  // Try to load the file
-  bool success = loader.LoadFile(fileName);
+uint64_t mesh::cacheOptions() const {
+  // Anything that changes the baked data must be part of the key
+  const double options[] = {position.x(), position.y(), position.z(),
+                            scale.x(),    scale.y(),    scale.z(),
+                            rotation.x(), rotation.y(), rotation.z(),
+                            4.0 /* BVH leaf size */};
+  return mesh_cache::hash_bytes(options, sizeof(options), mesh_cache::version);
+}
 
-  if (!success) {
-    std::cerr << "OBJLoader: Failed to load " << fileName << std::endl;
+bool mesh::load(string fileName, bool useCache) {
+  // Elements with the same file and transform share the baked geometry
+  auto shared = asset_cache::geometry(
+      fileName, cacheOptions(), [&] { return bake(fileName, useCache); });
+  if (!shared) {
     return false;
   }
 
-  /*
-  if (!g_quiet.load() && !g_suppress_mesh_messages.load()) {
-     std::cout << "OBJLoader: Loaded " << loader.LoadedMeshes.size() << "
-  sub-meshes from " << fileName << std::endl;
+  baked = std::move(shared);
+  geometry = baked->view;
+  resolveMaterials();
+  return true;
+}
+
+std::shared_ptr<const mesh_geometry> mesh::bake(const std::string &fileName,
+                                                bool useCache) const {
+  auto out = std::make_shared<mesh_geometry>();
+  const std::string cachePath =
+      useCache ? mesh_cache::path_for(fileName, cacheOptions()) : "";
+
+  if (useCache) {
+    out->cache = mesh_cache::open(cachePath, cacheOptions());
+    if (out->cache) {
+      out->view = out->cache->data();
+      for (const auto &slot : out->view.material_slots) {
+        if (!slot.library.empty() &&
+            std::find(out->mtlFiles.begin(), out->mtlFiles.end(),
+                      slot.library) == out->mtlFiles.end())
+          out->mtlFiles.push_back(slot.library);
+      }
+      if (!g_quiet.load() && !g_suppress_mesh_messages.load())
+        cerr << "Loaded " << out->view.triangle_count << " triangles from "
+             << cachePath << endl;
+      return out;
+    }
+  }
+
+  if (!bakeObj(fileName, *out)) {
+    return nullptr;
   }
-  */
+
+  if (useCache) {
+    std::vector<mesh_cache_source> sources(1);
+    bool described = mesh_cache::describe(fileName, sources[0]);
+    for (const auto &mtl : out->mtlFiles) {
+      sources.emplace_back();
+      described = described && mesh_cache::describe(mtl, sources.back());
+    }
+    if (described &&
+        mesh_cache::write(cachePath, cacheOptions(), sources, out->view)) {
+      if (g_verbose.load())
+        cerr << "Wrote mesh cache " << cachePath << endl;
+    } else if (g_verbose.load()) {
+      cerr << "Could not write mesh cache " << cachePath << endl;
+    }
+  }
+
+  return out;
+}
+
+bool mesh::bakeObj(const std::string &fileName, mesh_geometry &out) const {
+  // Parsed once per file, even when several elements use different
+  // transforms
+  std::string error;
+  std::shared_ptr<const obj_mesh_data> parsed =
+      asset_cache::obj(fileName, error);
+  if (!parsed) {
+    std::cerr << "OBJLoader: Failed to load " << fileName << " (" << error
+              << ")" << std::endl;
+    return false;
+  }
+  const obj_mesh_data &obj = *parsed;
+  out.mtlFiles = obj.material_libraries;
 
   // Pre-calculate Transform Matrix
   // Note: GLM matrix multiplication is Column-Major, so T * R * S * v
@@ -144,123 +266,323 @@ bool mesh::load(string fileName) {
                                   glm::vec3(scale.x(), scale.y(), scale.z()));
   glm::mat4 Model = T * RX * RY * RZ * S;
 
-  int total_triangles = 0;
-
-  // OBJLoader splits meshes by material group automatically
-  for (const auto &loadedMesh : loader.LoadedMeshes) {
-
-    // Determine Material
-    std::shared_ptr<material> mat_for_mesh;
-
-    // If the mesh has a valid material name (not "none"), use it
-    if (loadedMesh.MeshMaterial.name != "none" &&
-        !loadedMesh.MeshMaterial.name.empty()) {
-      mat_for_mesh = ConvertMaterial(loadedMesh.MeshMaterial);
-    } else {
-      // Fallback to the material assigned in XML/Constructor
-      mat_for_mesh = this->material_ptr;
+  // Transform every unique vertex once; triangles index into this buffer
+  const size_t vertex_count = obj.vertex_count();
+  out.positions.resize(vertex_count * 3);
+  for (size_t i = 0; i < vertex_count; i++) {
+    const float *p = &obj.positions[i * 3];
+    glm::vec4 w = Model * glm::vec4(p[0], p[1], p[2], 1.0f);
+    out.positions[i * 3] = w.x;
+    out.positions[i * 3 + 1] = w.y;
+    out.positions[i * 3 + 2] = w.z;
+  }
+  out.texcoords = obj.texcoords;
+
+  // Material slot 0 is the material assigned in XML/Constructor; every
+  // named MTL material gets its own slot
+  std::vector<obj_material> slots(1);
+  std::unordered_map<std::string, uint32_t> slot_of;
+  auto slot_for = [&](const std::string &name) -> uint32_t {
+    if (name.empty() || name == "none") {
+      return 0;
     }
-
-    // Iterate over Indices to form triangles
-    // Indices are 0-based relative to the loadedMesh.Vertices array
-    for (size_t i = 0; i < loadedMesh.Indices.size(); i += 3) {
-
-      glm::vec4 v[3];
-      vec3 uv[3];
-
-      for (int j = 0; j < 3; j++) {
-        unsigned int idx = loadedMesh.Indices[i + j];
-        const auto &vert = loadedMesh.Vertices[idx];
-
-        // Transform Position
-        glm::vec4 worldPos = Model * glm::vec4(vert.Position.X, vert.Position.Y,
-                                               vert.Position.Z, 1.0f);
-        v[j] = worldPos;
-
-        // UV (Invert Y if necessary, OBJ often has V going up)
-        uv[j] = vec3(vert.TextureCoordinate.X, vert.TextureCoordinate.Y, 0.0f);
+    auto it = slot_of.find(name);
+    if (it != slot_of.end()) {
+      return it->second;
+    }
+    uint32_t slot = 0;
+    for (const auto &m : obj.materials) {
+      if (m.name == name) {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.push_back(m);
+        break;
       }
-
-      // Create Triangle
-      triangleList.push_back(triangle(
-          vec3(v[0].x, v[0].y, v[0].z), vec3(v[1].x, v[1].y, v[1].z),
-          vec3(v[2].x, v[2].y, v[2].z), uv[0], uv[1], uv[2], mat_for_mesh));
-      total_triangles++;
     }
+    slot_of.emplace(name, slot);
+    return slot;
+  };
+
+  std::vector<uint32_t> source_materials(obj.triangle_count(), 0);
+  for (const auto &group : obj.groups) {
+    const uint32_t slot = slot_for(group.material);
+    std::fill_n(source_materials.begin() + group.first_triangle,
+                group.triangle_count, slot);
   }
 
+  out.indices = obj.indices;
+  out.triangleMaterials = std::move(source_materials);
+  out.view.material_slots = std::move(slots);
+
   if (!g_quiet.load() && !g_suppress_mesh_messages.load())
-    cerr << "Loaded " << total_triangles << " triangles from " << fileName
+    cerr << "Loaded " << obj.triangle_count() << " triangles from " << fileName
          << endl;
 
-  // Build BVH
-  buildMeshBVH();
-
+  finishGeometry(out);
   return true;
 }
 
-void mesh::buildMeshBVH() {
-  if (triangleList.empty()) {
-    return;
+void mesh::finishGeometry(mesh_geometry &out) {
+  // Degenerate triangles are dropped here instead of being tested in hit()
+  size_t kept = 0;
+  const size_t triangle_count = out.indices.size() / 3;
+  for (size_t t = 0; t < triangle_count; t++) {
+    const uint32_t *tri = &out.indices[t * 3];
+    vec3 p0 = load_vec3(&out.positions[tri[0] * 3]);
+    vec3 p1 = load_vec3(&out.positions[tri[1] * 3]);
+    vec3 p2 = load_vec3(&out.positions[tri[2] * 3]);
+    if (cross(p1 - p0, p2 - p0).length() < 1e-8) {
+      continue;
+    }
+    std::copy_n(tri, 3, &out.indices[kept * 3]);
+    out.triangleMaterials[kept] = out.triangleMaterials[t];
+    kept++;
   }
+  out.indices.resize(kept * 3);
+  out.triangleMaterials.resize(kept);
 
-  std::vector<std::shared_ptr<hittable>> tri_ptrs;
-  tri_ptrs.reserve(triangleList.size());
+  buildMeshBVH(out);
+}
 
-  for (const auto &tri : triangleList) {
-    tri_ptrs.push_back(std::make_shared<triangle>(tri));
+void mesh::buildMeshBVH(mesh_geometry &out) {
+  const size_t triangle_count = out.indices.size() / 3;
+  const std::vector<float> &positions = out.positions;
+  const std::vector<uint32_t> &indices = out.indices;
+
+  // Triangle bounds, padded like triangle::bounding_box()
+  const float padding = 0.0001f;
+  std::vector<float> bounds(triangle_count * 6);
+  for (size_t t = 0; t < triangle_count; t++) {
+    float *b = &bounds[t * 6];
+    for (int a = 0; a < 3; a++) {
+      const float c0 = positions[indices[t * 3] * 3 + a];
+      const float c1 = positions[indices[t * 3 + 1] * 3 + a];
+      const float c2 = positions[indices[t * 3 + 2] * 3 + a];
+      b[a] = std::min({c0, c1, c2}) - padding;
+      b[a + 3] = std::max({c0, c1, c2}) + padding;
+    }
   }
 
-  mesh_bvh = std::make_shared<bvh_node>(tri_ptrs);
+  std::vector<uint32_t> order;
+  flat_bvh_builder::build(bounds, order, out.nodes);
 
-  if (!g_quiet.load() && !g_suppress_mesh_messages.load()) {
-    cerr << "Built mesh BVH: " << mesh_bvh->getNodeCount() << " nodes, "
-         << mesh_bvh->getLeafCount() << " leaves, max depth "
-         << mesh_bvh->getMaxDepth() << endl;
+  // Store triangles in leaf order so each leaf is a contiguous range
+  std::vector<uint32_t> sorted_indices(out.indices.size());
+  std::vector<uint32_t> sorted_materials(out.triangleMaterials.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    std::copy_n(&out.indices[order[i] * 3], 3, &sorted_indices[i * 3]);
+    sorted_materials[i] = out.triangleMaterials[order[i]];
+  }
+  out.indices = std::move(sorted_indices);
+  out.triangleMaterials = std::move(sorted_materials);
+
+  mesh_cache_data &view = out.view;
+  view.positions = out.positions.data();
+  view.texcoords = out.texcoords.data();
+  view.indices = out.indices.data();
+  view.triangle_materials = out.triangleMaterials.data();
+  view.nodes = out.nodes.data();
+  view.vertex_count = static_cast<uint32_t>(out.positions.size() / 3);
+  view.triangle_count = static_cast<uint32_t>(triangle_count);
+  view.node_count = static_cast<uint32_t>(out.nodes.size());
+
+  if (!g_quiet.load() && !g_suppress_mesh_messages.load() &&
+      !out.nodes.empty()) {
+    size_t leaves = 0;
+    for (const auto &node : out.nodes) {
+      leaves += node.is_leaf() ? 1 : 0;
+    }
+    cerr << "Built mesh BVH: " << out.nodes.size() << " nodes, " << leaves
+         << " leaves" << endl;
   }
 }
 
-bool mesh::hit(const ray &r, double t_min, double t_max,
-               hit_record &rec) const {
-  if (mesh_bvh) {
-    return mesh_bvh->hit(r, t_min, t_max, rec);
+void mesh::resolveMaterials() {
+  materialSlots.clear();
+  for (const auto &slot : geometry.material_slots) {
+    // MTL materials are converted once per (file, name) and shared
+    std::shared_ptr<material> mat =
+        slot.name.empty() ? this->material_ptr
+                          : asset_cache::mtl_material(slot, ConvertMaterial);
+    materialSlots.push_back(mat);
   }
+  collectEmitters();
+}
 
-  hit_record temp_rec;
-  bool hit_anything = false;
-  auto closest_so_far = t_max;
+void mesh::collectEmitters() {
+  slotEmits.clear();
+  for (const auto &mat : materialSlots) {
+    color e = mat ? mat->emitted(0.5, 0.5, point3(0, 0, 0)) : color(0, 0, 0);
+    slotEmits.push_back(e.x() > 0.0 || e.y() > 0.0 || e.z() > 0.0);
+  }
 
-  for (size_t i = 0; i < triangleList.size(); i++) {
-    if (triangleList[i].hit(r, t_min, closest_so_far, temp_rec)) {
-      hit_anything = true;
-      closest_so_far = temp_rec.t;
-      rec = temp_rec;
+  // Emissive triangles become real primitives so they can act as lights
+  emissiveIndices.clear();
+  emissiveTriangles.clear();
+  for (uint32_t t = 0; t < geometry.triangle_count; t++) {
+    const uint32_t slot = geometry.triangle_materials[t];
+    if (!slotEmits[slot]) {
+      continue;
     }
+    const uint32_t *tri = &geometry.indices[t * 3];
+    vec3 p[3], uv[3];
+    for (int j = 0; j < 3; j++) {
+      p[j] = load_vec3(&geometry.positions[tri[j] * 3]);
+      uv[j] = vec3(geometry.texcoords[tri[j] * 2],
+                   geometry.texcoords[tri[j] * 2 + 1], 0.0);
+    }
+    emissiveIndices.push_back(t);
+    emissiveTriangles.push_back(make_shared<triangle>(
+        p[0], p[1], p[2], uv[0], uv[1], uv[2], materialSlots[slot]));
   }
-  return hit_anything;
 }
 
-bool mesh::bounding_box(aabb &output_box) const {
-  if (triangleList.empty()) {
+bool mesh::hitTriangle(uint32_t tri, const ray &r, double t_min, double t_max,
+                       double &t, double &u, double &v) const {
+  // Möller–Trumbore, same arithmetic as triangle::hit
+  const uint32_t *idx = &geometry.indices[tri * 3];
+  vec3 v0 = load_vec3(&geometry.positions[idx[0] * 3]);
+  vec3 edge1 = load_vec3(&geometry.positions[idx[1] * 3]) - v0;
+  vec3 edge2 = load_vec3(&geometry.positions[idx[2] * 3]) - v0;
+  vec3 h = cross(r.dir, edge2);
+  double a = dot(edge1, h);
+
+  if (fabs(a) < EPSILON)
+    return false; // Ray parallel to triangle
+
+  double f = 1.0 / a;
+  vec3 s = r.orig - v0;
+  u = f * dot(s, h);
+  if (u < 0.0 || u > 1.0)
+    return false;
+
+  vec3 q = cross(s, edge1);
+  v = f * dot(r.dir, q);
+  if (v < 0.0 || u + v > 1.0)
+    return false;
+
+  t = f * dot(edge2, q);
+  return t >= t_min && t <= t_max;
+}
+
+bool mesh::hit(const ray &r, double t_min, double t_max,
+               hit_record &rec) const {
+  if (geometry.node_count == 0) {
     return false;
   }
 
-  if (box_computed) {
-    output_box = cached_box;
+  const double origin[3] = {r.orig.x(), r.orig.y(), r.orig.z()};
+  const double inv_dir[3] = {1.0 / r.dir.x(), 1.0 / r.dir.y(),
+                             1.0 / r.dir.z()};
+
+  // Slab test against a node's bounds, clipped to the current closest hit
+  auto hit_box = [&](const flat_bvh_node &node, double t_far) {
+    double t0 = t_min;
+    double t1 = t_far;
+    for (int a = 0; a < 3; a++) {
+      double near_t = (node.bounds_min[a] - origin[a]) * inv_dir[a];
+      double far_t = (node.bounds_max[a] - origin[a]) * inv_dir[a];
+      if (inv_dir[a] < 0.0) {
+        std::swap(near_t, far_t);
+      }
+      t0 = near_t > t0 ? near_t : t0;
+      t1 = far_t < t1 ? far_t : t1;
+      if (t1 <= t0) {
+        return false;
+      }
+    }
     return true;
+  };
+
+  // Cache and builder both bound the depth, and each level pushes at most
+  // one node
+  uint32_t stack[flat_bvh_builder::max_depth];
+  int stack_size = 0;
+  uint32_t current = 0;
+  double closest = t_max;
+  int64_t hit_tri = -1;
+  double hit_u = 0.0, hit_v = 0.0;
+
+  while (true) {
+    const flat_bvh_node &node = geometry.nodes[current];
+    if (hit_box(node, closest)) {
+      if (node.is_leaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+          double t, u, v;
+          if (hitTriangle(i, r, t_min, closest, t, u, v)) {
+            closest = t;
+            hit_tri = i;
+            hit_u = u;
+            hit_v = v;
+          }
+        }
+      } else {
+        // Visit the child on the near side of the split first
+        if (inv_dir[node.axis] < 0.0) {
+          stack[stack_size++] = current + 1;
+          current = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if (stack_size == 0) {
+      break;
+    }
+    current = stack[--stack_size];
   }
 
-  bool first_box = true;
+  if (hit_tri < 0) {
+    return false;
+  }
 
-  for (const auto &tri : triangleList) {
-    aabb tri_box;
-    if (tri.bounding_box(tri_box)) {
-      cached_box = first_box ? tri_box : surrounding_box(cached_box, tri_box);
-      first_box = false;
-    }
+  const uint32_t tri = static_cast<uint32_t>(hit_tri);
+  const uint32_t *idx = &geometry.indices[tri * 3];
+  vec3 v0 = load_vec3(&geometry.positions[idx[0] * 3]);
+  vec3 edge1 = load_vec3(&geometry.positions[idx[1] * 3]) - v0;
+  vec3 edge2 = load_vec3(&geometry.positions[idx[2] * 3]) - v0;
+
+  const vec3 n = cross(edge1, edge2);
+  rec.t = closest;
+  rec.p = r.orig + closest * r.dir;
+  rec.set_face_normal(r, unit_vector(n));
+
+  const uint32_t slot = geometry.triangle_materials[tri];
+  rec.mat_ptr = materialSlots[slot];
+  rec.material_slot = slot < tableSlots.size() ? tableSlots[slot] : -1;
+  rec.object = this;
+  if (slotEmits[slot]) {
+    auto it = std::lower_bound(emissiveIndices.begin(), emissiveIndices.end(),
+                               tri);
+    rec.object = emissiveTriangles[it - emissiveIndices.begin()].get();
+  }
+
+  // UV = w*uv0 + u*uv1 + v*uv2
+  const double w = 1.0 - hit_u - hit_v;
+  const float *uv0 = &geometry.texcoords[idx[0] * 2];
+  const float *uv1 = &geometry.texcoords[idx[1] * 2];
+  const float *uv2 = &geometry.texcoords[idx[2] * 2];
+  rec.u = w * uv0[0] + hit_u * uv1[0] + hit_v * uv2[0];
+  rec.v = w * uv0[1] + hit_u * uv1[1] + hit_v * uv2[1];
+
+  // UV units per world unit, for texture filtering
+  const double uvArea = std::fabs((uv1[0] - uv0[0]) * (uv2[1] - uv0[1]) -
+                                  (uv2[0] - uv0[0]) * (uv1[1] - uv0[1]));
+  rec.uv_density = std::sqrt(uvArea / n.length());
+
+  return true;
+}
+
+bool mesh::bounding_box(aabb &output_box) const {
+  if (geometry.node_count == 0) {
+    return false;
   }
 
-  box_computed = true;
-  output_box = cached_box;
+  const flat_bvh_node &root = geometry.nodes[0];
+  output_box = aabb(point3(root.bounds_min[0], root.bounds_min[1],
+                           root.bounds_min[2]),
+                    point3(root.bounds_max[0], root.bounds_max[1],
+                           root.bounds_max[2]));
   return true;
 }
@@ -2,20 +2,71 @@
 #define MESH_H
 
 #include "aabb.h"
+#include "flat_bvh.h"
 #include "hittable.h"
+#include "mesh_cache.h"
 #include "triangle.h"
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 
-// Forward declaration to avoid circular include
-class bvh_node;
+/**
+ * @brief Baked mesh data: flat indexed buffers (world-space positions, UVs,
+ *        indices and a per-triangle material slot) and a flat BVH
+ *
+ * The view either points into the owned buffers or straight into a
+ * memory-mapped .rtmesh cache. It is immutable once built, so meshes with
+ * the same file and transform share one instance through asset_cache.
+ */
+struct mesh_geometry {
+  mesh_cache_data view;
+  std::unique_ptr<mesh_cache> cache;
 
+  std::vector<float> positions;
+  std::vector<float> texcoords;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> triangleMaterials;
+  std::vector<flat_bvh_node> nodes;
+  std::vector<std::string> mtlFiles; // Cache dependencies besides the OBJ
+};
+
+/**
+ * @brief Triangle mesh loaded from an OBJ file
+ *
+ * A cached mesh needs no parsing and no BVH build; repeated files in a
+ * scene are parsed once and materials from the same MTL are shared.
+ */
 class mesh : public hittable {
 public:
   mesh(std::string file, vec3 p, vec3 s, vec3 r, std::shared_ptr<material> mat);
-  bool load(std::string fileName);
+
+  /**
+   * @brief Mesh over already baked geometry with one material per slot
+   *        (used by importers that produce indexed buffers, e.g. glTF)
+   */
+  mesh(std::shared_ptr<const mesh_geometry> geometry,
+       std::vector<std::shared_ptr<material>> slots);
+
+  /**
+   * @brief Bake indexed buffers: drops degenerate triangles and builds the
+   *        flat BVH
+   * @param positions 3 floats per vertex
+   * @param texcoords 2 floats per vertex (may be empty)
+   * @param triangleMaterials Material slot per triangle
+   */
+  static std::shared_ptr<mesh_geometry>
+  buildGeometry(std::vector<float> positions, std::vector<float> texcoords,
+                std::vector<uint32_t> indices,
+                std::vector<uint32_t> triangleMaterials);
+
+  /**
+   * @brief Load the mesh from an OBJ file
+   * @param useCache Use (or create) a .rtmesh cache next to the file
+   */
+  bool load(std::string fileName, bool useCache = false);
+
   virtual bool hit(const ray &r, double t_min, double t_max,
                    hit_record &rec) const override;
   virtual bool bounding_box(aabb &output_box) const override;
@@ -23,29 +74,55 @@ public:
   // Return the number of triangles loaded for diagnostics
   int getTriangleCount() const;
 
-  // Get access to triangles for BVH construction
-  const std::vector<triangle> &getTriangles() const { return triangleList; }
+  // Emissive triangles as standalone primitives for light sampling (these
+  // are the objects reported in hit_record::object when they are hit)
+  const std::vector<std::shared_ptr<triangle>> &getEmissiveTriangles() const {
+    return emissiveTriangles;
+  }
+
+  // Materials referenced by the triangles (slot 0 is the XML material)
+  const std::vector<std::shared_ptr<material>> &getMaterials() const {
+    return materialSlots;
+  }
 
-  // Build BVH for this mesh - call after load()
-  void buildMeshBVH();
+  // Slots of getMaterials() in the world's material table (-1: not packed),
+  // assigned by world::buildMaterialTable()
+  std::vector<int> &getMaterialTableSlots() { return tableSlots; }
 
   // Check if mesh BVH is built
-  bool hasMeshBVH() const { return mesh_bvh != nullptr; }
+  bool hasMeshBVH() const { return geometry.node_count > 0; }
+
+  // True when the geometry is used in place from a .rtmesh cache
+  bool loadedFromCache() const { return baked && baked->cache != nullptr; }
 
 private:
-  std::vector<triangle> triangleList;
+  std::shared_ptr<const mesh_geometry> bake(const std::string &fileName,
+                                            bool useCache) const;
+  bool bakeObj(const std::string &fileName, mesh_geometry &out) const;
+  static void finishGeometry(mesh_geometry &out);
+  static void buildMeshBVH(mesh_geometry &out);
+  void resolveMaterials();
+  void collectEmitters();
+  uint64_t cacheOptions() const;
+
+  bool hitTriangle(uint32_t tri, const ray &r, double t_min, double t_max,
+                   double &t, double &u, double &v) const;
+
+  // Possibly shared with other meshes; geometry is a copy of its view
+  std::shared_ptr<const mesh_geometry> baked;
+  mesh_cache_data geometry;
+
+  std::vector<std::shared_ptr<material>> materialSlots;
+  std::vector<int> tableSlots;
+  std::vector<uint8_t> slotEmits;
+  std::vector<uint32_t> emissiveIndices; // Sorted triangle indices
+  std::vector<std::shared_ptr<triangle>> emissiveTriangles;
+
   std::shared_ptr<material> material_ptr;
 
   vec3 position, scale, rotation;
   float angle;
   std::string fileName;
-
-  // Per-mesh BVH for accelerated intersection
-  std::shared_ptr<bvh_node> mesh_bvh;
-
-  // Cached bounding box
-  mutable aabb cached_box;
-  mutable bool box_computed = false;
 };
 
 #endif
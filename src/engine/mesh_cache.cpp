@@ -0,0 +1,367 @@
+#include "mesh_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace {
+
+constexpr char kMagic[8] = {'R', 'T', 'M', 'E', 'S', 'H', 0, 0};
+constexpr uint32_t kByteOrder = 0x01020304;
+constexpr size_t kAlignment = 16;
+
+enum section : uint32_t {
+  SECTION_SOURCES,
+  SECTION_MATERIALS,
+  SECTION_POSITIONS,
+  SECTION_TEXCOORDS,
+  SECTION_INDICES,
+  SECTION_TRIANGLE_MATERIALS,
+  SECTION_NODES,
+  SECTION_COUNT
+};
+
+struct rtmesh_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t options;
+  uint64_t file_size;
+  uint32_t vertex_count;
+  uint32_t triangle_count;
+  uint32_t node_count;
+  uint32_t material_count;
+  uint32_t source_count;
+  uint32_t reserved;
+  uint64_t offsets[SECTION_COUNT];
+};
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t fmix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+// Little helpers for the variable-length sections
+class blob_writer {
+public:
+  explicit blob_writer(std::ofstream &out) : out(out) {}
+
+  template <typename T> void put(const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void put_string(const std::string &s) {
+    put(static_cast<uint32_t>(s.size()));
+    out.write(s.data(), static_cast<std::streamsize>(s.size()));
+  }
+
+  void put_color(const color &c) {
+    for (int i = 0; i < 3; i++)
+      put(static_cast<float>(c[i]));
+  }
+
+private:
+  std::ofstream &out;
+};
+
+class blob_reader {
+public:
+  blob_reader(const char *begin, const char *end) : p(begin), end(end) {}
+
+  template <typename T> bool get(T &value) {
+    if (static_cast<size_t>(end - p) < sizeof(T))
+      return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+  }
+
+  bool get_string(std::string &s) {
+    uint32_t n = 0;
+    if (!get(n) || static_cast<size_t>(end - p) < n)
+      return false;
+    s.assign(p, n);
+    p += n;
+    return true;
+  }
+
+  bool get_color(color &c) {
+    float v[3];
+    if (!get(v[0]) || !get(v[1]) || !get(v[2]))
+      return false;
+    c = color(v[0], v[1], v[2]);
+    return true;
+  }
+
+private:
+  const char *p;
+  const char *end;
+};
+
+void pad_to_alignment(std::ofstream &out) {
+  static const char zeros[kAlignment] = {};
+  const auto pos = static_cast<size_t>(out.tellp());
+  if (pos % kAlignment)
+    out.write(zeros, kAlignment - pos % kAlignment);
+}
+
+bool source_matches(const mesh_cache_source &recorded) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  const uint64_t size = fs::file_size(recorded.path, ec);
+  if (ec || size != recorded.size)
+    return false;
+  const auto mtime = fs::last_write_time(recorded.path, ec);
+  if (!ec && mtime.time_since_epoch().count() == recorded.mtime)
+    return true;
+
+  // Touched but possibly unchanged: fall back to the content hash
+  mesh_cache_source current;
+  return mesh_cache::describe(recorded.path, current) &&
+         current.hash == recorded.hash;
+}
+
+} // namespace
+
+std::string mesh_cache::path_for(const std::string &source, uint64_t options) {
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".%08x.rtmesh",
+                static_cast<unsigned>(options ^ (options >> 32)));
+  return source + suffix;
+}
+
+uint64_t mesh_cache::hash_bytes(const void *data, size_t size, uint64_t seed) {
+  const char *p = static_cast<const char *>(data);
+  uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ull);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t w;
+    std::memcpy(&w, p + i, 8);
+    h ^= rotl(w * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+    h = rotl(h, 27) * 5 + 0x52dce729;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, p + i, size - i);
+  h ^= rotl(tail * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+  return fmix(h);
+}
+
+bool mesh_cache::describe(const std::string &path, mesh_cache_source &out) {
+  namespace fs = std::filesystem;
+  mapped_file file(path);
+  if (!file.valid())
+    return false;
+  file.advise_sequential();
+
+  std::error_code ec;
+  const auto mtime = fs::last_write_time(path, ec);
+  out.path = path;
+  out.size = file.size();
+  out.mtime = ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+  out.hash = hash_bytes(file.data(), file.size());
+  return true;
+}
+
+bool mesh_cache::write(const std::string &path, uint64_t options,
+                       const std::vector<mesh_cache_source> &sources,
+                       const mesh_cache_data &data) {
+  namespace fs = std::filesystem;
+
+  // Write to a unique temporary name so concurrent loaders never observe
+  // a partial cache
+  const std::string tmp =
+      path + ".tmp" +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) &
+                     0xffffff);
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+
+  rtmesh_header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = version;
+  header.byte_order = kByteOrder;
+  header.options = options;
+  header.vertex_count = data.vertex_count;
+  header.triangle_count = data.triangle_count;
+  header.node_count = data.node_count;
+  header.material_count = static_cast<uint32_t>(data.material_slots.size());
+  header.source_count = static_cast<uint32_t>(sources.size());
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  blob_writer blob(out);
+  auto begin_section = [&](section s) {
+    pad_to_alignment(out);
+    header.offsets[s] = static_cast<uint64_t>(out.tellp());
+  };
+  auto write_array = [&](section s, const void *ptr, size_t bytes) {
+    begin_section(s);
+    out.write(static_cast<const char *>(ptr),
+              static_cast<std::streamsize>(bytes));
+  };
+
+  begin_section(SECTION_SOURCES);
+  for (const auto &src : sources) {
+    blob.put_string(src.path);
+    blob.put(src.size);
+    blob.put(src.mtime);
+    blob.put(src.hash);
+  }
+
+  begin_section(SECTION_MATERIALS);
+  for (const auto &m : data.material_slots) {
+    blob.put_string(m.name);
+    blob.put_string(m.library);
+    blob.put_color(m.Ka);
+    blob.put_color(m.Kd);
+    blob.put_color(m.Ks);
+    blob.put_color(m.Ke);
+    blob.put_color(m.Tf);
+    for (float f : {m.Ns, m.Ni, m.d, m.Tr, m.Pr, m.Pm})
+      blob.put(f);
+    blob.put(static_cast<int32_t>(m.illum));
+    blob.put_string(m.map_Kd);
+    blob.put_string(m.map_Ks);
+    blob.put_string(m.map_bump);
+    blob.put_string(m.map_d);
+  }
+
+  write_array(SECTION_POSITIONS, data.positions,
+              size_t(data.vertex_count) * 3 * sizeof(float));
+  write_array(SECTION_TEXCOORDS, data.texcoords,
+              size_t(data.vertex_count) * 2 * sizeof(float));
+  write_array(SECTION_INDICES, data.indices,
+              size_t(data.triangle_count) * 3 * sizeof(uint32_t));
+  write_array(SECTION_TRIANGLE_MATERIALS, data.triangle_materials,
+              size_t(data.triangle_count) * sizeof(uint32_t));
+  write_array(SECTION_NODES, data.nodes,
+              size_t(data.node_count) * sizeof(flat_bvh_node));
+
+  header.file_size = static_cast<uint64_t>(out.tellp());
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+
+  std::error_code ec;
+  if (!out) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<mesh_cache> mesh_cache::open(const std::string &path,
+                                             uint64_t options) {
+  auto file = std::make_unique<mapped_file>(path);
+  if (!file->valid() || file->size() < sizeof(rtmesh_header))
+    return nullptr;
+
+  rtmesh_header header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != version || header.byte_order != kByteOrder ||
+      header.options != options || header.file_size != file->size()) {
+    return nullptr;
+  }
+
+  // Every fixed-size array must lie inside the file and be aligned
+  const char *base = file->data();
+  const uint64_t size = file->size();
+  auto array_at = [&](section s, uint64_t bytes) -> const char * {
+    const uint64_t offset = header.offsets[s];
+    if (offset % kAlignment || offset > size || bytes > size - offset)
+      return nullptr;
+    return base + offset;
+  };
+
+  const uint64_t nv = header.vertex_count;
+  const uint64_t nt = header.triangle_count;
+  const uint64_t nn = header.node_count;
+  const char *positions = array_at(SECTION_POSITIONS, nv * 3 * sizeof(float));
+  const char *texcoords = array_at(SECTION_TEXCOORDS, nv * 2 * sizeof(float));
+  const char *indices = array_at(SECTION_INDICES, nt * 3 * sizeof(uint32_t));
+  const char *tri_mats =
+      array_at(SECTION_TRIANGLE_MATERIALS, nt * sizeof(uint32_t));
+  const char *nodes = array_at(SECTION_NODES, nn * sizeof(flat_bvh_node));
+  if (!positions || !texcoords || !indices || !tri_mats || !nodes ||
+      header.offsets[SECTION_SOURCES] > size ||
+      header.offsets[SECTION_MATERIALS] > size) {
+    return nullptr;
+  }
+
+  blob_reader sources(base + header.offsets[SECTION_SOURCES], base + size);
+  for (uint32_t i = 0; i < header.source_count; i++) {
+    mesh_cache_source src;
+    if (!sources.get_string(src.path) || !sources.get(src.size) ||
+        !sources.get(src.mtime) || !sources.get(src.hash) ||
+        !source_matches(src)) {
+      return nullptr;
+    }
+  }
+
+  auto cache = std::unique_ptr<mesh_cache>(new mesh_cache());
+  mesh_cache_data &d = cache->contents;
+
+  blob_reader materials(base + header.offsets[SECTION_MATERIALS], base + size);
+  d.material_slots.resize(header.material_count);
+  for (auto &m : d.material_slots) {
+    int32_t illum = 0;
+    bool ok = materials.get_string(m.name) &&
+              materials.get_string(m.library) && materials.get_color(m.Ka) &&
+              materials.get_color(m.Kd) && materials.get_color(m.Ks) &&
+              materials.get_color(m.Ke) && materials.get_color(m.Tf);
+    for (float *f : {&m.Ns, &m.Ni, &m.d, &m.Tr, &m.Pr, &m.Pm})
+      ok = ok && materials.get(*f);
+    ok = ok && materials.get(illum) && materials.get_string(m.map_Kd) &&
+         materials.get_string(m.map_Ks) && materials.get_string(m.map_bump) &&
+         materials.get_string(m.map_d);
+    if (!ok)
+      return nullptr;
+    m.illum = illum;
+  }
+
+  d.positions = reinterpret_cast<const float *>(positions);
+  d.texcoords = reinterpret_cast<const float *>(texcoords);
+  d.indices = reinterpret_cast<const uint32_t *>(indices);
+  d.triangle_materials = reinterpret_cast<const uint32_t *>(tri_mats);
+  d.nodes = reinterpret_cast<const flat_bvh_node *>(nodes);
+  d.vertex_count = header.vertex_count;
+  d.triangle_count = header.triangle_count;
+  d.node_count = header.node_count;
+
+  // Reject out-of-range references so traversal never reads past the map
+  for (uint64_t i = 0; i < nt * 3; i++) {
+    if (d.indices[i] >= nv)
+      return nullptr;
+  }
+  for (uint64_t i = 0; i < nt; i++) {
+    if (d.triangle_materials[i] >= header.material_count)
+      return nullptr;
+  }
+  for (uint64_t i = 0; i < nn; i++) {
+    const flat_bvh_node &n = d.nodes[i];
+    if (n.is_leaf() ? uint64_t(n.offset) + n.count > nt
+                    : i + 1 >= nn || n.offset <= i + 1 || n.offset >= nn) {
+      return nullptr;
+    }
+  }
+  // Traversal uses a fixed-size stack
+  if (flat_bvh_builder::depth(d.nodes, nn) > flat_bvh_builder::max_depth)
+    return nullptr;
+
+  cache->file = std::move(file);
+  return cache;
+}
@@ -0,0 +1,87 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "../util/mapped_file.h"
+#include "flat_bvh.h"
+#include "obj_reader.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief File a cache was built from, used to detect stale caches
+ */
+struct mesh_cache_source {
+  std::string path;
+  uint64_t size = 0;
+  int64_t mtime = 0;
+  uint64_t hash = 0; // Content hash
+};
+
+/**
+ * @brief Geometry stored in a .rtmesh file
+ *
+ * Triangles are in BVH leaf order. Material slot 0 always stands for the
+ * material assigned in the scene XML; the remaining slots are MTL materials
+ * that are converted again on load.
+ */
+struct mesh_cache_data {
+  const float *positions = nullptr;  // 3 per vertex, world space
+  const float *texcoords = nullptr;  // 2 per vertex
+  const uint32_t *indices = nullptr; // 3 per triangle
+  const uint32_t *triangle_materials = nullptr; // Slot per triangle
+  const flat_bvh_node *nodes = nullptr;
+  uint32_t vertex_count = 0;
+  uint32_t triangle_count = 0;
+  uint32_t node_count = 0;
+  std::vector<obj_material> material_slots;
+};
+
+/**
+ * @brief Versioned binary mesh cache (.rtmesh)
+ *
+ * A cache holds the transformed vertex buffer, indices, material slots and
+ * a flat BVH, and is keyed by the content hash of its source files and a
+ * hash of the build options (transform, format version). All arrays are
+ * 16-byte aligned so an opened cache is used directly from the mapping.
+ */
+class mesh_cache {
+public:
+  static constexpr uint32_t version = 2;
+
+  /**
+   * @brief Cache file for a source and options hash
+   *        (e.g. dragon.obj -> dragon.obj.1a2b3c4d.rtmesh)
+   */
+  static std::string path_for(const std::string &source, uint64_t options);
+
+  static uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
+  /**
+   * @brief Stat and hash a source file
+   */
+  static bool describe(const std::string &path, mesh_cache_source &out);
+
+  /**
+   * @brief Write a cache atomically (temporary file + rename)
+   */
+  static bool write(const std::string &path, uint64_t options,
+                    const std::vector<mesh_cache_source> &sources,
+                    const mesh_cache_data &data);
+
+  /**
+   * @brief Map a cache and validate it against its sources
+   * @return nullptr when missing, stale or corrupt
+   */
+  static std::unique_ptr<mesh_cache> open(const std::string &path,
+                                          uint64_t options);
+
+  const mesh_cache_data &data() const { return contents; }
+
+private:
+  std::unique_ptr<mapped_file> file;
+  mesh_cache_data contents;
+};
+
+#endif
@@ -8,4 +8,37 @@ bool metal::scatter(const ray& r_in, const hit_record& rec, color& attenuation,
     scattered = ray(rec.p, reflected + fuzz*random_in_unit_sphere());
     attenuation = albedo;
     return (dot(scattered.direction(), rec.normal) > 0);
+}
+
+color metal::eval(const hit_record& rec, const vec3& wo, const vec3& wi) const {
+    if (is_specular())
+        return color(0, 0, 0);
+    return brdf().eval(rec.normal, wo, wi);
+}
+
+double metal::pdf(const hit_record& rec, const vec3& wo, const vec3& wi) const {
+    if (is_specular())
+        return 0.0;
+    return brdf().pdf(rec.normal, wo, wi);
+}
+
+bool metal::sample(
+    const hit_record& rec, const vec3& wo, double u1, double u2, bsdf_sample& s) const {
+    if (is_specular()) {
+        s.wi = reflect(-wo, rec.normal);
+        s.weight = albedo;
+        s.pdf = 0.0;
+        s.is_delta = true;
+        return dot(s.wi, rec.normal) > 0;
+    }
+
+    const microfacet::metallic_roughness model = brdf();
+    if (!model.sample(rec.normal, wo, u1, u2, s.wi))
+        return false;
+    s.pdf = model.pdf(rec.normal, wo, s.wi);
+    if (s.pdf <= 0.0)
+        return false;
+    s.weight = model.eval(rec.normal, wo, s.wi) / s.pdf;
+    s.is_delta = false;
+    return true;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define METAL_H
 
 #include "material.h"
+#include "microfacet.h"
 
 class metal : public material {
     public:
@@ -10,9 +11,24 @@ class metal : public material {
         virtual bool scatter(
             const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const override ;
 
+        // Fuzzy metal is treated as a GGX lobe whose width follows the
+        // fuzz radius, so it can be combined with light sampling. Only a
+        // perfect mirror (fuzz == 0) is a delta lobe.
+        virtual color eval(const hit_record& rec, const vec3& wo, const vec3& wi) const override;
+        virtual double pdf(const hit_record& rec, const vec3& wo, const vec3& wi) const override;
+        virtual bool sample(
+            const hit_record& rec, const vec3& wo, double u1, double u2, bsdf_sample& s) const override;
+        virtual bool is_specular() const override { return fuzz <= 0; }
+        virtual color guide_albedo(const hit_record& rec) const override { return albedo; }
+
     public:
         color albedo;
         double fuzz;
+
+    private:
+        microfacet::metallic_roughness brdf() const {
+            return {albedo, 1.0, std::max(fuzz, 1e-4)};
+        }
 };
 
 #endif
@@ -0,0 +1,189 @@
+#ifndef MICROFACET_H
+#define MICROFACET_H
+
+#include "../util/vec3.h"
+#include "onb.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief GGX microfacet utilities shared by the physically-based materials
+ *
+ * All directions are unit vectors pointing away from the surface: `wo`
+ * towards the viewer, `wi` towards the light. Roughness is the perceptual
+ * value from the scene file; the GGX width is alpha = roughness^2.
+ */
+namespace microfacet {
+
+inline double alpha_from_roughness(double roughness) {
+  return std::max(roughness * roughness, 1e-4);
+}
+
+/**
+ * @brief GGX (Trowbridge-Reitz) normal distribution D(h)
+ */
+inline double ndf_ggx(double NdotH, double alpha) {
+  if (NdotH <= 0.0)
+    return 0.0;
+  double a2 = alpha * alpha;
+  double denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+  return a2 / (M_PI * denom * denom);
+}
+
+/**
+ * @brief Smith Lambda for GGX
+ */
+inline double lambda_ggx(double NdotX, double alpha) {
+  double cos2 = NdotX * NdotX;
+  double tan2 = std::max(0.0, 1.0 - cos2) / std::max(cos2, 1e-12);
+  return 0.5 * (std::sqrt(1.0 + alpha * alpha * tan2) - 1.0);
+}
+
+/**
+ * @brief Smith masking for a single direction
+ */
+inline double g1_smith(double NdotX, double alpha) {
+  return 1.0 / (1.0 + lambda_ggx(NdotX, alpha));
+}
+
+/**
+ * @brief Height-correlated Smith masking-shadowing G2(wo, wi)
+ */
+inline double g2_smith(double NdotV, double NdotL, double alpha) {
+  return 1.0 / (1.0 + lambda_ggx(NdotV, alpha) + lambda_ggx(NdotL, alpha));
+}
+
+/**
+ * @brief Fresnel-Schlick approximation
+ */
+inline color fresnel_schlick(double cosTheta, const color &F0) {
+  double t = std::pow(1.0 - std::clamp(cosTheta, 0.0, 1.0), 5.0);
+  return F0 + (color(1, 1, 1) - F0) * t;
+}
+
+/**
+ * @brief Sample a visible normal (GGX VNDF, Heitz 2018)
+ * @param wo View direction in the local frame (z = surface normal)
+ * @return Microfacet normal in the local frame
+ */
+inline vec3 sample_vndf(const vec3 &wo, double alpha, double u1, double u2) {
+  // Stretch the view direction to the hemisphere configuration
+  vec3 Vh = unit_vector(vec3(alpha * wo.x(), alpha * wo.y(), wo.z()));
+
+  // Orthonormal basis around Vh
+  double lensq = Vh.x() * Vh.x() + Vh.y() * Vh.y();
+  vec3 T1 = lensq > 0 ? vec3(-Vh.y(), Vh.x(), 0) / std::sqrt(lensq)
+                      : vec3(1, 0, 0);
+  vec3 T2 = cross(Vh, T1);
+
+  // Uniform disk sample, warped to the visible projected area
+  double r = std::sqrt(u1);
+  double phi = 2.0 * M_PI * u2;
+  double t1 = r * std::cos(phi);
+  double t2 = r * std::sin(phi);
+  double s = 0.5 * (1.0 + Vh.z());
+  t2 = (1.0 - s) * std::sqrt(std::max(0.0, 1.0 - t1 * t1)) + s * t2;
+
+  // Reproject onto the hemisphere and unstretch
+  vec3 Nh = t1 * T1 + t2 * T2 +
+            std::sqrt(std::max(0.0, 1.0 - t1 * t1 - t2 * t2)) * Vh;
+  return unit_vector(
+      vec3(alpha * Nh.x(), alpha * Nh.y(), std::max(1e-6, Nh.z())));
+}
+
+/**
+ * @brief Solid-angle pdf of a reflected direction generated by sample_vndf
+ */
+inline double pdf_vndf_reflection(double NdotV, double NdotH, double alpha) {
+  if (NdotV <= 0.0)
+    return 0.0;
+  return g1_smith(NdotV, alpha) * ndf_ggx(NdotH, alpha) / (4.0 * NdotV);
+}
+
+/**
+ * @brief Metallic-roughness BRDF: Lambertian diffuse plus GGX specular
+ *
+ * F0 is 0.04 for dielectrics and the base color for metals. The diffuse
+ * lobe is scaled by (1 - F) and vanishes for metals. Sampling picks one of
+ * the two lobes and pdf() returns the combined density, so eval/pdf are
+ * consistent with sample() for MIS.
+ */
+struct metallic_roughness {
+  color base;
+  double metallic;
+  double alpha;
+
+  color f0() const {
+    return color(0.04, 0.04, 0.04) * (1.0 - metallic) + base * metallic;
+  }
+
+  // Probability of sampling the specular lobe for a given view angle
+  double specular_probability(double NdotV) const {
+    color F = fresnel_schlick(NdotV, f0());
+    double spec = (F.x() + F.y() + F.z()) / 3.0;
+    double diff = (1.0 - metallic) * (base.x() + base.y() + base.z()) / 3.0 *
+                  (1.0 - spec);
+    if (diff <= 0.0)
+      return 1.0;
+    return std::clamp(spec / (spec + diff), 0.1, 0.9);
+  }
+
+  // BRDF times cos(theta_i)
+  color eval(const vec3 &N, const vec3 &wo, const vec3 &wi) const {
+    double NdotV = dot(N, wo);
+    double NdotL = dot(N, wi);
+    if (NdotV <= 0.0 || NdotL <= 0.0)
+      return color(0, 0, 0);
+
+    vec3 H = unit_vector(wo + wi);
+    color F = fresnel_schlick(dot(wo, H), f0());
+    double D = ndf_ggx(dot(N, H), alpha);
+    double G = g2_smith(NdotV, NdotL, alpha);
+
+    color specular = D * G * F / (4.0 * NdotV * NdotL);
+    color diffuse = (color(1, 1, 1) - F) * (1.0 - metallic) * base / M_PI;
+    return (diffuse + specular) * NdotL;
+  }
+
+  double pdf(const vec3 &N, const vec3 &wo, const vec3 &wi) const {
+    double NdotV = dot(N, wo);
+    double NdotL = dot(N, wi);
+    if (NdotV <= 0.0 || NdotL <= 0.0)
+      return 0.0;
+
+    vec3 H = unit_vector(wo + wi);
+    double p_spec = specular_probability(NdotV);
+    return p_spec * pdf_vndf_reflection(NdotV, dot(N, H), alpha) +
+           (1.0 - p_spec) * NdotL / M_PI;
+  }
+
+  bool sample(const vec3 &N, const vec3 &wo, double u1, double u2,
+              vec3 &wi) const {
+    double NdotV = dot(N, wo);
+    if (NdotV <= 0.0)
+      return false;
+
+    onb uvw;
+    uvw.build_from_w(N);
+    double p_spec = specular_probability(NdotV);
+    if (u1 < p_spec) {
+      // Specular: reflect about a visible microfacet normal
+      u1 = std::min(u1 / p_spec, 1.0 - 1e-12);
+      vec3 wo_local(dot(wo, uvw.u()), dot(wo, uvw.v()), NdotV);
+      vec3 H = uvw.local(sample_vndf(wo_local, alpha, u1, u2));
+      wi = 2.0 * dot(wo, H) * H - wo;
+    } else {
+      // Diffuse: cosine-weighted hemisphere
+      u1 = std::min((u1 - p_spec) / (1.0 - p_spec), 1.0 - 1e-12);
+      double phi = 2.0 * M_PI * u1;
+      double r = std::sqrt(u2);
+      wi = uvw.local(r * std::cos(phi), r * std::sin(phi),
+                     std::sqrt(std::max(0.0, 1.0 - u2)));
+    }
+    return dot(N, wi) > 0.0;
+  }
+};
+
+} // namespace microfacet
+
+#endif
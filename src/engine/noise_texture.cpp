@@ -0,0 +1,85 @@
+#include "noise_texture.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+// Keeps a bake within a few hundred MB whatever the XML asks for
+constexpr int kMaxBakeResolution = 512;
+
+} // namespace
+
+void bakeable_noise_texture::bake(const aabb &bounds) {
+  grid.clear();
+  if (bake_res <= 0)
+    return;
+  const int resolution = std::clamp(bake_res, 2, kMaxBakeResolution);
+
+  // Pad so flat objects (quads, planes) still get a cell of thickness
+  vec3 extent = bounds.max() - bounds.min();
+  const double longest = std::max({extent.x(), extent.y(), extent.z()});
+  const double pad = 1e-3 * longest + 1e-4;
+  origin = bounds.min() - vec3(pad, pad, pad);
+  extent += vec3(2 * pad, 2 * pad, 2 * pad);
+  const double cell = (longest + 2 * pad) / resolution;
+
+  int cells[3];
+  for (int a = 0; a < 3; a++)
+    cells[a] = std::max(1, static_cast<int>(std::ceil(extent[a] / cell)));
+  nx = cells[0] + 1;
+  ny = cells[1] + 1;
+  nz = cells[2] + 1;
+  inv_cell = vec3(1.0 / cell, 1.0 / cell, 1.0 / cell);
+  std::vector<float> values(size_t(nx) * ny * nz);
+
+  // Slices along z are independent
+  const unsigned workers =
+      std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                      static_cast<unsigned>(nz)));
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < workers; t++) {
+    threads.emplace_back([&, t] {
+      for (int z = static_cast<int>(t); z < nz; z += workers) {
+        for (int y = 0; y < ny; y++) {
+          for (int x = 0; x < nx; x++) {
+            const point3 p = origin + vec3(x, y, z) * cell;
+            values[(size_t(z) * ny + y) * nx + x] =
+                static_cast<float>(field(p));
+          }
+        }
+      }
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  grid = std::move(values);
+}
+
+double bakeable_noise_texture::lookup(const point3 &p) const {
+  if (grid.empty())
+    return field(p);
+
+  const double gx = (p.x() - origin.x()) * inv_cell.x();
+  const double gy = (p.y() - origin.y()) * inv_cell.y();
+  const double gz = (p.z() - origin.z()) * inv_cell.z();
+  if (!(gx >= 0.0 && gy >= 0.0 && gz >= 0.0 && gx <= nx - 1 &&
+        gy <= ny - 1 && gz <= nz - 1))
+    return field(p);
+
+  const int x = std::min(static_cast<int>(gx), nx - 2);
+  const int y = std::min(static_cast<int>(gy), ny - 2);
+  const int z = std::min(static_cast<int>(gz), nz - 2);
+  const float tx = static_cast<float>(gx - x);
+  const float ty = static_cast<float>(gy - y);
+  const float tz = static_cast<float>(gz - z);
+
+  const float *c = &grid[(size_t(z) * ny + y) * nx + x];
+  const size_t sy = nx, sz = size_t(nx) * ny;
+  const float c00 = c[0] + (c[1] - c[0]) * tx;
+  const float c10 = c[sy] + (c[sy + 1] - c[sy]) * tx;
+  const float c01 = c[sz] + (c[sz + 1] - c[sz]) * tx;
+  const float c11 = c[sz + sy] + (c[sz + sy + 1] - c[sz + sy]) * tx;
+  const float c0 = c00 + (c10 - c00) * ty;
+  const float c1 = c01 + (c11 - c01) * ty;
+  return c0 + (c1 - c0) * tz;
+}
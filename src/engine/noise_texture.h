@@ -1,8 +1,50 @@
 #ifndef NOISE_TEXTURE_H
 #define NOISE_TEXTURE_H
 
+#include "aabb.h"
 #include "perlin.h"
 #include "texture.h"
+#include <vector>
+
+/**
+ * @brief Base for solid noise textures whose scalar field can be baked
+ *
+ * Subclasses define field(p), the expensive Perlin part of the texture.
+ * With a bake resolution set, bake() evaluates the field once on a 3D grid
+ * over the given world-space bounds (the longest axis gets `resolution`
+ * cells) and lookups inside the bounds become one trilinear interpolation
+ * instead of several octaves of noise. Points outside the grid fall back
+ * to the procedural field.
+ */
+class bakeable_noise_texture : public texture {
+public:
+  void set_bake_resolution(int resolution) { bake_res = resolution; }
+  int bake_resolution() const { return bake_res; }
+  bool is_baked() const { return !grid.empty(); }
+
+  /**
+   * @brief Evaluate the field over `bounds` (multithreaded)
+   */
+  void bake(const aabb &bounds);
+
+  // Bytes held by the baked grid
+  size_t baked_size() const { return grid.size() * sizeof(float); }
+
+protected:
+  virtual double field(const point3 &p) const = 0;
+
+  // Baked field inside the grid, procedural field elsewhere
+  double lookup(const point3 &p) const;
+
+  perlin noise;
+
+private:
+  int bake_res = 0;
+  point3 origin;
+  vec3 inv_cell;  // Cells per world unit along each axis
+  int nx = 0, ny = 0, nz = 0; // Samples along each axis
+  std::vector<float> grid;
+};
 
 /**
  * @brief Noise-based procedural texture using Perlin noise
@@ -12,7 +54,7 @@
  * - Turbulent noise (multi-octave)
  * - Marble effect (using sine with turbulence phase)
  */
-class noise_texture : public texture {
+class noise_texture : public bakeable_noise_texture {
 public:
   noise_texture() : scale(1.0) {}
   noise_texture(double sc) : scale(sc) {}
@@ -21,18 +63,23 @@ public:
     (void)u;
     (void)v;
     // Marble-like effect using sine with turbulence
-    return color(1, 1, 1) * 0.5 * (1 + sin(scale * p.z() + 10 * noise.turb(p)));
+    return color(1, 1, 1) * 0.5 * (1 + sin(scale * p.z() + 10 * lookup(p)));
+  }
+
+protected:
+  // The turbulence phase; the sine stays exact at lookup time
+  virtual double field(const point3 &p) const override {
+    return noise.turb(p);
   }
 
 private:
-  perlin noise;
   double scale;
 };
 
 /**
  * @brief Turbulent noise texture for clouds/smoke effects
  */
-class turb_texture : public texture {
+class turb_texture : public bakeable_noise_texture {
 public:
   turb_texture() : scale(1.0) {}
   turb_texture(double sc) : scale(sc) {}
@@ -40,11 +87,15 @@ public:
   virtual color value(double u, double v, const point3 &p) const override {
     (void)u;
     (void)v;
-    return color(1, 1, 1) * noise.turb(scale * p);
+    return color(1, 1, 1) * lookup(p);
+  }
+
+protected:
+  virtual double field(const point3 &p) const override {
+    return noise.turb(scale * p);
   }
 
 private:
-  perlin noise;
   double scale;
 };
 
@@ -0,0 +1,419 @@
+#include "obj_reader.h"
+#include "../util/mapped_file.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+// Negative (relative) indices are stored with this bias until the chunk's
+// starting attribute counts are known
+constexpr int64_t kRelative = int64_t(1) << 40;
+constexpr int64_t kMissing = -1;
+
+/**
+ * @brief Everything parsed from one line-aligned slice of the file
+ */
+struct obj_chunk {
+  std::vector<float> v, vt;
+  std::vector<int64_t> corners; // (v, vt) per triangle corner
+  std::vector<std::pair<uint32_t, std::string>> usemtl; // (triangle, name)
+  std::vector<std::string> mtllibs;
+  std::string error;
+};
+
+inline const char *skip_spaces(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  return p;
+}
+
+inline const char *skip_token(const char *p, const char *end) {
+  while (p < end && *p != ' ' && *p != '\t')
+    p++;
+  return p;
+}
+
+inline const char *parse_float(const char *p, const char *end, float &out) {
+  p = skip_spaces(p, end);
+  if (p < end && *p == '+')
+    p++;
+  auto res = std::from_chars(p, end, out);
+  if (res.ec != std::errc()) {
+    out = 0.0f;
+    return skip_token(p, end);
+  }
+  return res.ptr;
+}
+
+inline std::string trimmed(const char *p, const char *end) {
+  p = skip_spaces(p, end);
+  while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+    end--;
+  return std::string(p, end);
+}
+
+// Encode an OBJ index: 1-based absolute or negative relative to the
+// attributes seen so far in this chunk
+inline int64_t encode_index(long long raw, size_t local_count) {
+  if (raw > 0)
+    return raw - 1;
+  if (raw < 0)
+    return kRelative + static_cast<int64_t>(local_count) + raw;
+  return kMissing;
+}
+
+bool parse_face(const char *p, const char *end, obj_chunk &c,
+                std::vector<int64_t> &poly) {
+  poly.clear();
+  const size_t nv = c.v.size() / 3;
+  const size_t nt = c.vt.size() / 2;
+
+  while (true) {
+    p = skip_spaces(p, end);
+    if (p >= end)
+      break;
+
+    long long iv = 0, it = 0, in = 0; // Normal index is read and dropped
+    auto res = std::from_chars(p, end, iv);
+    if (res.ec != std::errc())
+      return false;
+    p = res.ptr;
+    if (p < end && *p == '/') {
+      p++;
+      if (p < end && *p != '/') {
+        res = std::from_chars(p, end, it);
+        if (res.ec != std::errc())
+          return false;
+        p = res.ptr;
+      }
+      if (p < end && *p == '/') {
+        p++;
+        res = std::from_chars(p, end, in);
+        if (res.ec != std::errc())
+          return false;
+        p = res.ptr;
+      }
+    }
+    poly.push_back(encode_index(iv, nv));
+    poly.push_back(encode_index(it, nt));
+  }
+
+  // Fan triangulation (0, i, i + 1)
+  const size_t count = poly.size() / 2;
+  for (size_t i = 1; i + 1 < count; i++) {
+    c.corners.insert(c.corners.end(), poly.begin(), poly.begin() + 2);
+    c.corners.insert(c.corners.end(), poly.begin() + i * 2,
+                     poly.begin() + i * 2 + 4);
+  }
+  return true;
+}
+
+void parse_chunk(const char *begin, const char *end, obj_chunk &c) {
+  std::vector<int64_t> poly;
+  for (const char *line = begin; line < end;) {
+    const char *eol =
+        static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!eol)
+      eol = end;
+    const char *next = eol + (eol < end ? 1 : 0);
+    if (eol > line && eol[-1] == '\r')
+      eol--;
+
+    const char *p = skip_spaces(line, eol);
+    if (p + 1 < eol && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+      float x, y, z;
+      p = parse_float(p + 1, eol, x);
+      p = parse_float(p, eol, y);
+      parse_float(p, eol, z);
+      c.v.insert(c.v.end(), {x, y, z});
+    } else if (p + 2 < eol && p[0] == 'v' && p[1] == 't' &&
+               (p[2] == ' ' || p[2] == '\t')) {
+      float u = 0.0f, w = 0.0f;
+      p = parse_float(p + 2, eol, u);
+      if (skip_spaces(p, eol) < eol)
+        parse_float(p, eol, w);
+      c.vt.insert(c.vt.end(), {u, w});
+    } else if (p + 1 < eol && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+      if (!parse_face(p + 1, eol, c, poly) && c.error.empty()) {
+        c.error = "malformed face: " + std::string(line, eol);
+      }
+    } else if (eol - p > 7 && std::strncmp(p, "usemtl", 6) == 0 &&
+               (p[6] == ' ' || p[6] == '\t')) {
+      c.usemtl.emplace_back(static_cast<uint32_t>(c.corners.size() / 6),
+                            trimmed(p + 6, eol));
+    } else if (eol - p > 7 && std::strncmp(p, "mtllib", 6) == 0 &&
+               (p[6] == ' ' || p[6] == '\t')) {
+      // Libraries are separated by whitespace (`mtllib a.mtl b.mtl`)
+      for (const char *lib = skip_spaces(p + 6, eol); lib < eol;) {
+        const char *lib_end = skip_token(lib, eol);
+        c.mtllibs.emplace_back(lib, lib_end);
+        lib = skip_spaces(lib_end, eol);
+      }
+    }
+    // Comments, vn (meshes shade with face normals), o/g/s and unsupported
+    // statements are ignored
+
+    line = next;
+  }
+}
+
+inline color parse_color(const char *p, const char *end) {
+  float r = 0.0f, g = 0.0f, b = 0.0f;
+  p = parse_float(p, end, r);
+  p = parse_float(p, end, g);
+  parse_float(p, end, b);
+  return color(r, g, b);
+}
+
+inline bool keyword(const char *p, const char *end, const char *kw,
+                    const char *&rest) {
+  const size_t n = std::strlen(kw);
+  if (static_cast<size_t>(end - p) < n || std::strncmp(p, kw, n) != 0)
+    return false;
+  if (p + n < end && p[n] != ' ' && p[n] != '\t')
+    return false;
+  rest = p + n;
+  return true;
+}
+
+std::string directory_of(const std::string &path) {
+  const size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+} // namespace
+
+bool obj_reader::load_mtl(const std::string &filename,
+                          std::vector<obj_material> &out) {
+  mapped_file file(filename);
+  if (!file.valid())
+    return false;
+
+  const char *end = file.data() + file.size();
+  obj_material *cur = nullptr;
+
+  for (const char *line = file.data(); line < end;) {
+    const char *eol =
+        static_cast<const char *>(std::memchr(line, '\n', end - line));
+    if (!eol)
+      eol = end;
+    const char *next = eol + (eol < end ? 1 : 0);
+    if (eol > line && eol[-1] == '\r')
+      eol--;
+
+    const char *p = skip_spaces(line, eol);
+    const char *rest = nullptr;
+    if (keyword(p, eol, "newmtl", rest)) {
+      out.emplace_back();
+      cur = &out.back();
+      cur->name = trimmed(rest, eol);
+      cur->library = filename;
+    } else if (!cur || p >= eol || *p == '#') {
+      // Statements before the first newmtl are ignored
+    } else if (keyword(p, eol, "Ka", rest)) {
+      cur->Ka = parse_color(rest, eol);
+    } else if (keyword(p, eol, "Kd", rest)) {
+      cur->Kd = parse_color(rest, eol);
+    } else if (keyword(p, eol, "Ks", rest)) {
+      cur->Ks = parse_color(rest, eol);
+    } else if (keyword(p, eol, "Ke", rest)) {
+      cur->Ke = parse_color(rest, eol);
+    } else if (keyword(p, eol, "Tf", rest)) {
+      cur->Tf = parse_color(rest, eol);
+    } else if (keyword(p, eol, "Ns", rest)) {
+      parse_float(rest, eol, cur->Ns);
+    } else if (keyword(p, eol, "Ni", rest)) {
+      parse_float(rest, eol, cur->Ni);
+    } else if (keyword(p, eol, "d", rest)) {
+      parse_float(rest, eol, cur->d);
+    } else if (keyword(p, eol, "Tr", rest)) {
+      parse_float(rest, eol, cur->Tr);
+    } else if (keyword(p, eol, "Pr", rest)) {
+      parse_float(rest, eol, cur->Pr);
+    } else if (keyword(p, eol, "Pm", rest)) {
+      parse_float(rest, eol, cur->Pm);
+    } else if (keyword(p, eol, "illum", rest)) {
+      float illum = 0.0f;
+      parse_float(rest, eol, illum);
+      cur->illum = static_cast<int>(illum);
+    } else if (keyword(p, eol, "map_Kd", rest)) {
+      cur->map_Kd = trimmed(rest, eol);
+    } else if (keyword(p, eol, "map_Ks", rest)) {
+      cur->map_Ks = trimmed(rest, eol);
+    } else if (keyword(p, eol, "map_bump", rest) ||
+               keyword(p, eol, "map_Bump", rest) ||
+               keyword(p, eol, "bump", rest)) {
+      cur->map_bump = trimmed(rest, eol);
+    } else if (keyword(p, eol, "map_d", rest)) {
+      cur->map_d = trimmed(rest, eol);
+    }
+
+    line = next;
+  }
+  return true;
+}
+
+std::string obj_reader::map_path(const obj_material &mat,
+                                 const std::string &map) {
+  if (map.empty())
+    return std::string();
+  std::filesystem::path path(map);
+  if (path.is_relative() && !mat.library.empty())
+    path = std::filesystem::path(mat.library).parent_path() / path;
+  return path.string();
+}
+
+bool obj_reader::load(const std::string &filename, obj_mesh_data &out,
+                      std::string &error, unsigned threads) {
+  out = obj_mesh_data();
+
+  mapped_file file(filename);
+  if (!file.valid()) {
+    error = "cannot open " + filename;
+    return false;
+  }
+  file.advise_sequential();
+
+  // Split at line boundaries; small files are parsed on one thread
+  constexpr size_t kMinChunkBytes = 1 << 20;
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t max_chunks = file.size() / kMinChunkBytes + 1;
+  const size_t chunk_count = std::min<size_t>(threads, max_chunks);
+
+  const char *data = file.data();
+  const char *end = data + file.size();
+  std::vector<const char *> bounds{data};
+  for (size_t i = 1; i < chunk_count; i++) {
+    const char *p = data + file.size() * i / chunk_count;
+    p = std::max(p, bounds.back());
+    const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    bounds.push_back(nl ? nl + 1 : end);
+  }
+  bounds.push_back(end);
+
+  std::vector<obj_chunk> chunks(chunk_count);
+  if (chunk_count == 1) {
+    parse_chunk(bounds[0], bounds[1], chunks[0]);
+  } else {
+    std::vector<std::thread> workers;
+    workers.reserve(chunk_count);
+    for (size_t i = 0; i < chunk_count; i++) {
+      workers.emplace_back(parse_chunk, bounds[i], bounds[i + 1],
+                           std::ref(chunks[i]));
+    }
+    for (auto &w : workers)
+      w.join();
+  }
+
+  // Concatenate attributes and record where each chunk's ones start
+  std::vector<float> v, vt;
+  std::vector<size_t> v_base, vt_base, tri_base;
+  size_t total_corners = 0;
+  for (const auto &c : chunks) {
+    if (!c.error.empty()) {
+      error = c.error;
+      return false;
+    }
+    v_base.push_back(v.size() / 3);
+    vt_base.push_back(vt.size() / 2);
+    tri_base.push_back(total_corners / 3);
+    v.insert(v.end(), c.v.begin(), c.v.end());
+    vt.insert(vt.end(), c.vt.begin(), c.vt.end());
+    total_corners += c.corners.size() / 2;
+  }
+
+  const size_t nv = v.size() / 3;
+  const size_t nt = vt.size() / 2;
+
+  // Deduplicate (v, vt) corners. Each position keeps a short chain of the
+  // texcoords already emitted for it.
+  struct corner_slot {
+    int64_t vt;
+    uint32_t vertex;
+    int32_t next;
+  };
+  std::vector<int32_t> head(nv, -1);
+  std::vector<corner_slot> slots;
+  slots.reserve(nv);
+  out.positions.reserve(nv * 3);
+  out.texcoords.reserve(nv * 2);
+  out.indices.reserve(total_corners);
+
+  auto resolve = [](int64_t raw, size_t base, size_t count,
+                    int64_t &idx) -> bool {
+    if (raw == kMissing) {
+      idx = kMissing;
+      return true;
+    }
+    idx = raw >= kRelative / 2 ? static_cast<int64_t>(base) + raw - kRelative
+                               : raw;
+    return idx >= 0 && idx < static_cast<int64_t>(count);
+  };
+
+  for (size_t ci = 0; ci < chunks.size(); ci++) {
+    const auto &corners = chunks[ci].corners;
+    for (size_t k = 0; k < corners.size(); k += 2) {
+      int64_t iv, it;
+      if (!resolve(corners[k], v_base[ci], nv, iv) || iv == kMissing ||
+          !resolve(corners[k + 1], vt_base[ci], nt, it)) {
+        error = "face index out of range in " + filename;
+        return false;
+      }
+
+      int32_t s = head[iv];
+      while (s >= 0 && slots[s].vt != it)
+        s = slots[s].next;
+
+      if (s < 0) {
+        const uint32_t vertex = static_cast<uint32_t>(out.positions.size() / 3);
+        slots.push_back({it, vertex, head[iv]});
+        s = head[iv] = static_cast<int32_t>(slots.size() - 1);
+
+        out.positions.insert(out.positions.end(), &v[iv * 3], &v[iv * 3] + 3);
+        if (it >= 0)
+          out.texcoords.insert(out.texcoords.end(), &vt[it * 2],
+                               &vt[it * 2] + 2);
+        else
+          out.texcoords.insert(out.texcoords.end(), {0.0f, 0.0f});
+      }
+      out.indices.push_back(slots[s].vertex);
+    }
+  }
+
+  // Material groups from the usemtl events, in file order
+  const uint32_t triangle_total = static_cast<uint32_t>(out.triangle_count());
+  std::string current;
+  uint32_t group_start = 0;
+  auto close_group = [&](uint32_t until) {
+    if (until > group_start)
+      out.groups.push_back({current, group_start, until - group_start});
+    group_start = until;
+  };
+  for (size_t ci = 0; ci < chunks.size(); ci++) {
+    for (const auto &[tri, name] : chunks[ci].usemtl) {
+      const uint32_t at = static_cast<uint32_t>(tri_base[ci]) + tri;
+      if (name == current)
+        continue;
+      close_group(at);
+      current = name;
+    }
+  }
+  close_group(triangle_total);
+
+  // Materials from every mtllib, resolved relative to the OBJ
+  const std::string dir = directory_of(filename);
+  for (const auto &c : chunks) {
+    for (const auto &lib : c.mtllibs) {
+      if (load_mtl(dir + lib, out.materials))
+        out.material_libraries.push_back(dir + lib);
+      else if (load_mtl(lib, out.materials))
+        out.material_libraries.push_back(lib);
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef OBJ_READER_H
+#define OBJ_READER_H
+
+#include "../util/vec3.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Material parsed from a Wavefront .mtl file
+ */
+struct obj_material {
+  std::string name;
+  std::string library; // MTL file the material was read from
+  color Ka{0, 0, 0}; // Ambient
+  color Kd{0, 0, 0}; // Diffuse
+  color Ks{0, 0, 0}; // Specular
+  color Ke{0, 0, 0}; // Emission
+  color Tf{0, 0, 0}; // Transmission filter
+  float Ns = 0.0f;   // Specular exponent
+  float Ni = 0.0f;   // Index of refraction
+  float d = 1.0f;    // Dissolve
+  float Tr = 0.0f;   // Transparency (1 - d)
+  float Pr = 0.0f;   // PBR roughness
+  float Pm = 0.0f;   // PBR metallic
+  int illum = 0;     // Illumination model
+  std::string map_Kd;
+  std::string map_Ks;
+  std::string map_bump;
+  std::string map_d;
+};
+
+/**
+ * @brief Run of consecutive triangles that share one material
+ */
+struct obj_group {
+  std::string material; // usemtl name (empty when none was set)
+  uint32_t first_triangle = 0;
+  uint32_t triangle_count = 0;
+};
+
+/**
+ * @brief Indexed triangle mesh produced by obj_reader
+ *
+ * Vertices are the unique (position, texcoord) combinations referenced by
+ * the faces, so the buffers can be used directly for rendering or BVH
+ * construction. Polygons are fan-triangulated. Vertex normals (vn) are not
+ * read: meshes shade with face normals, so they would only split vertices.
+ */
+struct obj_mesh_data {
+  std::vector<float> positions;  // 3 floats per vertex
+  std::vector<float> texcoords;  // 2 floats per vertex (0 when absent)
+  std::vector<uint32_t> indices; // 3 vertex indices per triangle
+  std::vector<obj_group> groups;
+  std::vector<obj_material> materials; // From all referenced mtllibs
+  std::vector<std::string> material_libraries; // Paths of the loaded mtllibs
+
+  size_t vertex_count() const { return positions.size() / 3; }
+  size_t triangle_count() const { return indices.size() / 3; }
+};
+
+/**
+ * @brief Parallel Wavefront OBJ/MTL reader
+ *
+ * The file is memory-mapped and split into chunks at line boundaries.
+ * Each chunk is parsed on its own thread with std::from_chars, then the
+ * chunks are stitched together (resolving negative indices against the
+ * running attribute counts) and the face corners are deduplicated into an
+ * indexed vertex buffer.
+ */
+class obj_reader {
+public:
+  /**
+   * @brief Load an OBJ file and the materials of its mtllib statements
+   * @param filename Path to the .obj file
+   * @param out Output mesh (cleared first)
+   * @param error Human-readable reason when loading fails
+   * @param threads Worker threads (0 = hardware concurrency)
+   * @return true on success
+   */
+  static bool load(const std::string &filename, obj_mesh_data &out,
+                   std::string &error, unsigned threads = 0);
+
+  /**
+   * @brief Load all materials from an MTL file (appended to `out`)
+   */
+  static bool load_mtl(const std::string &filename,
+                       std::vector<obj_material> &out);
+
+  /**
+   * @brief Path of a texture map named in an MTL record, resolved next to
+   *        the record's library (empty when `map` is)
+   */
+  static std::string map_path(const obj_material &mat, const std::string &map);
+};
+
+#endif
@@ -1,117 +1,187 @@
 #include "oidn_denoiser.h"
+#include "denoiser.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #ifdef USE_OIDN
 #include <OpenImageDenoise/oidn.hpp>
 #endif
 
+namespace {
+// Interleaved float RGB copy of an image
+std::vector<float> to_floats(const std::vector<color> &image) {
+  std::vector<float> buffer(image.size() * 3);
+  for (size_t i = 0; i < image.size(); i++) {
+    buffer[i * 3 + 0] = static_cast<float>(image[i].x());
+    buffer[i * 3 + 1] = static_cast<float>(image[i].y());
+    buffer[i * 3 + 2] = static_cast<float>(image[i].z());
+  }
+  return buffer;
+}
+} // namespace
+
 std::vector<color> oidn_denoiser::denoise(const std::vector<color> &input,
-                                          int width, int height,
-                                          bool hdr) const {
-#ifdef USE_OIDN
-  // Convert input to float array for OIDN
-  std::vector<float> color_buffer(width * height * 3);
-  for (int i = 0; i < width * height; i++) {
-    color_buffer[i * 3 + 0] = static_cast<float>(input[i].x());
-    color_buffer[i * 3 + 1] = static_cast<float>(input[i].y());
-    color_buffer[i * 3 + 2] = static_cast<float>(input[i].z());
+                                          int width, int height, bool hdr) {
+  return denoise(input, {}, {}, width, height, hdr);
+}
+
+std::vector<color> oidn_denoiser::denoise(const std::vector<color> &input,
+                                          const std::vector<color> &albedo,
+                                          const std::vector<color> &normal,
+                                          int width, int height, bool hdr) {
+  const size_t count = static_cast<size_t>(width) * height;
+  const bool useAlbedo = albedo.size() == count;
+  const bool useNormal = useAlbedo && normal.size() == count;
+
+  std::vector<float> rgb = to_floats(input);
+  std::vector<float> albedo_floats, normal_floats;
+  if (useAlbedo)
+    albedo_floats = to_floats(albedo);
+  if (useNormal)
+    normal_floats = to_floats(normal);
+
+  if (!denoise_in_place(rgb.data(), useAlbedo ? albedo_floats.data() : nullptr,
+                        useNormal ? normal_floats.data() : nullptr, width,
+                        height, hdr)) {
+    return input; // Return original on error
+  }
+
+  // Convert back to color array
+  std::vector<color> output(count);
+  for (size_t i = 0; i < count; i++) {
+    output[i] = color(rgb[i * 3 + 0], rgb[i * 3 + 1], rgb[i * 3 + 2]);
   }
 
-  // Create output buffer
-  std::vector<float> output_buffer(width * height * 3);
+#ifdef USE_OIDN
+  std::cerr << "OIDN denoising complete (" << width << "x" << height << ")"
+            << std::endl;
+#else
+  std::cerr << "OIDN not available, used a-trous filter fallback"
+            << std::endl;
+#endif
+  return output;
+}
 
-  // Create OIDN device
-  oidn::DeviceRef device = oidn::newDevice();
-  device.commit();
+bool oidn_denoiser::denoise_in_place(float *rgb, const float *albedo,
+                                     const float *normal, int width,
+                                     int height, bool hdr,
+                                     bool cleanFeatures) {
+  if (!rgb || width <= 0 || height <= 0) {
+    return false;
+  }
+  const size_t count = static_cast<size_t>(width) * height;
 
-  // Create ray tracing filter
-  oidn::FilterRef filter = device.newFilter("RT");
-  filter.setImage("color", color_buffer.data(), oidn::Format::Float3, width,
-                  height);
-  filter.setImage("output", output_buffer.data(), oidn::Format::Float3, width,
-                  height);
-  filter.set("hdr", hdr);
-  filter.commit();
+#ifdef USE_OIDN
+  const bool useAlbedo = albedo != nullptr;
+  const bool useNormal = useAlbedo && normal != nullptr;
+  if (!prepare(width, height, hdr, useAlbedo, useNormal, !cleanFeatures)) {
+    return false;
+  }
 
-  // Execute denoising
+  // Copy in, filter in place, copy out; nothing is reallocated
+  const size_t bytes = count * 3 * sizeof(float);
+  color_buffer.write(0, bytes, rgb);
+  if (useAlbedo) {
+    albedo_buffer.write(0, bytes, albedo);
+    if (prefilter_features)
+      albedo_filter.execute();
+  }
+  if (useNormal) {
+    normal_buffer.write(0, bytes, normal);
+    if (prefilter_features)
+      normal_filter.execute();
+  }
   filter.execute();
 
-  // Check for errors
   const char *errorMessage;
   if (device.getError(errorMessage) != oidn::Error::None) {
     std::cerr << "OIDN Error: " << errorMessage << std::endl;
-    return input; // Return original on error
+    committed = false; // Rebuild everything on the next call
+    return false;
   }
+  color_buffer.read(0, bytes, rgb);
+  return true;
+#else
+  // No depth here; callers that have it use denoiser::atrous_filter()
+  (void)count;
+  (void)hdr;
+  (void)cleanFeatures;
+  denoiser::atrous_filter(rgb, albedo, normal, nullptr, width, height);
+  return true;
+#endif
+}
 
-  // Convert back to color array
-  std::vector<color> output(width * height);
-  for (int i = 0; i < width * height; i++) {
-    output[i] = color(output_buffer[i * 3 + 0], output_buffer[i * 3 + 1],
-                      output_buffer[i * 3 + 2]);
+#ifdef USE_OIDN
+bool oidn_denoiser::prepare(int w, int h, bool hdr_, bool albedo_,
+                            bool normal_, bool prefilter_) {
+  if (committed && w == width && h == height && hdr_ == hdr &&
+      albedo_ == has_albedo && normal_ == has_normal &&
+      prefilter_ == prefilter_features) {
+    return true;
   }
 
-  std::cerr << "OIDN denoising complete (" << width << "x" << height << ")"
-            << std::endl;
-  return output;
+  if (!device) {
+    device = oidn::newDevice();
+    device.commit();
+  }
 
-#else
-  // Fallback: simple bilateral filter when OIDN not available
-  std::cerr << "OIDN not available, using bilateral filter fallback"
-            << std::endl;
+  // Buffers only grow or shrink with the resolution
+  const size_t bytes = static_cast<size_t>(w) * h * 3 * sizeof(float);
+  if (w != width || h != height || !color_buffer) {
+    color_buffer = device.newBuffer(bytes);
+    albedo_buffer = oidn::BufferRef();
+    normal_buffer = oidn::BufferRef();
+  }
+  if (albedo_ && !albedo_buffer)
+    albedo_buffer = device.newBuffer(bytes);
+  if (normal_ && !normal_buffer)
+    normal_buffer = device.newBuffer(bytes);
+
+  // Feature prefilters denoise the features in place
+  auto make_prefilter = [&](const char *name, oidn::BufferRef &buffer) {
+    oidn::FilterRef feature = device.newFilter("RT");
+    feature.setImage(name, buffer, oidn::Format::Float3, w, h);
+    feature.setImage("output", buffer, oidn::Format::Float3, w, h);
+    feature.commit();
+    return feature;
+  };
+  albedo_filter = albedo_ && prefilter_
+                      ? make_prefilter("albedo", albedo_buffer)
+                      : oidn::FilterRef();
+  normal_filter = normal_ && prefilter_
+                      ? make_prefilter("normal", normal_buffer)
+                      : oidn::FilterRef();
+
+  // Beauty filter, in place
+  filter = device.newFilter("RT");
+  filter.setImage("color", color_buffer, oidn::Format::Float3, w, h);
+  if (albedo_)
+    filter.setImage("albedo", albedo_buffer, oidn::Format::Float3, w, h);
+  if (normal_)
+    filter.setImage("normal", normal_buffer, oidn::Format::Float3, w, h);
+  filter.setImage("output", color_buffer, oidn::Format::Float3, w, h);
+  filter.set("hdr", hdr_);
+  filter.set("cleanAux", albedo_);
+  filter.commit();
 
-  std::vector<color> output(width * height);
-  int kernel_size = 5;
-  int half_kernel = kernel_size / 2;
-  double sigma_spatial = 2.0;
-  double sigma_range = 0.1;
-
-  double spatial_coeff = -0.5 / (sigma_spatial * sigma_spatial);
-  double range_coeff = -0.5 / (sigma_range * sigma_range);
-
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      int idx = y * width + x;
-      color center = input[idx];
-
-      color sum(0, 0, 0);
-      double weight_sum = 0.0;
-
-      for (int ky = -half_kernel; ky <= half_kernel; ky++) {
-        for (int kx = -half_kernel; kx <= half_kernel; kx++) {
-          int nx = std::clamp(x + kx, 0, width - 1);
-          int ny = std::clamp(y + ky, 0, height - 1);
-          int nidx = ny * width + nx;
-
-          color neighbor = input[nidx];
-
-          double spatial_dist_sq = kx * kx + ky * ky;
-          double spatial_weight = exp(spatial_dist_sq * spatial_coeff);
-
-          double dr = center.x() - neighbor.x();
-          double dg = center.y() - neighbor.y();
-          double db = center.z() - neighbor.z();
-          double color_dist_sq = dr * dr + dg * dg + db * db;
-          double range_weight = exp(color_dist_sq * range_coeff);
-
-          double weight = spatial_weight * range_weight;
-
-          sum = sum + neighbor * weight;
-          weight_sum += weight;
-        }
-      }
-
-      if (weight_sum > 0) {
-        output[idx] = sum * (1.0 / weight_sum);
-      } else {
-        output[idx] = center;
-      }
-    }
+  const char *errorMessage;
+  if (device.getError(errorMessage) != oidn::Error::None) {
+    std::cerr << "OIDN Error: " << errorMessage << std::endl;
+    committed = false;
+    return false;
   }
 
-  return output;
-#endif
+  width = w;
+  height = h;
+  hdr = hdr_;
+  has_albedo = albedo_;
+  has_normal = normal_;
+  prefilter_features = prefilter_;
+  committed = true;
+  return true;
 }
+#endif
 
 bool oidn_denoiser::is_available() {
 #ifdef USE_OIDN
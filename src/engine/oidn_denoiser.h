@@ -15,12 +15,22 @@
  * @brief Intel Open Image Denoise wrapper
  *
  * Provides high-quality AI-accelerated denoising for path-traced images.
- * Falls back to simple bilateral filter if OIDN is not available.
+ * Falls back to denoiser::atrous_filter() if OIDN is not available.
+ *
+ * The object owns the OIDN device, the committed filters and their image
+ * buffers. They are created on first use and kept while the image size,
+ * the hdr flag and the set of features stay the same, so repeated calls
+ * (progressive previews, animation frames) only copy pixels in and out and
+ * run the filter. One denoiser must not be used from several threads at
+ * once.
  */
 class oidn_denoiser {
 public:
   oidn_denoiser() = default;
 
+  oidn_denoiser(const oidn_denoiser &) = delete;
+  oidn_denoiser &operator=(const oidn_denoiser &) = delete;
+
   /**
    * @brief Denoise a rendered image
    *
@@ -31,7 +41,37 @@ public:
    * @return Denoised image
    */
   std::vector<color> denoise(const std::vector<color> &input, int width,
-                             int height, bool hdr = true) const;
+                             int height, bool hdr = true);
+
+  /**
+   * @brief Denoise guided by first-hit feature images
+   *
+   * The features are prefiltered first, so they may come from as few
+   * samples as the beauty image, and are then passed to the beauty filter
+   * with cleanAux set.
+   *
+   * @param albedo Per-pixel average albedo, or empty for none
+   * @param normal Per-pixel average normal, or empty for none (only used
+   *        together with albedo)
+   */
+  std::vector<color> denoise(const std::vector<color> &input,
+                             const std::vector<color> &albedo,
+                             const std::vector<color> &normal, int width,
+                             int height, bool hdr = true);
+
+  /**
+   * @brief Denoise a float RGB framebuffer in place
+   *
+   * @param rgb width * height * 3 linear floats, overwritten by the result
+   * @param albedo Same layout, or nullptr
+   * @param normal Same layout, or nullptr (only used together with albedo)
+   * @param cleanFeatures The features are noise-free (e.g. traced through
+   *        pixel centres) and need no prefiltering
+   * @return false on failure, leaving `rgb` unchanged
+   */
+  bool denoise_in_place(float *rgb, const float *albedo, const float *normal,
+                        int width, int height, bool hdr = true,
+                        bool cleanFeatures = false);
 
   /**
    * @brief Check if OIDN is available
@@ -42,6 +82,30 @@ public:
    * @brief Get OIDN version string
    */
   static std::string version();
+
+private:
+#ifdef USE_OIDN
+  // Recreate the filters if the request differs from the committed one
+  bool prepare(int w, int h, bool hdr_, bool albedo_, bool normal_,
+               bool prefilter_);
+
+  oidn::DeviceRef device;
+  oidn::FilterRef filter;         // Beauty filter, in place on color_buffer
+  oidn::FilterRef albedo_filter;  // Feature prefilters, in place
+  oidn::FilterRef normal_filter;
+  oidn::BufferRef color_buffer;
+  oidn::BufferRef albedo_buffer;
+  oidn::BufferRef normal_buffer;
+
+  // Configuration the filters were committed with
+  int width = 0;
+  int height = 0;
+  bool hdr = true;
+  bool has_albedo = false;
+  bool has_normal = false;
+  bool prefilter_features = false;
+  bool committed = false;
+#endif
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include "../util/vec3.h"
 #include "hittable.h"
 #include "material.h"
+#include "microfacet.h"
 #include "texture.h"
 #include <cmath>
 #include <memory>
@@ -12,7 +13,8 @@
  * @brief Physically-Based Rendering (PBR) material
  *
  * Implements the Cook-Torrance BRDF with GGX distribution,
- * providing realistic metallic and dielectric surfaces.
+ * providing realistic metallic and dielectric surfaces. Directions are
+ * importance-sampled with GGX VNDF sampling (see microfacet.h).
  *
  * Key parameters:
  * - albedo: Base color (texture or solid)
@@ -32,49 +34,41 @@ public:
 
   virtual bool scatter(const ray &r_in, const hit_record &rec,
                        color &attenuation, ray &scattered) const override {
-    // Sample albedo texture
-    color base_color = albedo->value(rec.u, rec.v, rec.p);
-
-    // Calculate reflection vs diffuse based on roughness and metallic
-    vec3 unit_direction = unit_vector(r_in.direction());
-
-    // Perfect reflection direction
-    vec3 reflected = reflect(unit_direction, rec.normal);
-
-    // Add roughness-based perturbation
-    vec3 scatter_direction;
+    bsdf_sample s;
+    if (!sample(rec, -unit_vector(r_in.direction()), random_double(),
+                random_double(), s))
+      return false;
+    scattered = ray(rec.p, s.wi, r_in.time());
+    attenuation = s.weight;
+    return true;
+  }
 
-    if (metallic > 0.5f) {
-      // Metallic surfaces: mostly specular with roughness blur
-      scatter_direction = reflected + roughness * random_in_unit_sphere();
-      if (scatter_direction.near_zero())
-        scatter_direction = rec.normal;
+  virtual color eval(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return brdf(rec).eval(rec.normal, wo, wi);
+  }
 
-      // Metallic materials tint reflections with albedo
-      attenuation = base_color;
-    } else {
-      // Dielectric surfaces: mix of diffuse and specular
-      // Fresnel-based blend
-      double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-      double fresnel = schlick_fresnel(cos_theta, 0.04);
+  virtual double pdf(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return brdf(rec).pdf(rec.normal, wo, wi);
+  }
 
-      if (random_double() < fresnel * (1.0 - roughness)) {
-        // Specular reflection
-        scatter_direction = reflected + roughness * random_in_unit_sphere();
-        if (scatter_direction.near_zero())
-          scatter_direction = rec.normal;
-        attenuation = color(1, 1, 1); // Specular is white for dielectrics
-      } else {
-        // Diffuse scatter
-        scatter_direction = rec.normal + random_unit_vector();
-        if (scatter_direction.near_zero())
-          scatter_direction = rec.normal;
-        attenuation = base_color;
-      }
-    }
+  virtual bool sample(const hit_record &rec, const vec3 &wo, double u1,
+                      double u2, bsdf_sample &s) const override {
+    // GGX visible-normal sampling for the specular lobe, cosine for diffuse
+    const microfacet::metallic_roughness model = brdf(rec);
+    if (!model.sample(rec.normal, wo, u1, u2, s.wi))
+      return false;
+    s.pdf = model.pdf(rec.normal, wo, s.wi);
+    if (s.pdf <= 0.0)
+      return false;
+    s.weight = model.eval(rec.normal, wo, s.wi) / s.pdf;
+    s.is_delta = false;
+    return true;
+  }
 
-    scattered = ray(rec.p, scatter_direction);
-    return (dot(scattered.direction(), rec.normal) > 0);
+  virtual color guide_albedo(const hit_record &rec) const override {
+    return albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint);
   }
 
 public:
@@ -83,9 +77,10 @@ public:
   float roughness;
 
 private:
-  // Schlick's approximation for Fresnel
-  static double schlick_fresnel(double cosine, double f0) {
-    return f0 + (1.0 - f0) * pow((1.0 - cosine), 5);
+  // BRDF parameters at the hit point (albedo may be textured)
+  microfacet::metallic_roughness brdf(const hit_record &rec) const {
+    return {albedo->filtered_value(rec.u, rec.v, rec.p, rec.footprint),
+            metallic, microfacet::alpha_from_roughness(roughness)};
   }
 };
 
@@ -11,25 +11,24 @@
  * - Gradient vectors at lattice points
  * - Trilinear interpolation with Hermite smoothing
  * - Turbulence for fractal detail
+ *
+ * Gradients are stored as separate x/y/z float arrays so the eight lattice
+ * corners of a lookup are evaluated as eight-wide lanes that the compiler
+ * turns into SIMD arithmetic.
  */
 class perlin {
 public:
   perlin() {
-    ranvec = new vec3[point_count];
     for (int i = 0; i < point_count; ++i) {
-      ranvec[i] = unit_vector(vec3::random(-1, 1));
+      const vec3 g = unit_vector(vec3::random(-1, 1));
+      grad_x[i] = static_cast<float>(g.x());
+      grad_y[i] = static_cast<float>(g.y());
+      grad_z[i] = static_cast<float>(g.z());
     }
 
-    perm_x = perlin_generate_perm();
-    perm_y = perlin_generate_perm();
-    perm_z = perlin_generate_perm();
-  }
-
-  ~perlin() {
-    delete[] ranvec;
-    delete[] perm_x;
-    delete[] perm_y;
-    delete[] perm_z;
+    perlin_generate_perm(perm_x);
+    perlin_generate_perm(perm_y);
+    perlin_generate_perm(perm_z);
   }
 
   /**
@@ -38,32 +37,41 @@ public:
    * @return Noise value in range [-1, 1]
    */
   double noise(const point3 &p) const {
-    auto u = p.x() - floor(p.x());
-    auto v = p.y() - floor(p.y());
-    auto w = p.z() - floor(p.z());
+    const double fx = floor(p.x()), fy = floor(p.y()), fz = floor(p.z());
+    const int i = static_cast<int>(fx);
+    const int j = static_cast<int>(fy);
+    const int k = static_cast<int>(fz);
 
     // Hermite cubic smoothing for smoother interpolation
-    u = u * u * (3 - 2 * u);
-    v = v * v * (3 - 2 * v);
-    w = w * w * (3 - 2 * w);
-
-    auto i = static_cast<int>(floor(p.x()));
-    auto j = static_cast<int>(floor(p.y()));
-    auto k = static_cast<int>(floor(p.z()));
-
-    vec3 c[2][2][2];
-
-    for (int di = 0; di < 2; di++) {
-      for (int dj = 0; dj < 2; dj++) {
-        for (int dk = 0; dk < 2; dk++) {
-          c[di][dj][dk] =
-              ranvec[perm_x[(i + di) & 255] ^ perm_y[(j + dj) & 255] ^
-                     perm_z[(k + dk) & 255]];
-        }
-      }
+    const float u = hermite(static_cast<float>(p.x() - fx));
+    const float v = hermite(static_cast<float>(p.y() - fy));
+    const float w = hermite(static_cast<float>(p.z() - fz));
+
+    // Corner c sits at lattice offset (c >> 2, (c >> 1) & 1, c & 1)
+    alignas(32) float gx[8], gy[8], gz[8];
+    for (int c = 0; c < 8; c++) {
+      const int g = perm_x[(i + (c >> 2)) & 255] ^
+                    perm_y[(j + ((c >> 1) & 1)) & 255] ^
+                    perm_z[(k + (c & 1)) & 255];
+      gx[c] = grad_x[g];
+      gy[c] = grad_y[g];
+      gz[c] = grad_z[g];
     }
 
-    return perlin_interp(c, u, v, w);
+    // Interpolation weights use the twice-smoothed fractions
+    const float uu = hermite(u), vv = hermite(v), ww = hermite(w);
+    float accum = 0.0f;
+    for (int c = 0; c < 8; c++) {
+      const float di = static_cast<float>(c >> 2);
+      const float dj = static_cast<float>((c >> 1) & 1);
+      const float dk = static_cast<float>(c & 1);
+      const float weight = (di * uu + (1 - di) * (1 - uu)) *
+                           (dj * vv + (1 - dj) * (1 - vv)) *
+                           (dk * ww + (1 - dk) * (1 - ww));
+      accum += weight *
+               (gx[c] * (u - di) + gy[c] * (v - dj) + gz[c] * (w - dk));
+    }
+    return accum;
   }
 
   /**
@@ -88,21 +96,21 @@ public:
 
 private:
   static const int point_count = 256;
-  vec3 *ranvec;
-  int *perm_x;
-  int *perm_y;
-  int *perm_z;
+  alignas(32) float grad_x[point_count];
+  alignas(32) float grad_y[point_count];
+  alignas(32) float grad_z[point_count];
+  int perm_x[point_count];
+  int perm_y[point_count];
+  int perm_z[point_count];
 
-  static int *perlin_generate_perm() {
-    auto p = new int[point_count];
+  static float hermite(float t) { return t * t * (3 - 2 * t); }
 
+  static void perlin_generate_perm(int *p) {
     for (int i = 0; i < point_count; i++) {
       p[i] = i;
     }
 
     permute(p, point_count);
-
-    return p;
   }
 
   static void permute(int *p, int n) {
@@ -113,26 +121,6 @@ private:
       p[target] = tmp;
     }
   }
-
-  static double perlin_interp(vec3 c[2][2][2], double u, double v, double w) {
-    auto uu = u * u * (3 - 2 * u);
-    auto vv = v * v * (3 - 2 * v);
-    auto ww = w * w * (3 - 2 * w);
-    auto accum = 0.0;
-
-    for (int i = 0; i < 2; i++) {
-      for (int j = 0; j < 2; j++) {
-        for (int k = 0; k < 2; k++) {
-          vec3 weight_v(u - i, v - j, w - k);
-          accum += (i * uu + (1 - i) * (1 - uu)) *
-                   (j * vv + (1 - j) * (1 - vv)) *
-                   (k * ww + (1 - k) * (1 - ww)) * dot(c[i][j][k], weight_v);
-        }
-      }
-    }
-
-    return accum;
-  }
 };
 
 #endif
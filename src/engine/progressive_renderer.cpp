@@ -0,0 +1,772 @@
+#include "engine/progressive_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "engine/camera.h"
+#include "engine/denoiser.h"
+#include "engine/material.h"
+#include "engine/render_runner.h"
+#include "engine/world.h"
+#include "util/ray.h"
+
+namespace render {
+namespace {
+
+constexpr int kTileSize = 32;
+
+// Motion frames aim for ~30 fps: drop to 1/8 resolution above the upper
+// bound, return to 1/4 below the lower one
+constexpr double kSlowMotionFrameMs = 40.0;
+constexpr double kFastMotionFrameMs = 12.0;
+
+// Joint bilateral upsampling: depth differences are relative to the
+// pixel's own depth, normals use a cosine power
+constexpr float kDepthSigma = 0.05f;
+constexpr int kNormalPower = 8;
+constexpr float kMinAlbedo = 0.01f;
+
+// Reprojection: old primary hits must lie within this fraction of the
+// distance to the old camera and have a similar normal, and reprojected
+// history counts as at most this many samples so new ones take over
+constexpr float kReprojectDepth = 0.02f;
+constexpr float kReprojectNormal = 0.9f;
+constexpr float kMaxHistory = 16.0f;
+
+// Same encoding as the GUI texture: sqrt gamma, clamped
+uint8_t EncodeChannel(double value) {
+  const double encoded = std::sqrt(value > 0.0 ? value : 0.0);
+  return static_cast<uint8_t>(255.99 * (encoded < 1.0 ? encoded : 1.0));
+}
+
+// Grow `dirty` to cover `rect`
+void Merge(ProgressiveRenderer::Rect &dirty,
+           const ProgressiveRenderer::Rect &rect) {
+  if (dirty.Empty()) {
+    dirty = rect;
+    return;
+  }
+  const int x1 = std::max(dirty.x + dirty.w, rect.x + rect.w);
+  const int y1 = std::max(dirty.y + dirty.h, rect.y + rect.h);
+  dirty.x = std::min(dirty.x, rect.x);
+  dirty.y = std::min(dirty.y, rect.y);
+  dirty.w = x1 - dirty.x;
+  dirty.h = y1 - dirty.y;
+}
+
+} // namespace
+
+ProgressiveRenderer::ProgressiveRenderer(unsigned int threads) {
+  if (threads == 0) {
+    const unsigned int hw = std::thread::hardware_concurrency();
+    threads = hw > 1 ? hw - 1 : 1;
+  }
+  m_Workers.reserve(threads);
+  for (unsigned int i = 0; i < threads; ++i) {
+    m_Workers.emplace_back([this] { Worker(); });
+  }
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Quit = true;
+    ++m_Generation;
+  }
+  m_Wake.notify_all();
+  for (auto &th : m_Workers) {
+    if (th.joinable()) {
+      th.join();
+    }
+  }
+}
+
+void ProgressiveRenderer::Start(std::shared_ptr<world> scene, int maxSamples) {
+  Stop();
+  if (!scene) {
+    return;
+  }
+  // No worker touches the scene between Stop() and publishing it below
+  PrepareScene(*scene);
+
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Scene = std::move(scene);
+    m_MaxSamples = maxSamples;
+    m_Moving = false;
+    m_AccumCamera.reset();
+    Restart(ResetMode::Restart);
+  }
+  m_Wake.notify_all();
+}
+
+void ProgressiveRenderer::Stop() {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Paused = true;
+  ++m_Generation;
+  m_Idle.wait(lock, [this] { return m_Active == 0; });
+  m_Scene.reset();
+  m_Paused = false;
+}
+
+void ProgressiveRenderer::Reset(const std::function<void(world &)> &edit,
+                                ResetMode mode) {
+  {
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (!m_Scene) {
+      return;
+    }
+    m_Paused = true;
+    ++m_Generation;
+    m_Idle.wait(lock, [this] { return m_Active == 0; });
+    if (edit) {
+      edit(*m_Scene);
+    }
+    m_Moving = mode == ResetMode::Motion;
+    Restart(mode);
+    m_Paused = false;
+  }
+  m_Wake.notify_all();
+}
+
+void ProgressiveRenderer::SetMaxSamples(int maxSamples) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_MaxSamples = maxSamples;
+  }
+  m_Wake.notify_all();
+}
+
+void ProgressiveRenderer::SetDenoise(bool enabled) {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  if (m_Denoise.load() == enabled) {
+    return;
+  }
+  // Let the tiles in flight finish so the accumulation is consistent
+  m_Paused = true;
+  m_Idle.wait(lock, [this] { return m_Active == 0; });
+  m_Denoise = enabled;
+  if (m_Scene && !m_Moving && m_Samples.load() > 0) {
+    if (enabled) {
+      SnapshotDenoise();
+    } else {
+      // Put the raw average back
+      for (const Tile &tile : m_Tiles) {
+        PublishTile(tile);
+      }
+    }
+  }
+  m_Paused = false;
+  lock.unlock();
+  m_Wake.notify_all();
+}
+
+bool ProgressiveRenderer::IsRunning() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if (!m_Scene) {
+    return false;
+  }
+  if (m_Moving) {
+    return !m_MotionDone;
+  }
+  return m_MaxSamples <= 0 || m_Samples.load() < m_MaxSamples;
+}
+
+bool ProgressiveRenderer::MotionFramePending() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Scene && m_Moving && !m_MotionDone;
+}
+
+bool ProgressiveRenderer::TakeDirty(Rect &rect, int &width, int &height) {
+  std::lock_guard<std::mutex> lock(m_DisplayMutex);
+  if (m_Dirty.Empty()) {
+    return false;
+  }
+  rect = m_Dirty;
+  width = m_DisplayWidth;
+  height = m_DisplayHeight;
+  m_Dirty = Rect();
+  return true;
+}
+
+bool ProgressiveRenderer::ReadDisplay(const Rect &rect, int width, int height,
+                                      uint8_t *dst) const {
+  std::lock_guard<std::mutex> lock(m_DisplayMutex);
+  if (width != m_DisplayWidth || height != m_DisplayHeight) {
+    return false;
+  }
+  const size_t rowBytes = static_cast<size_t>(rect.w) * 4;
+  for (int y = 0; y < rect.h; ++y) {
+    std::memcpy(dst + y * rowBytes,
+                &m_Display[(static_cast<size_t>(rect.y + y) * width + rect.x) *
+                           4],
+                rowBytes);
+  }
+  return true;
+}
+
+void ProgressiveRenderer::AddTiles(int width, int height, Job job) {
+  for (int y = 0; y < height; y += kTileSize) {
+    for (int x = 0; x < width; x += kTileSize) {
+      m_Tiles.push_back({x, y, std::min(kTileSize, width - x),
+                         std::min(kTileSize, height - y), job});
+    }
+  }
+}
+
+void ProgressiveRenderer::Restart(ResetMode mode) {
+  const int oldWidth = m_Width;
+  const int oldHeight = m_Height;
+  m_Width = std::max(1, m_Scene->GetImageWidth());
+  m_Height = std::max(1, m_Scene->GetImageHeight());
+  m_Depth = m_Scene->GetMaxDepth();
+
+  m_Tiles.clear();
+  if (m_Moving) {
+    // Primary hits at full resolution and path-traced samples at reduced
+    // resolution are independent; the upsample runs once both are done
+    m_FrameScale = m_MotionScale.load();
+    m_LowWidth = (m_Width + m_FrameScale - 1) / m_FrameScale;
+    m_LowHeight = (m_Height + m_FrameScale - 1) / m_FrameScale;
+    m_Guides.resize(static_cast<size_t>(m_Width) * m_Height);
+    m_LowColor.resize(static_cast<size_t>(m_LowWidth) * m_LowHeight);
+    AddTiles(m_LowWidth, m_LowHeight, Job::Shade);
+    AddTiles(m_Width, m_Height, Job::Guide);
+    m_MotionDone = false;
+  } else {
+    // Keep the old accumulation as history for the first pass to
+    // reproject, or its primary hits for the first pass to shade
+    const bool sameSize = m_Width == oldWidth && m_Height == oldHeight;
+    m_ReuseHits = mode == ResetMode::Reshade && m_HitsValid && sameSize;
+    m_HasHistory = mode == ResetMode::Reproject && m_AccumCamera && sameSize;
+    if (m_HasHistory) {
+      std::swap(m_HistorySum, m_Accumulation);
+      std::swap(m_HistoryWeights, m_Weights);
+      std::swap(m_HistoryHits, m_AccumHits);
+      m_HistoryCamera = std::move(m_AccumCamera);
+    } else {
+      m_HistoryCamera.reset();
+    }
+    m_AccumCamera = m_Scene->pcamera;
+    m_HitsValid = m_ReuseHits;
+
+    const size_t pixels = static_cast<size_t>(m_Width) * m_Height;
+    m_Accumulation.assign(pixels, color(0, 0, 0));
+    m_Weights.assign(pixels, 0.0f);
+    m_AccumHits.resize(pixels);
+    AddTiles(m_Width, m_Height, Job::Accumulate);
+  }
+  m_NextTile = 0;
+  m_TilesDone = 0;
+  m_Samples = 0;
+  m_PassStart = std::chrono::steady_clock::now();
+
+  // The old image stays up until new tiles cover it, unless the size changed
+  std::lock_guard<std::mutex> lock(m_DisplayMutex);
+  if (m_DisplayWidth != m_Width || m_DisplayHeight != m_Height) {
+    m_Display.assign(static_cast<size_t>(m_Width) * m_Height * 4, 0);
+    m_DisplayWidth = m_Width;
+    m_DisplayHeight = m_Height;
+    m_Dirty = Rect{0, 0, m_Width, m_Height};
+  }
+}
+
+void ProgressiveRenderer::Worker() {
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while (true) {
+    m_Wake.wait(lock, [this] {
+      return m_Quit || (m_DenoisePending && !m_DenoiseBusy) ||
+             (m_Scene && !m_Paused && m_NextTile < m_Tiles.size() &&
+              (m_Moving || m_MaxSamples <= 0 ||
+               m_Samples.load() < m_MaxSamples));
+    });
+    if (m_Quit) {
+      return;
+    }
+    if (m_DenoisePending && !m_DenoiseBusy) {
+      DenoiseSnapshot(lock);
+      continue;
+    }
+
+    const Tile tile = m_Tiles[m_NextTile++];
+    const uint64_t generation = m_Generation.load();
+    // m_Samples only moves once all tiles of the pass in flight are done
+    const bool firstPass = m_Samples.load() == 0;
+    ++m_Active;
+    lock.unlock();
+
+    switch (tile.job) {
+    case Job::Accumulate:
+      if (RenderTile(tile, generation, firstPass)) {
+        PublishTile(tile);
+      }
+      break;
+    case Job::Guide:
+      TraceGuides(tile, generation);
+      break;
+    case Job::Shade:
+      ShadeLowRes(tile, generation);
+      break;
+    case Job::Upsample:
+      Upsample(tile);
+      break;
+    }
+
+    lock.lock();
+    --m_Active;
+    if (generation == m_Generation.load() &&
+        ++m_TilesDone == m_Tiles.size()) {
+      FinishPass();
+    }
+    if (m_Active == 0) {
+      m_Idle.notify_all();
+    }
+  }
+}
+
+bool ProgressiveRenderer::RenderTile(const Tile &tile, uint64_t generation,
+                                     bool firstPass) {
+  // The scene, size and buffers only change while no tile is in flight
+  world &scene = *m_Scene;
+  const camera &cam = *scene.pcamera;
+  for (int yy = tile.y0; yy < tile.y0 + tile.h; ++yy) {
+    if (m_Generation.load(std::memory_order_relaxed) != generation) {
+      return false;
+    }
+    for (int xx = tile.x0; xx < tile.x0 + tile.w; ++xx) {
+      const size_t pixel =
+          static_cast<size_t>(m_Height - 1 - yy) * m_Width + xx;
+      if (firstPass) {
+        // The first sample goes through the pixel centre; its primary hit
+        // is kept for reprojection and shading-only restarts
+        PrimaryHit &hit = m_AccumHits[static_cast<size_t>(yy) * m_Width + xx];
+        ray r;
+        hit_record rec;
+        bool found;
+        if (m_ReuseHits) {
+          found = hit.Load(r, rec);
+          hit.StoreAlbedo(found ? &rec : nullptr);
+        } else {
+          r = CentreRay(cam, xx, yy);
+          found = scene.hit(r, 0.001, INF, rec);
+          hit.Store(r, found ? &rec : nullptr);
+          if (m_HasHistory) {
+            Reproject(hit, m_Accumulation[pixel], m_Weights[pixel]);
+          }
+        }
+        m_Accumulation[pixel] +=
+            ShadePrimary(r, found ? &rec : nullptr, m_Depth, scene);
+      } else {
+        const double u =
+            (xx + random_double()) / static_cast<double>(m_Width - 1);
+        const double v =
+            (yy + random_double()) / static_cast<double>(m_Height - 1);
+        m_Accumulation[pixel] += TraceRay(cam.get_ray(u, v), m_Depth, scene);
+      }
+      m_Weights[pixel] += 1.0f;
+    }
+  }
+  return true;
+}
+
+void ProgressiveRenderer::PublishTile(const Tile &tile) {
+  // Denoised passes replace the whole image once they are filtered
+  if (m_Denoise.load() && m_Samples.load() > 0) {
+    return;
+  }
+
+  // Display rows run top-down, like the accumulation buffer
+  const Rect rect{tile.x0, m_Height - tile.y0 - tile.h, tile.w, tile.h};
+
+  // Convert outside the lock; only the copy is serialized
+  uint8_t texels[kTileSize * kTileSize * 4];
+  uint8_t *out = texels;
+  for (int y = rect.y; y < rect.y + rect.h; ++y) {
+    const size_t row = static_cast<size_t>(y) * m_Width;
+    for (int x = rect.x; x < rect.x + rect.w; ++x) {
+      const color c = m_Accumulation[row + x] / m_Weights[row + x];
+      *out++ = EncodeChannel(c.x());
+      *out++ = EncodeChannel(c.y());
+      *out++ = EncodeChannel(c.z());
+      *out++ = 255;
+    }
+  }
+  WriteDisplay(rect, texels);
+}
+
+void ProgressiveRenderer::WriteDisplay(const Rect &rect,
+                                       const uint8_t *texels) {
+  std::lock_guard<std::mutex> lock(m_DisplayMutex);
+  const size_t rowBytes = static_cast<size_t>(rect.w) * 4;
+  for (int y = 0; y < rect.h; ++y) {
+    std::memcpy(
+        &m_Display[(static_cast<size_t>(rect.y + y) * m_Width + rect.x) * 4],
+        texels + y * rowBytes, rowBytes);
+  }
+  Merge(m_Dirty, rect);
+}
+
+void ProgressiveRenderer::LowResPixel(int i, int j, int &x, int &y) const {
+  x = std::min(i * m_FrameScale + m_FrameScale / 2, m_Width - 1);
+  y = std::min(j * m_FrameScale + m_FrameScale / 2, m_Height - 1);
+}
+
+void ProgressiveRenderer::PrimaryHit::Store(const ray &r,
+                                            const hit_record *rec) {
+  for (int a = 0; a < 3; a++) {
+    dir[a] = static_cast<float>(r.direction()[a]);
+  }
+  StoreAlbedo(rec);
+  if (!rec) {
+    t = -1.0f;
+    return;
+  }
+  for (int a = 0; a < 3; a++) {
+    p[a] = static_cast<float>(rec->p[a]);
+    normal[a] = static_cast<float>(rec->normal[a]);
+  }
+  t = static_cast<float>(rec->t);
+  u = static_cast<float>(rec->u);
+  v = static_cast<float>(rec->v);
+  uvDensity = static_cast<float>(rec->uv_density);
+  frontFace = rec->front_face;
+  object = rec->object;
+  mat = rec->mat_ptr.get();
+  materialSlot = rec->material_slot;
+}
+
+void ProgressiveRenderer::PrimaryHit::StoreAlbedo(const hit_record *rec) {
+  const color guide = rec && rec->mat_ptr ? rec->mat_ptr->guide_albedo(*rec)
+                                          : color(1, 1, 1);
+  for (int a = 0; a < 3; a++) {
+    albedo[a] = static_cast<float>(guide[a]);
+  }
+}
+
+bool ProgressiveRenderer::PrimaryHit::Load(ray &r, hit_record &rec) const {
+  const vec3 d(dir[0], dir[1], dir[2]);
+  if (t < 0.0f) {
+    r = ray(point3(0, 0, 0), d);
+    return false;
+  }
+  rec.p = point3(p[0], p[1], p[2]);
+  rec.normal = vec3(normal[0], normal[1], normal[2]);
+  rec.t = t;
+  rec.u = u;
+  rec.v = v;
+  rec.uv_density = uvDensity;
+  rec.front_face = frontFace;
+  rec.object = object;
+  // Non-owning: the scene keeps its materials alive, and skipping the
+  // reference count keeps workers from contending on shared materials
+  rec.mat_ptr = shared_ptr<material>(shared_ptr<material>(), mat);
+  rec.material_slot = materialSlot;
+  r = ray(rec.p - t * d, d);
+  return true;
+}
+
+float ProgressiveRenderer::PrimaryHit::Depth() const {
+  return t * std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+}
+
+ray ProgressiveRenderer::CentreRay(const camera &cam, int xx, int yy) const {
+  return cam.get_ray((xx + 0.5) / static_cast<double>(m_Width - 1),
+                     (yy + 0.5) / static_cast<double>(m_Height - 1));
+}
+
+void ProgressiveRenderer::TraceGuide(world &scene, int xx, int yy,
+                                     GuideTexel &g) const {
+  // Pixel centres, so low-resolution samples see exactly these hits
+  const ray r = CentreRay(*scene.pcamera, xx, yy);
+  hit_record rec;
+  if (!scene.hit(r, 0.001, INF, rec)) {
+    g = GuideTexel{-1.0f, {0, 0, 0}, {1, 1, 1}};
+    return;
+  }
+  const color albedo =
+      rec.mat_ptr ? rec.mat_ptr->guide_albedo(rec) : color(1, 1, 1);
+  g.depth = static_cast<float>(rec.t * r.direction().length());
+  for (int a = 0; a < 3; a++) {
+    g.normal[a] = static_cast<float>(rec.normal[a]);
+    g.albedo[a] = static_cast<float>(albedo[a]);
+  }
+}
+
+void ProgressiveRenderer::Reproject(const PrimaryHit &hit, color &sum,
+                                    float &weight) const {
+  if (hit.t < 0.0f) {
+    return; // Sky is cheap to resample and has no position to project
+  }
+  const point3 p(hit.p[0], hit.p[1], hit.p[2]);
+  double s, t;
+  if (!m_HistoryCamera->project(p, s, t)) {
+    return;
+  }
+  // Old guides were traced through pixel centres: invert that mapping
+  const double x = s * (m_Width - 1) - 0.5;
+  const double y = t * (m_Height - 1) - 0.5;
+  const int x0 = static_cast<int>(std::floor(x));
+  const int y0 = static_cast<int>(std::floor(y));
+  const float fx = static_cast<float>(x - x0);
+  const float fy = static_cast<float>(y - y0);
+  const float expected =
+      static_cast<float>((p - m_HistoryCamera->LOOK_FROM).length());
+
+  // Bilinear over the old pixels that saw the same surface
+  color average(0, 0, 0);
+  float tapSum = 0.0f;
+  float history = 0.0f;
+  for (int dy = 0; dy < 2; dy++) {
+    for (int dx = 0; dx < 2; dx++) {
+      const int ox = x0 + dx;
+      const int oy = y0 + dy;
+      if (ox < 0 || oy < 0 || ox >= m_Width || oy >= m_Height) {
+        continue;
+      }
+      const PrimaryHit &h =
+          m_HistoryHits[static_cast<size_t>(oy) * m_Width + ox];
+      if (h.t < 0.0f ||
+          std::abs(h.Depth() - expected) > kReprojectDepth * expected ||
+          hit.normal[0] * h.normal[0] + hit.normal[1] * h.normal[1] +
+                  hit.normal[2] * h.normal[2] <
+              kReprojectNormal) {
+        continue; // Disoccluded, or a different surface
+      }
+      const size_t old = static_cast<size_t>(m_Height - 1 - oy) * m_Width + ox;
+      if (m_HistoryWeights[old] <= 0.0f) {
+        continue; // Never sampled (interrupted pass)
+      }
+      const float tap = (dx ? fx : 1.0f - fx) * (dy ? fy : 1.0f - fy);
+      average += tap * (m_HistorySum[old] / m_HistoryWeights[old]);
+      history += tap * m_HistoryWeights[old];
+      tapSum += tap;
+    }
+  }
+  if (tapSum <= 0.0f) {
+    return;
+  }
+  // Partial footprints (edges) carry proportionally less history
+  history = std::min(history, kMaxHistory * tapSum);
+  sum = average / tapSum * history;
+  weight = history;
+}
+
+void ProgressiveRenderer::TraceGuides(const Tile &tile, uint64_t generation) {
+  world &scene = *m_Scene;
+  for (int yy = tile.y0; yy < tile.y0 + tile.h; ++yy) {
+    if (m_Generation.load(std::memory_order_relaxed) != generation) {
+      return;
+    }
+    for (int xx = tile.x0; xx < tile.x0 + tile.w; ++xx) {
+      TraceGuide(scene, xx, yy,
+                 m_Guides[static_cast<size_t>(yy) * m_Width + xx]);
+    }
+  }
+}
+
+void ProgressiveRenderer::ShadeLowRes(const Tile &tile, uint64_t generation) {
+  world &scene = *m_Scene;
+  const camera &cam = *scene.pcamera;
+  for (int j = tile.y0; j < tile.y0 + tile.h; ++j) {
+    if (m_Generation.load(std::memory_order_relaxed) != generation) {
+      return;
+    }
+    for (int i = tile.x0; i < tile.x0 + tile.w; ++i) {
+      int xx, yy;
+      LowResPixel(i, j, xx, yy);
+      const ray r = cam.get_ray((xx + 0.5) / static_cast<double>(m_Width - 1),
+                                (yy + 0.5) / static_cast<double>(m_Height - 1));
+      m_LowColor[static_cast<size_t>(j) * m_LowWidth + i] =
+          TraceRay(r, m_Depth, scene);
+    }
+  }
+}
+
+void ProgressiveRenderer::Upsample(const Tile &tile) {
+  const int s = m_FrameScale;
+  const float invScale = 1.0f / s;
+  const Rect rect{tile.x0, m_Height - tile.y0 - tile.h, tile.w, tile.h};
+  uint8_t texels[kTileSize * kTileSize * 4];
+  uint8_t *out = texels;
+
+  // Display rows run top-down, so walk yy downwards
+  for (int yy = tile.y0 + tile.h - 1; yy >= tile.y0; --yy) {
+    for (int xx = tile.x0; xx < tile.x0 + tile.w; ++xx) {
+      const GuideTexel &g = m_Guides[static_cast<size_t>(yy) * m_Width + xx];
+      const int ci = std::min(xx / s, m_LowWidth - 1);
+      const int cj = std::min(yy / s, m_LowHeight - 1);
+
+      // Albedo-demodulated samples from the 3x3 low-resolution
+      // neighbourhood, weighted by distance and G-buffer similarity
+      float sum[3] = {0, 0, 0};
+      float weightSum = 0.0f;
+      for (int j = std::max(cj - 1, 0); j <= std::min(cj + 1, m_LowHeight - 1);
+           ++j) {
+        for (int i = std::max(ci - 1, 0);
+             i <= std::min(ci + 1, m_LowWidth - 1); ++i) {
+          int qx, qy;
+          LowResPixel(i, j, qx, qy);
+          const GuideTexel &q =
+              m_Guides[static_cast<size_t>(qy) * m_Width + qx];
+
+          const float dx = (xx - qx) * invScale;
+          const float dy = (yy - qy) * invScale;
+          float w = std::exp(-0.5f * (dx * dx + dy * dy));
+          if ((g.depth < 0.0f) != (q.depth < 0.0f)) {
+            continue; // Sky against geometry
+          }
+          if (g.depth >= 0.0f) {
+            w *= std::exp(-std::abs(g.depth - q.depth) /
+                          (kDepthSigma * g.depth + 1e-4f));
+            const float cosine = g.normal[0] * q.normal[0] +
+                                 g.normal[1] * q.normal[1] +
+                                 g.normal[2] * q.normal[2];
+            if (cosine <= 0.0f) {
+              continue;
+            }
+            float lobe = cosine;
+            for (int k = 1; k < kNormalPower; k *= 2) {
+              lobe *= lobe;
+            }
+            w *= lobe;
+          }
+
+          const color &c = m_LowColor[static_cast<size_t>(j) * m_LowWidth + i];
+          for (int a = 0; a < 3; a++) {
+            sum[a] += w * static_cast<float>(c[a]) /
+                      std::max(q.albedo[a], kMinAlbedo);
+          }
+          weightSum += w;
+        }
+      }
+
+      color result;
+      if (weightSum > 1e-6f) {
+        result = color(sum[0] / weightSum * std::max(g.albedo[0], kMinAlbedo),
+                       sum[1] / weightSum * std::max(g.albedo[1], kMinAlbedo),
+                       sum[2] / weightSum * std::max(g.albedo[2], kMinAlbedo));
+      } else {
+        // Nothing similar nearby (thin features): nearest sample
+        result = m_LowColor[static_cast<size_t>(cj) * m_LowWidth + ci];
+      }
+      *out++ = EncodeChannel(result.x());
+      *out++ = EncodeChannel(result.y());
+      *out++ = EncodeChannel(result.z());
+      *out++ = 255;
+    }
+  }
+  WriteDisplay(rect, texels);
+}
+
+void ProgressiveRenderer::SnapshotDenoise() {
+  DenoiseFrame &frame = m_DenoiseSnapshot;
+  const size_t pixels = static_cast<size_t>(m_Width) * m_Height;
+  frame.rgb.resize(pixels * 3);
+  frame.albedo.resize(pixels * 3);
+  frame.normal.resize(pixels * 3);
+  frame.depth.resize(pixels);
+  frame.width = m_Width;
+  frame.height = m_Height;
+  frame.generation = m_Generation.load();
+  if (m_Scene && m_Scene->pconfig) {
+    frame.iterations = m_Scene->pconfig->denoiseIterations;
+  }
+
+  for (int y = 0; y < m_Height; ++y) {
+    // Primary hits run bottom-up
+    const PrimaryHit *hits =
+        &m_AccumHits[static_cast<size_t>(m_Height - 1 - y) * m_Width];
+    for (int x = 0; x < m_Width; ++x) {
+      const size_t i = static_cast<size_t>(y) * m_Width + x;
+      const color c = m_Weights[i] > 0.0f ? m_Accumulation[i] / m_Weights[i]
+                                          : color(0, 0, 0);
+      const PrimaryHit &hit = hits[x];
+      const bool found = hit.t >= 0.0f;
+      for (int a = 0; a < 3; a++) {
+        frame.rgb[i * 3 + a] = static_cast<float>(c[a]);
+        frame.albedo[i * 3 + a] = hit.albedo[a];
+        frame.normal[i * 3 + a] = found ? hit.normal[a] : 0.0f;
+      }
+      frame.depth[i] = found ? hit.Depth() : 0.0f;
+    }
+  }
+  m_DenoisePending = true;
+}
+
+void ProgressiveRenderer::DenoiseSnapshot(std::unique_lock<std::mutex> &lock) {
+  m_DenoisePending = false;
+  m_DenoiseBusy = true;
+  std::swap(m_DenoiseSnapshot, m_DenoiseWork);
+  lock.unlock();
+
+  const auto start = std::chrono::steady_clock::now();
+  DenoiseFrame &frame = m_DenoiseWork;
+  denoiser::atrous_settings settings;
+  settings.iterations = frame.iterations;
+  settings.threads = static_cast<unsigned int>(m_Workers.size());
+  denoiser::atrous_filter(frame.rgb.data(), frame.albedo.data(),
+                          frame.normal.data(), frame.depth.data(), frame.width,
+                          frame.height, settings);
+  m_LastDenoiseMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  PublishDenoised(frame);
+
+  lock.lock();
+  m_DenoiseBusy = false;
+}
+
+void ProgressiveRenderer::PublishDenoised(const DenoiseFrame &frame) {
+  std::vector<uint8_t> texels(static_cast<size_t>(frame.width) *
+                              frame.height * 4);
+  for (size_t i = 0; i < texels.size() / 4; i++) {
+    for (int a = 0; a < 3; a++) {
+      texels[i * 4 + a] = EncodeChannel(frame.rgb[i * 3 + a]);
+    }
+    texels[i * 4 + 3] = 255;
+  }
+
+  // Resets bump the generation before they touch the display
+  std::lock_guard<std::mutex> lock(m_DisplayMutex);
+  if (!m_Denoise.load() || frame.generation != m_Generation.load() ||
+      frame.width != m_DisplayWidth || frame.height != m_DisplayHeight) {
+    return;
+  }
+  std::memcpy(m_Display.data(), texels.data(), texels.size());
+  Merge(m_Dirty, Rect{0, 0, frame.width, frame.height});
+}
+
+void ProgressiveRenderer::FinishPass() {
+  const auto now = std::chrono::steady_clock::now();
+  const double ms =
+      std::chrono::duration<double, std::milli>(now - m_PassStart).count();
+  m_NextTile = 0;
+  m_TilesDone = 0;
+
+  if (!m_Moving) {
+    m_LastPassMs = ms;
+    m_PassStart = now;
+    ++m_Samples;
+    m_HitsValid = true;
+    if (m_Denoise.load()) {
+      SnapshotDenoise();
+    }
+  } else if (m_Tiles.front().job != Job::Upsample) {
+    m_Tiles.clear();
+    AddTiles(m_Width, m_Height, Job::Upsample);
+  } else {
+    // Frame done; pick the resolution of the next one
+    m_LastPassMs = ms;
+    m_Tiles.clear();
+    m_MotionDone = true;
+    if (ms > kSlowMotionFrameMs && m_FrameScale < 8) {
+      m_MotionScale = 8;
+    } else if (ms < kFastMotionFrameMs && m_FrameScale > 4) {
+      m_MotionScale = 4;
+    }
+  }
+  m_Wake.notify_all();
+}
+
+} // namespace render
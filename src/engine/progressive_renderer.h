@@ -0,0 +1,279 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/vec3.h"
+
+class camera;
+class hittable;
+class material;
+class ray;
+class world;
+struct hit_record;
+
+namespace render {
+
+/**
+ * @brief Background progressive renderer for interactive previews
+ *
+ * A pool of worker threads renders full-frame passes of one sample per
+ * pixel, tile by tile, into an accumulation buffer. As each tile finishes,
+ * its worker converts the tile's running average to display RGBA8 and
+ * marks it dirty; the caller copies only the dirty region with
+ * TakeDirty()/ReadDisplay(), so it neither traces rays nor converts
+ * pixels.
+ *
+ * Scene changes go through Reset(): it stops the workers at the next row,
+ * runs the edit while no worker touches the world, clears the
+ * accumulation and restarts from the first pass.
+ *
+ * The first pass also records each pixel's primary hit. When only the
+ * camera changed (ResetMode::Reproject), the first pass of the new view
+ * projects every primary hit into the previous camera, fetches the old
+ * average where the old primary hits agree in depth and normal (rejecting
+ * disocclusions) and seeds the pixel with it as a capped number of
+ * samples. Small camera moves keep most of the converged image, and new
+ * samples gradually replace the reprojected ones.
+ *
+ * Those primary hits are cached in full (surface, material, texture
+ * coordinates). After a lighting or material edit that leaves the camera
+ * and geometry alone (ResetMode::Reshade), the first pass shades the
+ * cached hits instead of tracing primary rays.
+ *
+ * While the camera moves, ResetMode::Motion renders a single motion frame
+ * instead: path-traced at 1/4 or 1/8 resolution, then upsampled with a
+ * joint bilateral filter guided by a full-resolution G-buffer of primary
+ * hits (depth, normal, albedo). The divisor adapts to the time the last
+ * motion frame took.
+ *
+ * With SetDenoise(), every finished pass after the first is shown through
+ * the a-trous denoiser instead, guided by the cached primary hits. The
+ * worker that finishes a pass copies the average into a snapshot; one
+ * worker at a time filters the latest snapshot while the others carry on
+ * with the next pass.
+ */
+class ProgressiveRenderer {
+public:
+  // Region of the display image; row 0 is the top of the image
+  struct Rect {
+    int x = 0, y = 0, w = 0, h = 0;
+    bool Empty() const { return w <= 0 || h <= 0; }
+  };
+
+  enum class ResetMode {
+    Restart,   // Discard the accumulated image
+    Reproject, // Only the camera changed: seed the new view from the old one
+    Reshade,   // Only lighting or material parameters changed (same objects)
+    Motion,    // Render one reduced-resolution motion frame
+  };
+
+  // threads == 0 uses all cores but one, leaving one to the UI
+  explicit ProgressiveRenderer(unsigned int threads = 0);
+  ~ProgressiveRenderer();
+
+  ProgressiveRenderer(const ProgressiveRenderer &) = delete;
+  ProgressiveRenderer &operator=(const ProgressiveRenderer &) = delete;
+
+  /**
+   * @brief Start accumulating `scene` (image size and depth from its config)
+   * @param maxSamples Passes to accumulate before idling, 0 for no limit
+   */
+  void Start(std::shared_ptr<world> scene, int maxSamples = 0);
+
+  // Cancel the current pass and release the scene
+  void Stop();
+
+  /**
+   * @brief Apply `edit` to the scene with the workers paused, then restart
+   *        (also picks up a new image size)
+   * @param mode Reproject only keeps history if the image size is unchanged;
+   *        a motion frame leaves the accumulated image (and its history)
+   *        alone
+   */
+  void Reset(const std::function<void(world &)> &edit = {},
+             ResetMode mode = ResetMode::Restart);
+
+  void SetMaxSamples(int maxSamples);
+
+  // Show finished passes denoised (the first pass is shown as it renders)
+  void SetDenoise(bool enabled);
+
+  /**
+   * @brief Take the region that changed since the last call, with the size
+   *        of the display image it refers to
+   * @return false when nothing changed
+   */
+  bool TakeDirty(Rect &rect, int &width, int &height);
+
+  /**
+   * @brief Copy the RGBA8 texels of `rect` as tightly packed rows
+   * @return false when the display was resized since TakeDirty()
+   */
+  bool ReadDisplay(const Rect &rect, int width, int height,
+                   uint8_t *dst) const;
+
+  int Samples() const { return m_Samples.load(); }
+  double LastPassMs() const { return m_LastPassMs.load(); }
+  double LastDenoiseMs() const { return m_LastDenoiseMs.load(); }
+  bool IsRunning() const;
+
+  // True while a motion frame is still being rendered
+  bool MotionFramePending() const;
+  int MotionScale() const { return m_MotionScale.load(); }
+
+private:
+  enum class Job { Accumulate, Guide, Shade, Upsample };
+
+  struct Tile {
+    int x0, y0, w, h;
+    Job job;
+  };
+
+  // Primary hit of a full-resolution pixel; depth < 0 for a miss
+  struct GuideTexel {
+    float depth;
+    float normal[3];
+    float albedo[3];
+  };
+
+  // Primary hit through a pixel centre, compact enough to keep per pixel;
+  // t < 0 for a miss
+  struct PrimaryHit {
+    float p[3];
+    float normal[3];
+    float dir[3]; // Ray direction as traced (not normalized)
+    float t;
+    float u, v;
+    float uvDensity;
+    bool frontFace;
+    const hittable *object;
+    material *mat;
+    int materialSlot;
+    float albedo[3]; // Denoiser guide; white for a miss
+
+    void Store(const ray &r, const hit_record *rec);
+    // Refresh the albedo after a material edit
+    void StoreAlbedo(const hit_record *rec);
+    // Rebuild the ray and the hit; false for a miss
+    bool Load(ray &r, hit_record &rec) const;
+    float Depth() const;
+  };
+
+  void Worker();
+  // False when a reset interrupted the tile
+  bool RenderTile(const Tile &tile, uint64_t generation, bool firstPass);
+  void PublishTile(const Tile &tile);
+  void WriteDisplay(const Rect &rect, const uint8_t *texels);
+
+  // Ray through the centre of full-resolution pixel (xx, yy)
+  ray CentreRay(const camera &cam, int xx, int yy) const;
+  void TraceGuide(world &scene, int xx, int yy, GuideTexel &g) const;
+  // Seed a pixel of the new view from the previous accumulation
+  void Reproject(const PrimaryHit &hit, color &sum, float &weight) const;
+
+  // Motion frame jobs
+  void TraceGuides(const Tile &tile, uint64_t generation);
+  void ShadeLowRes(const Tile &tile, uint64_t generation);
+  void Upsample(const Tile &tile);
+  // Full-resolution pixel a low-resolution sample is traced through
+  void LowResPixel(int i, int j, int &x, int &y) const;
+
+  // Average and guides of a finished pass, top-down, for the denoiser
+  struct DenoiseFrame {
+    std::vector<float> rgb, albedo, normal, depth;
+    int width = 0, height = 0;
+    int iterations = 5;
+    uint64_t generation = 0;
+  };
+
+  // Called with m_Mutex held and no tile in flight
+  void SnapshotDenoise();
+  // Filter the pending snapshot; `lock` holds m_Mutex and is released
+  // while filtering
+  void DenoiseSnapshot(std::unique_lock<std::mutex> &lock);
+  // Show a filtered frame unless the image was reset since its snapshot
+  void PublishDenoised(const DenoiseFrame &frame);
+
+  void AddTiles(int width, int height, Job job);
+  void FinishPass(); // Called with m_Mutex held
+  // Called with m_Mutex held and no active workers
+  void Restart(ResetMode mode);
+
+  std::vector<std::thread> m_Workers;
+
+  mutable std::mutex m_Mutex;
+  std::condition_variable m_Wake; // Work or a snapshot available, or quitting
+  std::condition_variable m_Idle; // Last active worker left a tile
+  std::shared_ptr<world> m_Scene;
+  bool m_Quit{false};
+  bool m_Paused{false};
+  bool m_Moving{false};
+  bool m_MotionDone{false};
+  int m_Active{0};
+  int m_MaxSamples{0};
+  int m_Width{0};
+  int m_Height{0};
+  int m_Depth{0};
+  std::vector<Tile> m_Tiles;
+  size_t m_NextTile{0};
+  size_t m_TilesDone{0};
+  std::chrono::steady_clock::time_point m_PassStart;
+  // Bumped on every reset so workers drop tiles of a stale pass
+  std::atomic<uint64_t> m_Generation{0};
+
+  // Per pixel, top-down: sum of all samples (including reprojected ones)
+  // and how many samples the sum stands for
+  std::vector<color> m_Accumulation;
+  std::vector<float> m_Weights;
+  // Primary hits of the accumulated view (bottom-up) and its camera; the
+  // hits are complete once the first pass is
+  std::vector<PrimaryHit> m_AccumHits;
+  std::shared_ptr<const camera> m_AccumCamera;
+  bool m_HitsValid{false};
+  bool m_ReuseHits{false}; // First pass shades m_AccumHits
+
+  // The previous accumulation, read while the first pass reprojects it
+  std::vector<color> m_HistorySum;
+  std::vector<float> m_HistoryWeights;
+  std::vector<PrimaryHit> m_HistoryHits;
+  std::shared_ptr<const camera> m_HistoryCamera;
+  bool m_HasHistory{false};
+
+  // Motion frame buffers; rows run bottom-up like the tile coordinates
+  std::vector<GuideTexel> m_Guides; // m_Width * m_Height
+  std::vector<color> m_LowColor;    // m_LowWidth * m_LowHeight
+  int m_LowWidth{0};
+  int m_LowHeight{0};
+  int m_FrameScale{4};
+  std::atomic<int> m_MotionScale{4};
+
+  // Denoised display. The snapshot is guarded by m_Mutex; m_DenoiseWork
+  // belongs to the worker that set m_DenoiseBusy.
+  std::atomic<bool> m_Denoise{false};
+  bool m_DenoisePending{false};
+  bool m_DenoiseBusy{false};
+  DenoiseFrame m_DenoiseSnapshot;
+  DenoiseFrame m_DenoiseWork;
+
+  // Display image (gamma-encoded RGBA8) and its dirty region, guarded by
+  // m_DisplayMutex
+  mutable std::mutex m_DisplayMutex;
+  std::vector<uint8_t> m_Display;
+  int m_DisplayWidth{0};
+  int m_DisplayHeight{0};
+  Rect m_Dirty;
+
+  std::atomic<int> m_Samples{0};
+  std::atomic<double> m_LastPassMs{0.0};
+  std::atomic<double> m_LastDenoiseMs{0.0};
+};
+
+} // namespace render
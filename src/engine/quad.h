@@ -77,7 +77,10 @@ public:
     rec.t = t;
     rec.p = intersection;
     rec.mat_ptr = mat;
+    rec.material_slot = material_slot;
+    rec.object = this;
     rec.set_face_normal(r, normal);
+    rec.uv_density = 1.0 / std::sqrt(area()); // UV square spans the quad
 
     return true;
   }
@@ -96,10 +99,38 @@ public:
     return true;
   }
 
+  double area() const { return cross(u, v).length(); }
+
+  /**
+   * @brief Solid-angle pdf for sampling this quad as an area light
+   */
+  virtual double pdf_value(const point3 &origin,
+                           const vec3 &direction) const override {
+    hit_record rec;
+    if (!this->hit(ray(origin, direction), 0.001, INF, rec))
+      return 0;
+
+    auto distance_squared = rec.t * rec.t * direction.length_squared();
+    auto cosine = fabs(dot(direction, rec.normal) / direction.length());
+    if (cosine < 1e-8)
+      return 0;
+
+    return distance_squared / (cosine * area());
+  }
+
+  /**
+   * @brief Direction from origin to a uniformly sampled point on the quad
+   */
+  virtual vec3 random(const point3 &origin) const override {
+    auto p = Q + (random_double() * u) + (random_double() * v);
+    return p - origin;
+  }
+
 public:
   point3 Q;  // Corner point
   vec3 u, v; // Edge vectors
   shared_ptr<material> mat;
+  int material_slot = -1; // Assigned by world::buildMaterialTable()
   aabb bbox;
   vec3 normal; // Unit normal
   double D;    // Distance from origin to plane
@@ -11,10 +11,12 @@
 
 #include "engine/camera.h"
 #include "engine/config.h"
+#include "engine/denoiser.h"
 #include "engine/hdri_environment.h"
 #include "engine/material.h"
 #include "engine/mis.h"
 #include "engine/oidn_denoiser.h"
+#include "engine/pdf.h"
 #include "engine/point_light.h"
 #include "engine/sun.h"
 #include "engine/world.h"
@@ -31,113 +33,304 @@ struct Tile {
   int h;
 };
 
-color TraceRayInternal(const ray &r, int depth, world &sceneWorld) {
-  hit_record rec;
+// Shading point a ray was scattered from. Recorded when lights could have
+// been sampled directly there, so emission found by the scattered ray can be
+// MIS-weighted against light sampling.
+struct PathVertex {
+  point3 p;
+  vec3 normal;     // Normal used for light selection (zero inside media)
+  double bsdf_pdf; // Solid-angle pdf of the scattered direction
+};
 
-  if (depth <= 0) {
+// Ray cone carried along a path ("Texture Level of Detail Strategies for
+// Real-Time Ray Tracing", Akenine-Moller et al.): world-space width at the
+// ray origin and spread angle. Its width at a hit, converted to UV units,
+// selects the texture mip level.
+struct RayCone {
+  double width = 0.0;
+  double spread = 0.0;
+};
+
+// Extra spread added by a non-delta bounce, scaled down for narrow
+// (high-pdf) glossy lobes
+constexpr double kRoughBounceSpread = 0.2;
+
+// Cone of a primary ray: one pixel's angle
+RayCone PrimaryCone(world &sceneWorld) {
+  RayCone cone;
+  const int height = sceneWorld.GetImageHeight();
+  if (sceneWorld.pcamera && height > 0) {
+    cone.spread =
+        2.0 * tan(degrees_to_radians(sceneWorld.pcamera->FOV) / 2.0) / height;
+  }
+  return cone;
+}
+
+// Shading context for next event estimation at a non-delta hit
+struct ShadingPoint {
+  const hit_record &rec;
+  vec3 wo;         // Direction towards the viewer
+  vec3 normal;     // Normal used for light selection (zero inside media)
+  point3 origin;   // Shadow ray origin
+  // Set when the material has no eval() (scatter() fallback): point lights
+  // are then shaded as if the surface were diffuse with this albedo
+  const color *diffuseFallback = nullptr;
+};
+
+// Direct lighting from one emissive primitive (area light), MIS-weighted
+// against BSDF sampling
+color SampleEmitter(const scene_light &light, double lightPmf,
+                    const ShadingPoint &sp, world &sceneWorld) {
+  const hittable_pdf lightPdf(light.emitter, sp.origin);
+  const vec3 toLight = lightPdf.generate();
+  const vec3 wi = unit_vector(toLight);
+  const material_table &materials = sceneWorld.materialTable;
+  const color f = materials.eval(sp.rec, sp.wo, wi);
+  if (f.x() <= 0.0 && f.y() <= 0.0 && f.z() <= 0.0) {
     return color(0, 0, 0);
   }
 
-  if (sceneWorld.hit(r, 0.001, INF, rec)) {
-    ray scattered;
-    color attenuation;
-    color result;
-
-    // Get emission from material (non-zero for emissive materials)
-    color emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
-
-    if (rec.mat_ptr->scatter(r, rec, attenuation, scattered)) {
-      // Russian Roulette path termination after first few bounces
-      // Probabilistically terminate paths with low contribution while
-      // maintaining unbiased results
-      int max_depth = sceneWorld.GetMaxDepth();
-      if (depth < max_depth - 3) { // Only apply after first 3 bounces
-        double luminance = 0.2126 * attenuation.x() + 0.7152 * attenuation.y() +
-                           0.0722 * attenuation.z();
-        double continue_prob = std::min(0.95, std::max(0.1, luminance));
-        if (random_double() > continue_prob) {
-          return emitted; // Terminate path, return emission only
-        }
+  const double pdfSolid = lightPdf.value(toLight);
+  if (pdfSolid <= 0.0) {
+    return color(0, 0, 0);
+  }
+
+  // The light is visible if it is the first thing the shadow ray hits
+  hit_record lightRec;
+  if (!sceneWorld.hit(ray(sp.origin, toLight), 0.001, INF, lightRec) ||
+      lightRec.object != light.surface) {
+    return color(0, 0, 0);
+  }
+
+  const color Le = materials.emitted(lightRec);
+  const double pdfLight = lightPmf * pdfSolid;
+  const double pdfBsdf = materials.pdf(sp.rec, sp.wo, wi);
+  const double misWeight = mis::power_heuristic(pdfLight, pdfBsdf);
+
+  return Le * f * (misWeight / pdfLight);
+}
+
+// Direct lighting from the HDRI environment, importance-sampled by
+// luminance and MIS-weighted against BSDF sampling
+color SampleEnvironment(const ShadingPoint &sp, world &sceneWorld) {
+  const hdri_environment &env = *sceneWorld.hdri;
+  double pdfEnv = 0.0;
+  const vec3 wi =
+      env.sample_direction(random_double(), random_double(), pdfEnv);
+  if (pdfEnv <= 0.0) {
+    return color(0, 0, 0);
+  }
+  const material_table &materials = sceneWorld.materialTable;
+  const color f = materials.eval(sp.rec, sp.wo, wi);
+  if (f.x() <= 0.0 && f.y() <= 0.0 && f.z() <= 0.0) {
+    return color(0, 0, 0);
+  }
+
+  // The environment is visible only if nothing blocks the direction
+  hit_record shadowRec;
+  if (sceneWorld.hit(ray(sp.origin, wi), 0.001, INF, shadowRec)) {
+    return color(0, 0, 0);
+  }
+
+  const double pdfBsdf = materials.pdf(sp.rec, sp.wo, wi);
+  const double misWeight = mis::power_heuristic(pdfEnv, pdfBsdf);
+
+  return env.sample(wi) * f * (misWeight / pdfEnv);
+}
+
+// Direct lighting from a point light. Point lights are delta lights that
+// BSDF sampling can never hit, so no MIS weight is needed.
+color SamplePointLight(const PointLight &light, double lightPmf,
+                       const ShadingPoint &sp, world &sceneWorld) {
+  vec3 toLight = light.position - sp.origin;
+  double lightDist = toLight.length();
+  vec3 lightDir = toLight / lightDist;
+
+  color f;
+  if (sp.diffuseFallback) {
+    const double cosine = dot(sp.rec.normal, lightDir);
+    f = cosine > 0.0 ? *sp.diffuseFallback * (cosine / M_PI) : color(0, 0, 0);
+  } else {
+    f = sceneWorld.materialTable.eval(sp.rec, sp.wo, lightDir);
+  }
+  if (f.x() <= 0.0 && f.y() <= 0.0 && f.z() <= 0.0) {
+    return color(0, 0, 0);
+  }
+
+  // Check if light is visible (shadow ray)
+  hit_record lightShadowRec;
+  if (sceneWorld.hit(ray(sp.origin, lightDir), 0.001, lightDist - 0.001,
+                     lightShadowRec)) {
+    return color(0, 0, 0);
+  }
+
+  // Light attenuation (inverse square law), divided by the probability of
+  // having picked this light
+  double light_attenuation = light.intensity / (lightDist * lightDist);
+  return light.lightColor * f * (light_attenuation / lightPmf);
+}
+
+color TraceRayInternal(const ray &r, int depth, world &sceneWorld,
+                       const RayCone &cone, const PathVertex *prev = nullptr);
+
+// Radiance arriving along `r` from its first hit `rec`
+color ShadeHit(const ray &r, hit_record &rec, int depth, world &sceneWorld,
+               const RayCone &cone, const PathVertex *prev) {
+  ray scattered;
+  color attenuation;
+  color result;
+
+  // Texture footprint from the cone width at the hit, widened at grazing
+  // angles
+  const double distance = rec.t * r.direction().length();
+  RayCone next{cone.width + cone.spread * distance, cone.spread};
+  if (rec.uv_density > 0.0) {
+    const double cosine = fabs(dot(unit_vector(r.direction()), rec.normal));
+    rec.footprint = next.width * rec.uv_density / std::max(cosine, 0.125);
+  }
+
+  // Get emission from material (non-zero for emissive materials)
+  const material_table &materials = sceneWorld.materialTable;
+  color emitted = materials.emitted(rec);
+
+  // If the previous bounce could also have reached this emitter through
+  // light sampling, weight the BSDF-sampled emission with MIS
+  if (prev && (emitted.x() > 0.0 || emitted.y() > 0.0 || emitted.z() > 0.0)) {
+    const int lightIndex = sceneWorld.lightIndexOf(rec.object);
+    if (lightIndex >= 0) {
+      const hittable_pdf lightPdf(sceneWorld.lights[lightIndex].emitter,
+                                  r.origin());
+      const double pdfLight =
+          sceneWorld.lightPmf(prev->p, prev->normal, lightIndex) *
+          lightPdf.value(r.direction());
+      emitted = emitted * mis::power_heuristic(prev->bsdf_pdf, pdfLight);
+    }
+  }
+
+  const vec3 wo = -unit_vector(r.direction());
+  bsdf_sample bs;
+  if (materials.sample(rec, wo, random_double(), random_double(), bs)) {
+    scattered = ray(rec.p, bs.wi, r.time());
+    attenuation = bs.weight;
+    if (!bs.is_delta) {
+      next.spread += kRoughBounceSpread / sqrt(std::max(bs.pdf, 1.0));
+    }
+
+    // Russian Roulette path termination after first few bounces
+    // Probabilistically terminate paths with low contribution while
+    // maintaining unbiased results. Only the indirect ray is dropped; the
+    // direct lighting below is estimated at this vertex either way.
+    bool traceIndirect = true;
+    int max_depth = sceneWorld.GetMaxDepth();
+    if (depth < max_depth - 3) { // Only apply after first 3 bounces
+      double luminance = 0.2126 * attenuation.x() + 0.7152 * attenuation.y() +
+                         0.0722 * attenuation.z();
+      double continue_prob = std::min(0.95, std::max(0.1, luminance));
+      if (random_double() > continue_prob) {
+        traceIndirect = false; // Terminate path after direct lighting
+      } else {
         // Adjust for probability of not terminating
         attenuation = attenuation / continue_prob;
       }
+    }
 
-      result = attenuation * TraceRayInternal(scattered, depth - 1, sceneWorld);
-
-      // Check if the scattered ray is refracted (going through glass)
-      // Refracted rays go opposite to surface normal
-      bool isRefracted = dot(scattered.direction(), rec.normal) < 0;
-
-      if (!isRefracted) {
-        // Apply sun lighting with shadow testing
-        ray shadowRay;
-        shadowRay.dir = sceneWorld.psun->direction;
-        // Offset origin along normal to prevent shadow acne
-        shadowRay.orig = rec.p + rec.normal * 0.001;
-        hit_record shadowRec;
-        if (sceneWorld.hit(shadowRay, 0.001, INF, shadowRec)) {
-          result = result * 0.3; // Softer shadow
-        } else {
-          result = result * sceneWorld.psun->sunColor;
-        }
+    // Check if the scattered ray is refracted (going through glass)
+    // Refracted rays go opposite to surface normal
+    const bool onSurface = materials.is_surface(rec);
+    bool isRefracted = onSurface && dot(scattered.direction(), rec.normal) < 0;
 
-        // Direct sampling of point lights (Next Event Estimation with MIS)
-        for (const auto &light : sceneWorld.pointLights) {
-          vec3 toLight = light->position - rec.p;
-          double lightDist = toLight.length();
-          vec3 lightDir = toLight / lightDist;
-
-          // Check if light is visible (shadow ray)
-          ray lightShadowRay;
-          // Offset origin along normal to prevent shadow acne
-          lightShadowRay.orig = rec.p + rec.normal * 0.001;
-          lightShadowRay.dir = lightDir;
-          hit_record lightShadowRec;
-
-          if (!sceneWorld.hit(lightShadowRay, 0.001, lightDist - 0.001,
-                              lightShadowRec)) {
-            // Light is visible - calculate contribution with MIS
-            double cosTheta = std::max(0.0, dot(rec.normal, lightDir));
-
-            // PDF for light sampling (point light = delta function
-            // approximation) For proper MIS, we use 1/distance^2 as the
-            // effective PDF
-            double pdf_light = 1.0;
-
-            // PDF for BRDF sampling this direction (cosine-weighted for
-            // diffuse)
-            double pdf_brdf = mis::pdf_cosine_hemisphere(lightDir, rec.normal);
-
-            // MIS weight using power heuristic
-            double mis_weight = mis::power_heuristic(pdf_light, pdf_brdf);
-
-            // Light attenuation (inverse square law)
-            double light_attenuation =
-                light->intensity / (lightDist * lightDist);
-
-            // Apply MIS-weighted contribution
-            result = result + light->lightColor * cosTheta * light_attenuation *
-                                  mis_weight;
-          }
-        }
-      }
-      // Glass (refractive) materials - light passes through, no shadow
-      // darkening
-    } else {
-      // Scatter returned false - use emission only
+    // Lights are sampled directly unless the lobe is specular (delta).
+    // Delta lobes of non-specular materials only come from the scatter()
+    // fallback; point lights need no MIS and are still sampled there.
+    const bool sampleLights = !bs.is_delta;
+    const bool samplePointLights =
+        sampleLights || (onSurface && !materials.is_specular(rec));
+    const vec3 lightNormal = onSurface ? rec.normal : vec3(0, 0, 0);
+
+    if (!traceIndirect) {
       result = color(0, 0, 0);
+    } else if (sampleLights) {
+      PathVertex vertex{rec.p, lightNormal, bs.pdf};
+      result = attenuation * TraceRayInternal(scattered, depth - 1, sceneWorld,
+                                              next, &vertex);
+    } else {
+      result = attenuation *
+               TraceRayInternal(scattered, depth - 1, sceneWorld, next);
     }
 
-    // Add emission to result
-    return emitted + result;
+    if (!isRefracted) {
+      // Offset origin along normal to prevent shadow acne
+      const ShadingPoint sp{rec, wo, lightNormal,
+                            onSurface ? rec.p + rec.normal * 0.001 : rec.p,
+                            sampleLights ? nullptr : &bs.weight};
+
+      // Next Event Estimation: pick a single light (point light or
+      // emissive primitive) so the number of shadow rays per bounce is
+      // independent of light count
+      int lightIndex = -1;
+      double lightPmf = 0.0;
+      const scene_light *picked = nullptr;
+      if (samplePointLights && sceneWorld.sampleLight(rec.p, lightNormal,
+                                                 random_double(), lightIndex,
+                                                 lightPmf)) {
+        picked = &sceneWorld.lights[lightIndex];
+      }
+
+      // Emissive primitives can also be reached by the scattered ray, so
+      // their direct contribution goes through the same sun term below
+      if (sampleLights && picked && picked->emitter) {
+        result = result + SampleEmitter(*picked, lightPmf, sp, sceneWorld);
+      }
+
+      // Importance-sampled HDRI environment (weighted against the
+      // escaping BSDF ray in ShadeMiss)
+      if (sampleLights && sceneWorld.hdri && sceneWorld.hdri->is_valid() &&
+          sceneWorld.hdri->has_distribution()) {
+        result = result + SampleEnvironment(sp, sceneWorld);
+      }
+
+      // Apply sun lighting with shadow testing
+      ray shadowRay;
+      shadowRay.dir = sceneWorld.psun->direction;
+      shadowRay.orig = sp.origin;
+      hit_record shadowRec;
+      if (sceneWorld.hit(shadowRay, 0.001, INF, shadowRec)) {
+        result = result * 0.3; // Softer shadow
+      } else {
+        result = result * sceneWorld.psun->sunColor;
+      }
+
+      // Direct lighting from the picked point light
+      if (picked && picked->point) {
+        result = result +
+                 SamplePointLight(*picked->point, lightPmf, sp, sceneWorld);
+      }
+    }
+    // Glass (refractive) materials - light passes through, no shadow
+    // darkening
+  } else {
+    // Scatter returned false - use emission only
+    result = color(0, 0, 0);
   }
 
+  // Add emission to result
+  return emitted + result;
+}
+
+// Radiance arriving along `r` when it escapes the scene
+color ShadeMiss(const ray &r, world &sceneWorld, const PathVertex *prev) {
   // Sky background gradient or HDRI environment
   vec3 unit_direction = unit_vector(r.direction());
 
   // Use HDRI environment if available
   if (sceneWorld.hdri && sceneWorld.hdri->is_valid()) {
-    return sceneWorld.hdri->sample(unit_direction);
+    color envColor = sceneWorld.hdri->sample(unit_direction);
+    // MIS weight against environment sampling at the previous vertex
+    if (prev && sceneWorld.hdri->has_distribution()) {
+      const double pdfEnv = sceneWorld.hdri->pdf_value(unit_direction);
+      envColor = envColor * mis::power_heuristic(prev->bsdf_pdf, pdfEnv);
+    }
+    return envColor;
   }
 
   // Check if sun is disabled (zero color means sun is off)
@@ -169,10 +362,35 @@ color TraceRayInternal(const ray &r, int depth, world &sceneWorld) {
   return result * normalizedBrightness;
 }
 
+color TraceRayInternal(const ray &r, int depth, world &sceneWorld,
+                       const RayCone &cone, const PathVertex *prev) {
+  if (depth <= 0) {
+    return color(0, 0, 0);
+  }
+
+  hit_record rec;
+  if (sceneWorld.hit(r, 0.001, INF, rec)) {
+    return ShadeHit(r, rec, depth, sceneWorld, cone, prev);
+  }
+  return ShadeMiss(r, sceneWorld, prev);
+}
+
 } // namespace
 
 color TraceRay(const ray &r, int depth, world &sceneWorld) {
-  return TraceRayInternal(r, depth, sceneWorld);
+  return TraceRayInternal(r, depth, sceneWorld, PrimaryCone(sceneWorld));
+}
+
+color ShadePrimary(const ray &r, hit_record *rec, int depth,
+                   world &sceneWorld) {
+  if (depth <= 0) {
+    return color(0, 0, 0);
+  }
+  if (rec) {
+    return ShadeHit(r, *rec, depth, sceneWorld, PrimaryCone(sceneWorld),
+                    nullptr);
+  }
+  return ShadeMiss(r, sceneWorld, nullptr);
 }
 
 color RenderPixel(world &sceneWorld, int x, int y, int sampleIndex) {
@@ -188,23 +406,43 @@ color RenderPixel(world &sceneWorld, int x, int y, int sampleIndex) {
   const double v = (y + dist(gen)) / static_cast<double>(height - 1);
   const ray r = cam->get_ray(u, v);
 
-  return TraceRayInternal(r, sceneWorld.GetMaxDepth(), sceneWorld);
+  return TraceRayInternal(r, sceneWorld.GetMaxDepth(), sceneWorld,
+                          PrimaryCone(sceneWorld));
 }
 
-void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
-                         unsigned int threads, int tile_size, bool tile_debug,
-                         const TileCallback &onTileFinished,
-                         std::atomic<bool> *cancelFlag) {
+void PrepareScene(world &sceneWorld) {
   // Build BVH if BVH acceleration is selected and not already built
   if (sceneWorld.GetAccelerationMethod() == AccelerationMethod::BVH &&
       !sceneWorld.hasBVH()) {
     sceneWorld.buildBVH();
   }
 
+  if (!sceneWorld.hasLights()) {
+    sceneWorld.buildLights();
+  }
+
+  // Pack materials for switch-based dispatch if selected
+  if (sceneWorld.pconfig &&
+      sceneWorld.pconfig->materialDispatch == MaterialDispatch::TABLE &&
+      !sceneWorld.hasMaterialTable()) {
+    sceneWorld.buildMaterialTable();
+  }
+  sceneWorld.materialTable.enabled =
+      sceneWorld.pconfig &&
+      sceneWorld.pconfig->materialDispatch == MaterialDispatch::TABLE;
+}
+
+void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
+                         unsigned int threads, int tile_size, bool tile_debug,
+                         const TileCallback &onTileFinished,
+                         std::atomic<bool> *cancelFlag, AOVBuffers *aovs) {
+  PrepareScene(sceneWorld);
+
   const int width = sceneWorld.GetImageWidth();
   const int height = sceneWorld.GetImageHeight();
   const int samples = sceneWorld.GetSamplesPerPixel();
   std::shared_ptr<camera> camera = sceneWorld.pcamera;
+  const RayCone primaryCone = PrimaryCone(sceneWorld);
 
   if (tile_size <= 0) {
     tile_size = 16;
@@ -216,6 +454,18 @@ void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
   bitmap.clear();
   bitmap.resize(static_cast<size_t>(width) * static_cast<size_t>(height));
 
+  // Feature images for the caller and the denoiser
+  const bool denoise =
+      sceneWorld.pconfig && sceneWorld.pconfig->enableDenoiser;
+  AOVBuffers localAOVs;
+  AOVBuffers *features = aovs ? aovs : (denoise ? &localAOVs : nullptr);
+  if (features) {
+    features->albedo.assign(bitmap.size(), color(0, 0, 0));
+    features->normal.assign(bitmap.size(), color(0, 0, 0));
+    features->depth.assign(bitmap.size(), 0.0);
+  }
+  const int maxDepth = sceneWorld.GetMaxDepth();
+
   std::vector<Tile> tiles;
   for (int y = 0; y < height; y += tile_size) {
     for (int x = 0; x < width; x += tile_size) {
@@ -270,15 +520,39 @@ void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
           break;
         }
         for (int xx = tile.x0; xx < tile.x0 + tile.w; ++xx) {
+          const size_t index =
+              static_cast<size_t>(height - 1 - yy) * width + xx;
           color pixel_color(0, 0, 0);
           for (int s = 0; s < samples; ++s) {
             const double u = (xx + dist(gen)) / static_cast<double>(width - 1);
             const double v = (yy + dist(gen)) / static_cast<double>(height - 1);
             const ray r = camera->get_ray(u, v);
-            pixel_color +=
-                TraceRayInternal(r, sceneWorld.GetMaxDepth(), sceneWorld);
+            if (!features || maxDepth <= 0) {
+              pixel_color +=
+                  TraceRayInternal(r, maxDepth, sceneWorld, primaryCone);
+              continue;
+            }
+
+            // Same path, with the first hit recorded on the way
+            hit_record rec;
+            if (sceneWorld.hit(r, 0.001, INF, rec)) {
+              features->albedo[index] +=
+                  rec.mat_ptr ? rec.mat_ptr->guide_albedo(rec)
+                              : color(1, 1, 1);
+              features->normal[index] += rec.normal;
+              features->depth[index] += rec.t * r.direction().length();
+              pixel_color += ShadeHit(r, rec, maxDepth, sceneWorld,
+                                      primaryCone, nullptr);
+            } else {
+              const color background = ShadeMiss(r, sceneWorld, nullptr);
+              features->albedo[index] +=
+                  color(std::min(background.x(), 1.0),
+                        std::min(background.y(), 1.0),
+                        std::min(background.z(), 1.0));
+              pixel_color += background;
+            }
           }
-          bitmap[(height - 1 - yy) * width + xx] = pixel_color;
+          bitmap[index] = pixel_color;
         }
         if (cancelFlag && cancelFlag->load()) {
           break;
@@ -359,35 +633,62 @@ void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
     }
   }
 
-  // OIDN denoising pass (if enabled and not cancelled)
-  if (!cancelled.load() && sceneWorld.pconfig &&
-      sceneWorld.pconfig->enableDenoiser) {
-    oidn_denoiser denoiser;
-    if (oidn_denoiser::is_available()) {
-      if (!g_quiet.load()) {
+  // Denoising pass (if enabled and not cancelled): OIDN when available,
+  // otherwise the a-trous filter, which also uses the depth
+  if (!cancelled.load() && denoise) {
+    const bool oidn = oidn_denoiser::is_available();
+    if (!g_quiet.load()) {
+      if (oidn) {
         std::cerr << "Applying OIDN denoiser (" << oidn_denoiser::version()
                   << ")...\n";
+      } else {
+        std::cerr << "Applying a-trous denoiser...\n";
       }
+    }
 
-      // Normalize samples (divide by sample count for averaging)
-      const int samples = sceneWorld.GetSamplesPerPixel();
-      std::vector<color> normalized_bitmap(bitmap.size());
-      for (size_t i = 0; i < bitmap.size(); i++) {
-        normalized_bitmap[i] = bitmap[i] / static_cast<double>(samples);
+    // Per-pixel averages as interleaved floats
+    const size_t count = bitmap.size();
+    const double scale = 1.0 / static_cast<double>(samples);
+    std::vector<float> rgb(count * 3), albedo(count * 3), normal(count * 3);
+    std::vector<float> depth(count);
+    for (size_t i = 0; i < count; i++) {
+      for (int c = 0; c < 3; c++) {
+        rgb[i * 3 + c] = static_cast<float>(bitmap[i][c] * scale);
+        albedo[i * 3 + c] = static_cast<float>(features->albedo[i][c] * scale);
+        normal[i * 3 + c] = static_cast<float>(features->normal[i][c] * scale);
       }
+      depth[i] = static_cast<float>(features->depth[i] * scale);
+    }
 
-      // Denoise in HDR mode
-      auto denoised = denoiser.denoise(normalized_bitmap, width, height, true);
-
-      // Scale back to accumulated format (multiply by samples so downstream
-      // gamma correction works)
-      for (size_t i = 0; i < bitmap.size(); i++) {
-        bitmap[i] = denoised[i] * static_cast<double>(samples);
+    // Denoise in HDR mode, guided by the first-hit features; scale back to
+    // accumulated format (multiply by samples so downstream gamma
+    // correction works)
+    bool denoised = true;
+    if (oidn) {
+      // One long-lived denoiser keeps its device, filters and buffers
+      // across renders (animation frames, repeated GUI renders). It is
+      // never destroyed, so it cannot outlive OIDN's own state at exit.
+      static std::mutex denoiserMutex;
+      static oidn_denoiser *denoiser = new oidn_denoiser();
+      std::lock_guard<std::mutex> lock(denoiserMutex);
+      denoised = denoiser->denoise_in_place(rgb.data(), albedo.data(),
+                                            normal.data(), width, height, true);
+    } else {
+      denoiser::atrous_settings settings;
+      settings.iterations = sceneWorld.pconfig->denoiseIterations;
+      settings.threads = nthreads;
+      denoiser::atrous_filter(rgb.data(), albedo.data(), normal.data(),
+                              depth.data(), width, height, settings);
+    }
+    if (denoised) {
+      for (size_t i = 0; i < count; i++) {
+        bitmap[i] = color(rgb[i * 3 + 0], rgb[i * 3 + 1], rgb[i * 3 + 2]) *
+                    static_cast<double>(samples);
       }
+    }
 
-      if (!g_quiet.load()) {
-        std::cerr << "Denoising complete.\n";
-      }
+    if (!g_quiet.load()) {
+      std::cerr << "Denoising complete.\n";
     }
   }
 
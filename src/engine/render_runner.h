@@ -8,6 +8,7 @@
 #include "util/vec3.h"
 
 class ray;
+struct hit_record;
 class world;
 
 namespace render {
@@ -19,18 +20,39 @@ struct TileProgressStats {
   double estRemainingMs{0.0};
 };
 
+// First-hit feature images (AOVs), accumulated like the beauty image: each
+// entry is the sum over the pixel's samples, in bitmap order (top row
+// first). A miss adds the background (clamped to 1) as albedo, a zero
+// normal and zero depth.
+struct AOVBuffers {
+  std::vector<color> albedo;
+  std::vector<color> normal; // World-space shading normal
+  std::vector<double> depth; // Distance from the camera to the first hit
+};
+
 using TileCallback =
     std::function<void(const std::vector<color> &bitmap, int width, int height,
                        const TileProgressStats &stats)>;
 
 color TraceRay(const ray &r, int depth, world &sceneWorld);
 
+// Same as TraceRay() for a primary ray whose first hit is already known
+// (`rec` null when it misses the scene); only the rest of the path is traced
+color ShadePrimary(const ray &r, hit_record *rec, int depth, world &sceneWorld);
+
 // Render a single sample for a specific pixel
 color RenderPixel(world &sceneWorld, int x, int y, int sampleIndex);
 
+// Build the acceleration structure, light list and material table the
+// renderer needs, if the scene does not have them yet
+void PrepareScene(world &sceneWorld);
+
+// The denoiser (if enabled) is guided by the AOVs, which are gathered
+// whether or not `aovs` asks for a copy
 void RenderSceneToBitmap(world &sceneWorld, std::vector<color> &bitmap,
                          unsigned int threads, int tile_size, bool tile_debug,
                          const TileCallback &onTileFinished = TileCallback(),
-                         std::atomic<bool> *cancelFlag = nullptr);
+                         std::atomic<bool> *cancelFlag = nullptr,
+                         AOVBuffers *aovs = nullptr);
 
 } // namespace render
@@ -5,6 +5,7 @@
 #include "hittable.h"
 #include <cmath>
 #include <limits>
+#include <unordered_map>
 
 /**
  * @brief Instance wrapper that rotates a hittable around the Y axis
@@ -70,6 +71,13 @@ public:
     if (!ptr->hit(rotated_r, t_min, t_max, rec))
       return false;
 
+    // Hits on a wrapped emitter are reported as its world-space copy
+    if (!light_surfaces.empty()) {
+      auto it = light_surfaces.find(rec.object);
+      if (it != light_surfaces.end())
+        rec.object = it->second;
+    }
+
     // Rotate the intersection point and normal back to world space
     auto p = rec.p;
     auto normal = rec.normal;
@@ -97,6 +105,10 @@ public:
   double cos_theta;
   bool has_box;
   aabb bbox;
+
+  // Wrapped emitter -> the world-space copy world::buildLights samples for
+  // it (as in instance::light_surfaces)
+  std::unordered_map<const hittable *, const hittable *> light_surfaces;
 };
 
 #endif
@@ -45,9 +45,13 @@ bool sphere::hit(const ray &r, double t_min, double t_max,
   vec3 outward_normal = (rec.p - center) / radius;
   rec.set_face_normal(r, outward_normal);
   rec.mat_ptr = mat_ptr;
+  rec.material_slot = material_slot;
+  rec.object = this;
 
   // Compute UV coordinates for texture mapping
   get_sphere_uv(outward_normal, rec.u, rec.v);
+  // u wraps the equator (2*pi*r), v spans pole to pole (pi*r)
+  rec.uv_density = 1.0 / (M_PI * fabs(radius) * std::sqrt(2.0));
 
   return true;
 }
@@ -17,6 +17,7 @@ class sphere : public hittable {
         point3 center;
         double radius;
         shared_ptr<material> mat_ptr;
+        int material_slot = -1; // Assigned by world::buildMaterialTable()
 };
 
 
@@ -4,6 +4,7 @@
 #include "../util/vec3.h"
 #include "hittable.h"
 #include "material.h"
+#include "microfacet.h"
 #include "texture.h"
 #include <cmath>
 #include <memory>
@@ -75,6 +76,36 @@ public:
            (random_double() < 0.1);
   }
 
+  // For light sampling the material is a diffuse base tinted towards the
+  // scatter color at grazing angles, under a 4% Fresnel coat of the same
+  // roughness
+  virtual color eval(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return brdf(rec, wo).eval(rec.normal, wo, wi);
+  }
+
+  virtual double pdf(const hit_record &rec, const vec3 &wo,
+                     const vec3 &wi) const override {
+    return brdf(rec, wo).pdf(rec.normal, wo, wi);
+  }
+
+  virtual bool sample(const hit_record &rec, const vec3 &wo, double u1,
+                      double u2, bsdf_sample &s) const override {
+    const microfacet::metallic_roughness model = brdf(rec, wo);
+    if (!model.sample(rec.normal, wo, u1, u2, s.wi))
+      return false;
+    s.pdf = model.pdf(rec.normal, wo, s.wi);
+    if (s.pdf <= 0.0)
+      return false;
+    s.weight = model.eval(rec.normal, wo, s.wi) / s.pdf;
+    s.is_delta = false;
+    return true;
+  }
+
+  virtual color guide_albedo(const hit_record &rec) const override {
+    return surface_albedo->value(rec.u, rec.v, rec.p);
+  }
+
 public:
   shared_ptr<texture> surface_albedo;
   color scatter_color;    // Color of light scattering inside material
@@ -82,6 +113,15 @@ public:
   float roughness;
 
 private:
+  microfacet::metallic_roughness brdf(const hit_record &rec,
+                                     const vec3 &wo) const {
+    const color base_color = surface_albedo->value(rec.u, rec.v, rec.p);
+    const double cos_theta = std::clamp(dot(wo, rec.normal), 0.0, 1.0);
+    const double sss_factor = 0.4 * (1.0 - cos_theta);
+    return {(1.0 - sss_factor) * base_color + sss_factor * scatter_color, 0.0,
+            microfacet::alpha_from_roughness(roughness)};
+  }
+
   static double schlick_fresnel(double cosine, double f0) {
     return f0 + (1.0 - f0) * pow((1.0 - cosine), 5);
   }
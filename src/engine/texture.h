@@ -21,6 +21,18 @@ public:
    * @return Color at this location
    */
   virtual color value(double u, double v, const point3 &p) const = 0;
+
+  /**
+   * @brief Color averaged over a footprint of `width` UV units
+   *
+   * Mip-mapped textures pick a level from the width; the default is a
+   * point sample.
+   */
+  virtual color filtered_value(double u, double v, const point3 &p,
+                               double width) const {
+    (void)width;
+    return value(u, v, p);
+  }
 };
 
 /**
@@ -43,6 +55,30 @@ private:
   color color_value;
 };
 
+/**
+ * @brief Texture multiplied by a constant color
+ *
+ * Used for glTF base colors, where the material factor tints the texture.
+ */
+class scaled_texture : public texture {
+public:
+  scaled_texture(shared_ptr<texture> tex, const color &scale)
+      : tex(tex), scale(scale) {}
+
+  virtual color value(double u, double v, const point3 &p) const override {
+    return scale * tex->value(u, v, p);
+  }
+
+  virtual color filtered_value(double u, double v, const point3 &p,
+                               double width) const override {
+    return scale * tex->filtered_value(u, v, p, width);
+  }
+
+private:
+  shared_ptr<texture> tex;
+  color scale;
+};
+
 /**
  * @brief Checker pattern texture for testing
  */
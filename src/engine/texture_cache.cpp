@@ -0,0 +1,185 @@
+#include "texture_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Hits are counted per thread and added to the shared counter in batches,
+// so the hot path never writes a cache line other threads read
+constexpr uint64_t kHitBatch = 4096;
+
+struct hit_counter {
+  std::atomic<uint64_t> *total = nullptr;
+  uint64_t pending = 0;
+
+  void flush() {
+    if (total && pending)
+      total->fetch_add(pending, std::memory_order_relaxed);
+    pending = 0;
+  }
+  ~hit_counter() { flush(); }
+};
+
+thread_local hit_counter t_hits;
+
+// Keeps the pool from degenerating into a handful of slots
+constexpr size_t kMinTiles = 64;
+
+} // namespace
+
+texture_cache::table::table(uint32_t id, uint32_t count, tile_loader load)
+    : id(id), count(count), load(std::move(load)),
+      slots(new std::atomic<uint32_t>[count]) {
+  for (uint32_t i = 0; i < count; i++)
+    slots[i].store(0, std::memory_order_relaxed);
+}
+
+texture_cache::table::~table() { texture_cache::instance().release(*this); }
+
+texture_cache &texture_cache::instance() {
+  // Never destroyed: textures held by namespace-scope asset caches release
+  // their tables during static destruction, after a function-local static
+  // would already be gone
+  static texture_cache *cache = new texture_cache;
+  return *cache;
+}
+
+texture_cache::texture_cache() { allocate(default_budget); }
+
+void texture_cache::allocate(size_t bytes) {
+  capacity = std::max(kMinTiles, bytes / tile_bytes);
+  // Left uninitialized: pages are only committed once a tile lands in them
+  memory.reset(new uint32_t[capacity * tile_texels]);
+  slots.reset(new slot[capacity]);
+  free_slots.clear();
+  used = 0;
+  hand = 0;
+}
+
+void texture_cache::set_budget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint32_t i = 0; i < used; i++) {
+    if (slots[i].owner)
+      slots[i].owner->slots[slots[i].tile].store(0, std::memory_order_relaxed);
+  }
+  allocate(bytes);
+}
+
+std::unique_ptr<texture_cache::table>
+texture_cache::attach(uint32_t tile_count, tile_loader load) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::unique_ptr<table>(
+      new table(next_id++, tile_count, std::move(load)));
+}
+
+void texture_cache::release(table &t) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint32_t i = 0; i < used; i++) {
+    slot &s = slots[i];
+    if (s.owner != &t)
+      continue;
+    s.owner = nullptr;
+    s.tag.store(0, std::memory_order_relaxed);
+    free_slots.push_back(i);
+  }
+}
+
+bool texture_cache::read(table &t, uint32_t tile, const uint32_t *texels,
+                         int count, uint32_t *out) {
+  const uint64_t tag = (uint64_t(t.id) << 32) | tile;
+  while (true) {
+    const uint32_t index = t.slots[tile].load(std::memory_order_acquire);
+    if (index) {
+      slot &s = slots[index - 1];
+      const uint32_t seq = s.sequence.load(std::memory_order_acquire);
+      if (!(seq & 1) && s.tag.load(std::memory_order_relaxed) == tag) {
+        uint32_t *base = &memory[size_t(index - 1) * tile_texels];
+        for (int i = 0; i < count; i++)
+          out[i] = std::atomic_ref<uint32_t>(base[texels[i]])
+                       .load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) == seq) {
+          if (!s.referenced.load(std::memory_order_relaxed))
+            s.referenced.store(true, std::memory_order_relaxed);
+          t_hits.total = &hits;
+          if (++t_hits.pending >= kHitBatch)
+            t_hits.flush();
+          return true;
+        }
+      }
+    }
+    if (!fill(t, tile))
+      return false;
+  }
+}
+
+uint32_t texture_cache::take_slot() {
+  if (!free_slots.empty()) {
+    const uint32_t index = free_slots.back();
+    free_slots.pop_back();
+    return index;
+  }
+  if (used < capacity)
+    return used++;
+
+  // CLOCK: skip (and clear) recently referenced slots
+  while (true) {
+    const uint32_t index = hand;
+    hand = (hand + 1) % capacity;
+    if (!slots[index].referenced.exchange(false, std::memory_order_relaxed))
+      return index;
+  }
+}
+
+bool texture_cache::fill(table &t, uint32_t tile) {
+  // Read before touching the pool so a failed load evicts nothing. Two
+  // threads missing the same tile may both read it; the later copy is
+  // dropped below.
+  thread_local std::vector<uint8_t> scratch;
+  scratch.resize(tile_bytes);
+  if (!t.load(tile, scratch.data()))
+    return false;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (t.slots[tile].load(std::memory_order_relaxed))
+    return true; // Loaded by another thread meanwhile
+  misses.fetch_add(1, std::memory_order_relaxed);
+
+  const uint32_t index = take_slot();
+  slot &s = slots[index];
+  if (s.owner) {
+    s.owner->slots[s.tile].store(0, std::memory_order_relaxed);
+    evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const uint32_t seq = s.sequence.load(std::memory_order_relaxed);
+  s.sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  uint32_t *texels = &memory[size_t(index) * tile_texels];
+  for (size_t i = 0; i < tile_texels; i++) {
+    uint32_t value;
+    std::memcpy(&value, &scratch[i * 4], 4);
+    std::atomic_ref<uint32_t>(texels[i]).store(value,
+                                               std::memory_order_relaxed);
+  }
+  s.tag.store((uint64_t(t.id) << 32) | tile, std::memory_order_relaxed);
+  s.owner = &t;
+  s.tile = tile;
+  s.referenced.store(true, std::memory_order_relaxed);
+  s.sequence.store(seq + 2, std::memory_order_release);
+
+  t.slots[tile].store(index + 1, std::memory_order_release);
+  return true;
+}
+
+texture_cache::statistics texture_cache::stats() const {
+  t_hits.flush();
+  std::lock_guard<std::mutex> lock(mutex);
+  statistics out;
+  out.hits = hits.load(std::memory_order_relaxed);
+  out.misses = misses.load(std::memory_order_relaxed);
+  out.evictions = evictions.load(std::memory_order_relaxed);
+  out.resident_tiles = used - free_slots.size();
+  out.capacity_tiles = capacity;
+  return out;
+}
@@ -0,0 +1,115 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Fixed-budget pool of texture tiles shared by every image texture
+ *
+ * A texture attaches a page table (one entry per tile of every mip level)
+ * and a loader that fills a tile on a miss. Resident tiles live in a pool
+ * of fixed-size slots; once the pool is full the CLOCK algorithm picks the
+ * victim, so resident texel memory never exceeds the budget.
+ *
+ * Hits are lock-free: a render thread reads the slot from the page table,
+ * copies the texel and re-checks the slot's sequence number, which is odd
+ * while the slot is being refilled (a seqlock). Misses load the tile
+ * without any lock and take the cache mutex only to claim a slot and
+ * publish it, so disk reads never hold up other threads.
+ */
+class texture_cache {
+public:
+  static constexpr size_t tile_texels = 32 * 32;
+  static constexpr size_t tile_bytes = tile_texels * 4; // RGBA8
+  static constexpr size_t default_budget = size_t(512) << 20;
+
+  struct statistics {
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    size_t resident_tiles = 0, capacity_tiles = 0;
+  };
+
+  // Fill `dst` (tile_bytes) with a tile; false when it cannot be read.
+  // Called from several threads at once.
+  using tile_loader = std::function<bool(uint32_t tile, uint8_t *dst)>;
+
+  /**
+   * @brief Page table of one texture, created by attach()
+   *
+   * Detaches itself (releasing its resident tiles) when destroyed.
+   */
+  class table {
+  public:
+    ~table();
+    table(const table &) = delete;
+    table &operator=(const table &) = delete;
+
+    uint32_t tile_count() const { return count; }
+
+  private:
+    friend class texture_cache;
+    table(uint32_t id, uint32_t count, tile_loader load);
+
+    uint32_t id;
+    uint32_t count;
+    tile_loader load;
+    // Slot index + 1 for each tile, 0 when not resident
+    std::unique_ptr<std::atomic<uint32_t>[]> slots;
+  };
+
+  static texture_cache &instance();
+
+  /**
+   * @brief Change the memory budget; drops every resident tile
+   *
+   * Must not be called while textures are being sampled.
+   */
+  void set_budget(size_t bytes);
+  size_t budget() const { return capacity * tile_bytes; }
+
+  std::unique_ptr<table> attach(uint32_t tile_count, tile_loader load);
+
+  /**
+   * @brief RGBA8 texels (indices 0..tile_texels-1) of one tile, copied
+   *        under a single residency check
+   * @return false when the tile could not be loaded
+   */
+  bool read(table &t, uint32_t tile, const uint32_t *texels, int count,
+            uint32_t *out);
+
+  // Counters of finished threads plus batches flushed by running ones
+  statistics stats() const;
+
+private:
+  struct slot {
+    std::atomic<uint32_t> sequence{0}; // Odd while being refilled
+    std::atomic<uint64_t> tag{0};      // (table id << 32) | tile, 0 = empty
+    std::atomic<bool> referenced{false};
+    table *owner = nullptr; // Guarded by mutex
+    uint32_t tile = 0;
+  };
+
+  texture_cache();
+  void allocate(size_t bytes);
+  bool fill(table &t, uint32_t tile);
+  uint32_t take_slot();
+  void release(table &t);
+
+  mutable std::mutex mutex;
+  size_t capacity = 0;
+  std::unique_ptr<uint32_t[]> memory; // capacity * tile_texels
+  std::unique_ptr<slot[]> slots;
+  std::vector<uint32_t> free_slots;
+  uint32_t used = 0;
+  uint32_t hand = 0;
+  uint32_t next_id = 1;
+
+  std::atomic<uint64_t> hits{0}, misses{0}, evictions{0};
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "aabb.h"
 #include "hittable.h"
+#include <unordered_map>
 
 /**
  * @brief Instance wrapper that translates a hittable by an offset
@@ -30,6 +31,13 @@ public:
     if (!ptr->hit(moved_r, t_min, t_max, rec))
       return false;
 
+    // Hits on a wrapped emitter are reported as its world-space copy
+    if (!light_surfaces.empty()) {
+      auto it = light_surfaces.find(rec.object);
+      if (it != light_surfaces.end())
+        rec.object = it->second;
+    }
+
     // Move the intersection point forwards by the offset
     rec.p = rec.p + offset;
     rec.set_face_normal(moved_r, rec.normal);
@@ -46,6 +54,10 @@ public:
   shared_ptr<hittable> ptr;
   vec3 offset;
   aabb bbox;
+
+  // Wrapped emitter -> the world-space copy world::buildLights samples for
+  // it (as in instance::light_surfaces)
+  std::unordered_map<const hittable *, const hittable *> light_surfaces;
 };
 
 #endif
@@ -79,16 +79,23 @@ bool triangle::hit(const ray &r, double t_min, double t_max,
   vec3 outward_normal = unit_vector(cross(edge1, edge2));
   rec.set_face_normal(r, outward_normal);
   rec.mat_ptr = mat_ptr;
+  rec.material_slot = material_slot;
+  rec.object = this;
 
   // Interpolate UV coordinates using barycentric coordinates
   if (has_uvs) {
     // UV = w*uv0 + u*uv1 + v*uv2
     rec.u = w_bary * uv0.x() + u_bary * uv1.x() + v_bary * uv2.x();
     rec.v = w_bary * uv0.y() + u_bary * uv1.y() + v_bary * uv2.y();
+
+    // UV units per world unit, for texture filtering
+    const double uvArea = fabs(cross(uv1 - uv0, uv2 - uv0).z());
+    rec.uv_density = sqrt(uvArea / cross(edge1, edge2).length());
   } else {
     // Default UVs based on barycentric coordinates
     rec.u = u_bary;
     rec.v = v_bary;
+    rec.uv_density = sqrt(1.0 / cross(edge1, edge2).length());
   }
 
   return true;
@@ -107,4 +114,26 @@ bool triangle::bounding_box(aabb &output_box) const {
 
   output_box = aabb(min_point, max_point);
   return true;
-}
\ No newline at end of file
+}
+
+double triangle::pdf_value(const point3 &origin, const vec3 &direction) const {
+  hit_record rec;
+  if (!this->hit(ray(origin, direction), 0.001, INF, rec))
+    return 0;
+
+  // Convert the uniform area pdf (1/A) to solid angle at the origin
+  double distance_squared = rec.t * rec.t * direction.length_squared();
+  double cosine = fabs(dot(direction, rec.normal) / direction.length());
+  if (cosine < 1e-8)
+    return 0;
+
+  return distance_squared / (cosine * area());
+}
+
+vec3 triangle::random(const point3 &origin) const {
+  // Uniform barycentric sampling (square-root warp)
+  double s = sqrt(random_double());
+  double r2 = random_double();
+  point3 p = (1.0 - s) * v0 + s * (1.0 - r2) * v1 + s * r2 * v2;
+  return p - origin;
+}
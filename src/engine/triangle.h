@@ -28,6 +28,13 @@ public:
                    hit_record &rec) const override;
   virtual bool bounding_box(aabb &output_box) const override;
 
+  // Area light sampling (uniform over the triangle's surface)
+  virtual double pdf_value(const point3 &origin,
+                           const vec3 &direction) const override;
+  virtual vec3 random(const point3 &origin) const override;
+
+  double area() const { return 0.5 * cross(v1 - v0, v2 - v0).length(); }
+
 public:
   // Vertex positions
   vec3 v0, v1, v2;
@@ -37,6 +44,7 @@ public:
   bool has_uvs;
 
   shared_ptr<material> mat_ptr;
+  int material_slot = -1; // Assigned by world::buildMaterialTable()
   bool degenerate = false; // true if triangle area is (near) zero
 };
 
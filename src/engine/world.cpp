@@ -3,6 +3,25 @@
 #include "config.h"
 #include "bvh_node.h"
 #include "aabb.h"
+#include "constant_medium.h"
+#include "grid_medium.h"
+#include "material.h"
+#include "mesh.h"
+#include "point_light.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "lambertian_textured.h"
+#include "noise_texture.h"
+#include "pbr_material.h"
+#include "quad.h"
+#include "rotate_y.h"
+#include "sphere.h"
+#include "translate.h"
+#include "triangle.h"
+#include "../util/logging.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iostream>
 
 int world::GetImageWidth(){
@@ -70,11 +89,436 @@ void world::buildBVH() {
     
     std::cerr << "Building BVH for " << objects.size() << " objects..." << std::endl;
     bvh_root = std::make_shared<bvh_node>(objects);
+    bvh_build_cost = bvh_root->sahCost();
     std::cerr << "BVH built: " << bvh_root->getNodeCount() << " nodes, " 
               << bvh_root->getLeafCount() << " leaves, max depth " 
               << bvh_root->getMaxDepth() << std::endl;
 }
 
+size_t world::addObject(std::shared_ptr<hittable> object) {
+    objects.push_back(object);
+    material_table_built = false; // May bring materials without a slot
+    if (bvh_root) {
+        bvh_root->insert(object);
+        checkBVHQuality();
+    }
+    updateLights(object);
+    return objects.size() - 1;
+}
+
+bool world::removeObject(size_t index) {
+    if (index >= objects.size()) {
+        return false;
+    }
+    const std::shared_ptr<hittable> object = objects[index];
+    objects.erase(objects.begin() + index);
+    edit_instances.erase(object.get());
+    objectSources.erase(object.get());
+
+    if (objects.empty()) {
+        bvh_root.reset();
+    } else if (bvh_root) {
+        aabb box;
+        object->bounding_box(box);
+        bvh_root->remove(object.get(), box);
+        checkBVHQuality();
+    }
+    updateLights(object);
+    return true;
+}
+
+bool world::setObjectTransform(size_t index, const glm::mat4& object_to_world) {
+    if (index >= objects.size()) {
+        return false;
+    }
+    const std::shared_ptr<hittable> object = objects[index];
+    aabb old_box;
+    object->bounding_box(old_box);
+
+    auto edited = edit_instances.find(object.get());
+    if (edited != edit_instances.end()) {
+        // Already wrapped by an earlier edit: move the wrapper
+        std::static_pointer_cast<instance>(object)->set_transform(
+            object_to_world * edited->second);
+    } else {
+        // Loaded instances (glTF mesh placements) are replaced by one
+        // instance of the same mesh rather than nested
+        std::shared_ptr<hittable> placed = object;
+        glm::mat4 loaded(1.0f);
+        if (auto inst = std::dynamic_pointer_cast<instance>(object)) {
+            placed = inst->ptr;
+            loaded = inst->transform();
+        }
+        auto wrapper = std::make_shared<instance>(placed, object_to_world * loaded);
+        edit_instances[wrapper.get()] = loaded;
+        objects[index] = wrapper;
+        // No longer what the scene description says
+        objectSources.erase(object.get());
+    }
+
+    if (bvh_root) {
+        bvh_root->replace(object.get(), old_box, objects[index]);
+        checkBVHQuality();
+    }
+    updateLights(objects[index]);
+    return true;
+}
+
+void world::checkBVHQuality() {
+    // Insertion and refits loosen the tree; a full rebuild restores it
+    constexpr double kRebuildRatio = 1.5;
+    if (bvh_root && bvh_root->sahCost() > kRebuildRatio * bvh_build_cost) {
+        buildBVH();
+    }
+}
+
+namespace {
+
+double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// Emitted luminance at the centroid, or 0 for non-emissive primitives
+double emitted_luminance(const shared_ptr<material>& mat, const point3& p) {
+    if (!mat) {
+        return 0.0;
+    }
+    return luminance(mat->emitted(0.5, 0.5, p));
+}
+
+// Emissive primitive inside a transform wrapper
+struct placed_emitter {
+    const hittable* source;       // Object-space primitive that rays hit
+    shared_ptr<hittable> placed;  // World-space copy for light sampling
+    double power;
+};
+
+// Point inside a rotate_y wrapper, in the wrapper's space (as in its hit())
+point3 rotated_to_world(const rotate_y& r, const point3& p) {
+    return point3(r.cos_theta * p.x() + r.sin_theta * p.z(), p.y(),
+                  -r.sin_theta * p.x() + r.cos_theta * p.z());
+}
+
+// Emissive triangles and quads of a mesh, triangle or quad, through any
+// number of nested instances, translate/rotate_y wrappers and lists.
+// `to_world` places points of `object` in world space.
+void collectEmitters(const shared_ptr<hittable>& object,
+                     const std::function<point3(const point3&)>& to_world,
+                     std::vector<placed_emitter>& out) {
+    auto addTriangle = [&](const shared_ptr<triangle>& tri) {
+        const point3 centroid = (tri->v0 + tri->v1 + tri->v2) / 3.0;
+        const double radiance = emitted_luminance(tri->mat_ptr, centroid);
+        if (tri->degenerate || radiance <= 0.0) {
+            return;
+        }
+        auto placed = make_shared<triangle>(to_world(tri->v0), to_world(tri->v1),
+                                            to_world(tri->v2), tri->mat_ptr);
+        out.push_back({tri.get(), placed, radiance * placed->area()});
+    };
+
+    // Nested wrappers may still map hits to copies placed for an earlier
+    // layout; only the outermost wrapper redirects hits to light copies
+    if (auto inner = std::dynamic_pointer_cast<instance>(object)) {
+        inner->light_surfaces.clear();
+        const instance* nested = inner.get();
+        collectEmitters(inner->ptr,
+                        [&to_world, nested](const point3& p) {
+                            return to_world(nested->world_point(p));
+                        },
+                        out);
+    } else if (auto t = std::dynamic_pointer_cast<translate>(object)) {
+        t->light_surfaces.clear();
+        const vec3 offset = t->offset;
+        collectEmitters(t->ptr,
+                        [&to_world, offset](const point3& p) {
+                            return to_world(p + offset);
+                        },
+                        out);
+    } else if (auto r = std::dynamic_pointer_cast<rotate_y>(object)) {
+        r->light_surfaces.clear();
+        const rotate_y* rotation = r.get();
+        collectEmitters(r->ptr,
+                        [&to_world, rotation](const point3& p) {
+                            return to_world(rotated_to_world(*rotation, p));
+                        },
+                        out);
+    } else if (auto list = std::dynamic_pointer_cast<hittable_list>(object)) {
+        for (const auto& child : list->objects) {
+            collectEmitters(child, to_world, out);
+        }
+    } else if (auto m = std::dynamic_pointer_cast<mesh>(object)) {
+        for (const auto& tri : m->getEmissiveTriangles()) {
+            addTriangle(tri);
+        }
+    } else if (auto tri = std::dynamic_pointer_cast<triangle>(object)) {
+        addTriangle(tri);
+    } else if (auto q = std::dynamic_pointer_cast<quad>(object)) {
+        const double radiance =
+            emitted_luminance(q->mat, q->Q + 0.5 * (q->u + q->v));
+        if (radiance <= 0.0) {
+            return;
+        }
+        // Affine maps keep parallelograms, so the corner and edges suffice
+        const point3 corner = to_world(q->Q);
+        auto placed = make_shared<quad>(corner, to_world(q->Q + q->u) - corner,
+                                        to_world(q->Q + q->v) - corner, q->mat);
+        out.push_back({q.get(), placed, radiance * placed->area()});
+    }
+}
+
+std::vector<placed_emitter> wrappedEmitters(const shared_ptr<hittable>& inner,
+                                            const std::function<point3(const point3&)>& to_world) {
+    std::vector<placed_emitter> emitters;
+    collectEmitters(inner, to_world, emitters);
+    return emitters;
+}
+
+} // namespace
+
+void world::buildLights() {
+    lights.clear();
+    light_lookup.clear();
+
+    for (const auto& light : pointLights) {
+        scene_light entry;
+        entry.point = light;
+        entry.bounds = aabb(light->position, light->position);
+        entry.power = luminance(light->lightColor) * light->intensity;
+        lights.push_back(entry);
+    }
+    const size_t numPoint = lights.size();
+
+    // `surface` is the primitive rays report when they hit the light
+    auto addEmitter = [this](const shared_ptr<hittable>& prim, double power,
+                             const hittable* surface) {
+        if (power <= 0.0) {
+            return;
+        }
+        scene_light entry;
+        entry.emitter = prim;
+        entry.surface = surface;
+        prim->bounding_box(entry.bounds);
+        entry.power = power;
+        light_lookup[surface] = static_cast<int>(lights.size());
+        lights.push_back(entry);
+    };
+
+    auto addTriangle = [&addEmitter](const shared_ptr<triangle>& tri) {
+        if (tri->degenerate) {
+            return;
+        }
+        point3 centroid = (tri->v0 + tri->v1 + tri->v2) / 3.0;
+        addEmitter(tri, emitted_luminance(tri->mat_ptr, centroid) * tri->area(),
+                   tri.get());
+    };
+
+    // Rays hit the object-space primitives of a transform wrapper, while
+    // light sampling needs them in world space: sample placed copies, which
+    // the outermost wrapper reports as the hit surface
+    using surface_map = std::unordered_map<const hittable*, const hittable*>;
+    auto addWrapped = [&addEmitter](surface_map& surfaces,
+                                    const shared_ptr<hittable>& inner,
+                                    const std::function<point3(const point3&)>& to_world) {
+        surfaces.clear();
+        for (const auto& emitter : wrappedEmitters(inner, to_world)) {
+            surfaces[emitter.source] = emitter.placed.get();
+            addEmitter(emitter.placed, emitter.power, emitter.placed.get());
+        }
+    };
+
+    // World-space objects; lists are flattened
+    std::function<void(const shared_ptr<hittable>&)> addObject =
+        [&](const shared_ptr<hittable>& object) {
+        if (auto q = std::dynamic_pointer_cast<quad>(object)) {
+            point3 center = q->Q + 0.5 * (q->u + q->v);
+            addEmitter(q, emitted_luminance(q->mat, center) * q->area(), q.get());
+        } else if (auto tri = std::dynamic_pointer_cast<triangle>(object)) {
+            addTriangle(tri);
+        } else if (auto m = std::dynamic_pointer_cast<mesh>(object)) {
+            for (const auto& meshTri : m->getEmissiveTriangles()) {
+                addTriangle(meshTri);
+            }
+        } else if (auto list = std::dynamic_pointer_cast<hittable_list>(object)) {
+            for (const auto& child : list->objects) {
+                addObject(child);
+            }
+        } else if (auto inst = std::dynamic_pointer_cast<instance>(object)) {
+            const instance* outer = inst.get();
+            addWrapped(inst->light_surfaces, inst->ptr,
+                       [outer](const point3& p) { return outer->world_point(p); });
+        } else if (auto t = std::dynamic_pointer_cast<translate>(object)) {
+            const vec3 offset = t->offset;
+            addWrapped(t->light_surfaces, t->ptr,
+                       [offset](const point3& p) { return p + offset; });
+        } else if (auto r = std::dynamic_pointer_cast<rotate_y>(object)) {
+            const rotate_y* rotation = r.get();
+            addWrapped(r->light_surfaces, r->ptr, [rotation](const point3& p) {
+                return rotated_to_world(*rotation, p);
+            });
+        }
+    };
+    for (const auto& object : objects) {
+        addObject(object);
+    }
+
+    lightTree.build(lights);
+
+    std::vector<double> powers;
+    powers.reserve(lights.size());
+    for (const auto& light : lights) {
+        powers.push_back(light.power);
+    }
+    lightPowerTable.build(powers);
+    lights_built = true;
+
+    if (!g_quiet.load() && !lights.empty()) {
+        std::cerr << "Light tree: " << lights.size() << " lights ("
+                  << numPoint << " point, " << (lights.size() - numPoint)
+                  << " emissive), depth " << lightTree.depth() << std::endl;
+    }
+}
+
+void world::updateLights(const shared_ptr<hittable>& object) {
+    if (!lights_built) {
+        return;
+    }
+    // Placement does not matter here, only whether anything emits
+    const bool emissive =
+        !wrappedEmitters(object, [](const point3& p) { return p; }).empty();
+    if (emissive) {
+        buildLights();
+    }
+}
+
+int world::lightIndexOf(const hittable* object) const {
+    auto it = light_lookup.find(object);
+    return it == light_lookup.end() ? -1 : it->second;
+}
+
+bool world::sampleLight(const point3& p, const vec3& n, double u, int& lightIndex,
+                        double& pmf) const {
+    if (pconfig && pconfig->lightSampling == LightSampling::POWER) {
+        if (lightPowerTable.empty()) {
+            return false;
+        }
+        lightPowerTable.sample(u, lightIndex, pmf);
+        return pmf > 0.0;
+    }
+    return lightTree.sample(p, n, u, lightIndex, pmf);
+}
+
+double world::lightPmf(const point3& p, const vec3& n, int lightIndex) const {
+    if (pconfig && pconfig->lightSampling == LightSampling::POWER) {
+        return lightPowerTable.pmf(lightIndex);
+    }
+    return lightTree.pmf(p, n, lightIndex);
+}
+
+namespace {
+
+// Call fn for every material reachable from an object, along with the
+// primitive's material table slot for it. Materials created by loaders
+// (OBJ/MTL, glTF) are only reachable through the primitives.
+using material_visitor =
+    std::function<void(const shared_ptr<material>&, int& tableSlot)>;
+
+void forEachMaterial(const shared_ptr<hittable>& object, const material_visitor& fn) {
+    if (auto s = std::dynamic_pointer_cast<sphere>(object)) {
+        fn(s->mat_ptr, s->material_slot);
+    } else if (auto tri = std::dynamic_pointer_cast<triangle>(object)) {
+        fn(tri->mat_ptr, tri->material_slot);
+    } else if (auto q = std::dynamic_pointer_cast<quad>(object)) {
+        fn(q->mat, q->material_slot);
+    } else if (auto m = std::dynamic_pointer_cast<mesh>(object)) {
+        const auto& mats = m->getMaterials();
+        std::vector<int>& slots = m->getMaterialTableSlots();
+        slots.resize(mats.size(), -1);
+        for (size_t i = 0; i < mats.size(); i++) {
+            fn(mats[i], slots[i]);
+        }
+    } else if (auto list = std::dynamic_pointer_cast<hittable_list>(object)) {
+        for (const auto& child : list->objects) {
+            forEachMaterial(child, fn);
+        }
+    } else if (auto t = std::dynamic_pointer_cast<translate>(object)) {
+        forEachMaterial(t->ptr, fn);
+    } else if (auto r = std::dynamic_pointer_cast<rotate_y>(object)) {
+        forEachMaterial(r->ptr, fn);
+    } else if (auto i = std::dynamic_pointer_cast<instance>(object)) {
+        forEachMaterial(i->ptr, fn);
+    } else if (auto medium = std::dynamic_pointer_cast<constant_medium>(object)) {
+        fn(medium->phase_function, medium->material_slot);
+    } else if (auto grid = std::dynamic_pointer_cast<grid_medium>(object)) {
+        fn(grid->phase_function, grid->material_slot);
+    }
+}
+
+} // namespace
+
+void world::buildMaterialTable() {
+    std::vector<shared_ptr<material>> used(materials.begin(), materials.end());
+    for (const auto& object : objects) {
+        forEachMaterial(object, [&](const shared_ptr<material>& mat, int&) {
+            used.push_back(mat);
+        });
+    }
+
+    const size_t packed = materialTable.build(used);
+    // Resolve each primitive's slot once, so shading needs no lookup
+    for (const auto& object : objects) {
+        forEachMaterial(object, [&](const shared_ptr<material>& mat, int& slot) {
+            slot = materialTable.slot_of(mat.get());
+        });
+    }
+    material_table_built = true;
+    if (!g_quiet.load()) {
+        std::cerr << "Material table: " << packed << " materials packed" << std::endl;
+    }
+}
+
+void world::bakeTextures() {
+    // World bounds of every object using each texture
+    std::vector<std::pair<bakeable_noise_texture*, aabb>> targets;
+    for (const auto& object : objects) {
+        aabb box;
+        if (!object->bounding_box(box)) {
+            continue;
+        }
+        forEachMaterial(object, [&](const shared_ptr<material>& mat, int&) {
+            shared_ptr<texture> albedo;
+            if (auto l = std::dynamic_pointer_cast<lambertian_textured>(mat)) {
+                albedo = l->albedo;
+            } else if (auto p = std::dynamic_pointer_cast<pbr_material>(mat)) {
+                albedo = p->albedo;
+            }
+            auto noise = dynamic_cast<bakeable_noise_texture*>(albedo.get());
+            if (!noise || noise->bake_resolution() <= 0) {
+                return;
+            }
+            auto it = std::find_if(targets.begin(), targets.end(),
+                                   [&](const auto& t) { return t.first == noise; });
+            if (it == targets.end()) {
+                targets.emplace_back(noise, box);
+            } else {
+                it->second = surrounding_box(it->second, box);
+            }
+        });
+    }
+
+    for (auto& [noise, bounds] : targets) {
+        auto start = std::chrono::steady_clock::now();
+        noise->bake(bounds);
+        auto end = std::chrono::steady_clock::now();
+        if (!g_quiet.load()) {
+            std::cerr << "Baked noise texture: resolution "
+                      << noise->bake_resolution() << ", "
+                      << noise->baked_size() / (1024.0 * 1024.0) << " MB in "
+                      << std::chrono::duration<double, std::milli>(end - start).count()
+                      << " ms" << std::endl;
+        }
+    }
+}
+
 bool world::bounding_box(aabb& output_box) const {
     if (objects.empty()) {
         return false;
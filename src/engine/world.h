@@ -1,10 +1,16 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include <glm/mat4x4.hpp>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 // #include <memory>
 #include "config.h"
+#include "alias_table.h"
 #include "hittable.h"
+#include "light_tree.h"
+#include "material_table.h"
 
 // #include "sun.h"
 
@@ -35,6 +41,46 @@ public:
   // Check if BVH is built
   bool hasBVH() const { return bvh_root != nullptr; }
 
+  // Scene editing; call only while no rays are being traced. A built BVH
+  // is updated in place (insertion, removal, bottom-up refit) and rebuilt
+  // from scratch only once its SAH cost has grown well past the cost of
+  // the last full build.
+  size_t addObject(std::shared_ptr<hittable> object);
+  bool removeObject(size_t index);
+
+  // Place objects[index] by `object_to_world`, applied on top of its loaded
+  // placement. The first call wraps the object in an instance, so meshes
+  // keep their own BVH; an object that already is an instance is re-placed
+  // with the composed transform instead of being wrapped again.
+  bool setObjectTransform(size_t index, const glm::mat4 &object_to_world);
+
+  // Gather point lights and emissive primitives and build the light tree
+  // (call after scene is loaded)
+  void buildLights();
+
+  bool hasLights() const { return lights_built; }
+
+  // Index into `lights` for an emissive primitive, or -1
+  int lightIndexOf(const hittable *object) const;
+
+  // Pick one light for the shading point using the configured strategy
+  bool sampleLight(const point3 &p, const vec3 &n, double u, int &lightIndex,
+                   double &pmf) const;
+
+  // Probability that sampleLight picks `lightIndex` at (p, n)
+  double lightPmf(const point3 &p, const vec3 &n, int lightIndex) const;
+
+  // Gather every material used by the scene into materialTable and store
+  // the slots in the primitives using them
+  void buildMaterialTable();
+
+  // False until buildMaterialTable() runs and again after addObject()
+  bool hasMaterialTable() const { return material_table_built; }
+
+  // Bake noise textures that request it over the bounds of the objects
+  // using them (call after scene is loaded)
+  void bakeTextures();
+
 private:
   // Linear intersection (original method)
   bool hitLinear(const ray &r, double t_min, double t_max,
@@ -43,6 +89,20 @@ private:
   // BVH accelerated intersection
   bool hitBVH(const ray &r, double t_min, double t_max, hit_record &rec) const;
 
+  // Rebuild the BVH if edits have degraded it too much
+  void checkBVHQuality();
+
+  // Re-gather the lights after an edit to an emissive object
+  void updateLights(const std::shared_ptr<hittable> &object);
+
+  std::unordered_map<const hittable *, int> light_lookup;
+  bool lights_built = false;
+  bool material_table_built = false;
+
+  double bvh_build_cost = 0.0; // SAH cost right after the last full build
+  // Instances made by edits -> the loaded placement they compose with
+  std::unordered_map<const hittable *, glm::mat4> edit_instances;
+
 public:
   std::shared_ptr<config> pconfig;
   std::shared_ptr<sun> psun;
@@ -59,6 +119,25 @@ public:
   // Point lights for artificial indoor lighting
   std::vector<std::shared_ptr<class PointLight>> pointLights;
 
+  // All sampleable lights (point lights followed by emissive primitives)
+  // and the structures used to pick one per shading point
+  std::vector<scene_light> lights;
+  light_tree lightTree;
+  alias_table lightPowerTable;
+
+  // Packed copies of the scene materials for switch-based dispatch
+  material_table materialTable;
+
+  // Hashes of the scene description each part was loaded from, used by
+  // ReloadScene() to tell what changed: one per loaded object (objects
+  // added or moved by edits have none) and one for everything else
+  std::unordered_map<const hittable *, uint64_t> objectSources;
+  uint64_t settingsSource = 0;
+
+  // Files besides the scene XML that the load read: meshes, MTL libraries,
+  // textures, the HDRI and volume grids
+  std::vector<std::string> sourceFiles;
+
   // Dynamic sky colors (for interactive rendering)
   color skyColorTop{0.5, 0.7, 1.0};    // Sky color at zenith
   color skyColorBottom{1.0, 1.0, 1.0}; // Sky color at horizon
@@ -4,8 +4,13 @@
 #ifdef __APPLE__
 #define GL_SILENCE_DEPRECATION
 #include <OpenGL/gl3.h>
+#elif defined(_WIN32)
+#include <GL/gl.h>
 #else
+// Buffer objects are GL 1.5+; libGL exports them directly on Linux
+#define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
+#include <GL/glext.h>
 #endif
 
 #include <iostream>
@@ -14,13 +19,20 @@ GLTexture::~GLTexture() {
   if (m_RendererID) {
     glDeleteTextures(1, &m_RendererID);
   }
+#ifndef _WIN32
+  if (m_PixelBuffers[0]) {
+    glDeleteBuffers(kPixelBuffers, m_PixelBuffers);
+  }
+#endif
 }
 
 void GLTexture::Init(int width, int height) {
   m_Width = width;
   m_Height = height;
 
-  glGenTextures(1, &m_RendererID);
+  if (!m_RendererID) {
+    glGenTextures(1, &m_RendererID);
+  }
   glBindTexture(GL_TEXTURE_2D, m_RendererID);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -28,10 +40,10 @@ void GLTexture::Init(int width, int height) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-  // Prepare buffer
-  m_Buffer.resize(width * height * 4); // RGBA
+  // Start out black
+  std::vector<unsigned char> black(static_cast<size_t>(width) * height * 4);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, m_Buffer.data());
+               GL_UNSIGNED_BYTE, black.data());
 }
 
 void GLTexture::Update(const std::vector<color> &bitmap, int width,
@@ -43,32 +55,74 @@ void GLTexture::Update(const std::vector<color> &bitmap, int width,
   // Convert Raytracer Color (linear float) to RGBA8 (sRGB)
   // Similar to SaveImage logic but for real-time display
   size_t pixelCount = width * height;
-  if (m_Buffer.size() != pixelCount * 4) {
-    m_Buffer.resize(pixelCount * 4);
-  }
+  UploadRect(0, 0, width, height, [&](unsigned char *dst) {
+    for (size_t i = 0; i < pixelCount; ++i) {
+      color c = bitmap[i];
+
+      // Simple clamp and gamma correction (approximate sqrt)
+      auto r = sqrt(c.x());
+      auto g = sqrt(c.y());
+      auto b = sqrt(c.z());
 
-  for (int i = 0; i < pixelCount; ++i) {
-    color c = bitmap[i];
+      dst[i * 4 + 0] =
+          static_cast<unsigned char>(255.99 * (r < 0 ? 0 : (r > 1 ? 1 : r)));
+      dst[i * 4 + 1] =
+          static_cast<unsigned char>(255.99 * (g < 0 ? 0 : (g > 1 ? 1 : g)));
+      dst[i * 4 + 2] =
+          static_cast<unsigned char>(255.99 * (b < 0 ? 0 : (b > 1 ? 1 : b)));
+      dst[i * 4 + 3] = 255; // Alpha
+    }
+    return true;
+  });
+}
 
-    // Simple clamp and gamma correction (approximate sqrt)
-    auto r = sqrt(c.x());
-    auto g = sqrt(c.y());
-    auto b = sqrt(c.z());
+void GLTexture::UploadRect(
+    int x, int y, int w, int h,
+    const std::function<bool(unsigned char *dst)> &fill) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+#ifdef _WIN32
+  // Buffer objects are not exported by opengl32.lib; upload from client
+  // memory instead, which blocks until the copy is done
+  m_Staging.resize(static_cast<size_t>(w) * h * 4);
+  if (fill(m_Staging.data())) {
+    glBindTexture(GL_TEXTURE_2D, m_RendererID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                    m_Staging.data());
+  }
+#else
+  if (!m_PixelBuffers[0]) {
+    glGenBuffers(kPixelBuffers, m_PixelBuffers);
+  }
 
-    unsigned char rc =
-        static_cast<unsigned char>(255.99 * (r < 0 ? 0 : (r > 1 ? 1 : r)));
-    unsigned char gc =
-        static_cast<unsigned char>(255.99 * (g < 0 ? 0 : (g > 1 ? 1 : g)));
-    unsigned char bc =
-        static_cast<unsigned char>(255.99 * (b < 0 ? 0 : (b > 1 ? 1 : b)));
+  const GLsizeiptr bytes = static_cast<GLsizeiptr>(w) * h * 4;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_PixelBuffers[m_NextPixelBuffer]);
+  m_NextPixelBuffer = (m_NextPixelBuffer + 1) % kPixelBuffers;
 
-    m_Buffer[i * 4 + 0] = rc;
-    m_Buffer[i * 4 + 1] = gc;
-    m_Buffer[i * 4 + 2] = bc;
-    m_Buffer[i * 4 + 3] = 255; // Alpha
+  // Orphan the old storage so mapping never waits for an earlier upload
+  // that is still reading from this buffer
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+  auto *dst = static_cast<unsigned char *>(
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  bool filled = false;
+  if (dst) {
+    filled = fill(dst);
+    // Contents are undefined if the buffer was lost while mapped
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+      filled = false;
+    }
+  } else {
+    std::cerr << "GLTexture: failed to map pixel buffer" << std::endl;
   }
 
-  glBindTexture(GL_TEXTURE_2D, m_RendererID);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA,
-                  GL_UNSIGNED_BYTE, m_Buffer.data());
+  if (filled) {
+    // Sources from the bound buffer; returns without waiting for the copy
+    glBindTexture(GL_TEXTURE_2D, m_RendererID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+                    nullptr);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
 }
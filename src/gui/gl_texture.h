@@ -1,9 +1,16 @@
 #pragma once
 
 #include "../util/vec3.h"
+#include <functional>
 #include <vector>
 
 // Simple wrapper to manage an OpenGL texture
+//
+// Uploads go through a small ring of pixel buffer objects: the caller
+// writes texels straight into a mapped buffer and glTexSubImage2D sources
+// from it, so the copy to the GPU happens asynchronously instead of
+// blocking the UI thread on client memory. On Windows, opengl32 only
+// exports GL 1.1, so uploads source from a client-memory staging buffer.
 class GLTexture {
 public:
   GLTexture() = default;
@@ -11,13 +18,26 @@ public:
 
   void Init(int width, int height);
   void Update(const std::vector<color> &bitmap, int width, int height);
+
+  /**
+   * Upload an RGBA8 rectangle (row 0 at the top). `fill` writes w * h
+   * tightly packed texels to the mapped buffer and returns false to drop
+   * the upload.
+   */
+  void UploadRect(int x, int y, int w, int h,
+                  const std::function<bool(unsigned char *dst)> &fill);
+
   unsigned int GetRendererID() const { return m_RendererID; }
   int GetWidth() const { return m_Width; }
   int GetHeight() const { return m_Height; }
 
 private:
+  static constexpr int kPixelBuffers = 2;
+
   unsigned int m_RendererID{0};
   int m_Width{0};
   int m_Height{0};
-  std::vector<unsigned char> m_Buffer;
+  unsigned int m_PixelBuffers[kPixelBuffers]{};
+  int m_NextPixelBuffer{0};
+  std::vector<unsigned char> m_Staging; // Windows upload path
 };
@@ -1,5 +1,6 @@
 #include "gui_application.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -15,7 +16,9 @@
 #endif
 
 #include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
 
+#include "../engine/aabb.h"
 #include "../engine/camera.h"
 #include "../engine/config.h"
 #include "../engine/factories/factory_methods.h"
@@ -27,6 +30,7 @@ GuiApplication::GuiApplication() {}
 
 GuiApplication::~GuiApplication() {
   StopRender();
+  m_Preview.Stop();
 
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
@@ -79,82 +83,219 @@ bool GuiApplication::Init(int width, int height, const char *title) {
 }
 
 void GuiApplication::ResetAccumulation() {
-  m_SampleCount = 0;
-  m_CurrentRow = 0; // Reset progressive rendering
-  if (!m_AccumulationBuffer.empty()) {
-    std::fill(m_AccumulationBuffer.begin(), m_AccumulationBuffer.end(),
-              color(0, 0, 0));
-  }
-  // Keep old m_Bitmap visible - new render will overwrite it progressively
+  // Applied once per frame by UpdatePreview; the old image stays visible
+  // until the first pass of the new view completes. Camera moves set
+  // m_CameraMoving first; other settings only change shading, so the
+  // preview can keep its primary hits if the camera stays put.
+  m_ViewDirty = true;
+  if (m_CameraMoving)
+    m_CameraDirty = true;
+  else
+    m_SettingsDirty = true;
 }
 
-void GuiApplication::RenderSingleSample() {
-  if (!m_World || !m_World->pcamera)
-    return;
-
+void GuiApplication::ApplyViewSettings(world &w) {
   const int width = m_RenderWidth;
   const int height = m_RenderHeight;
-  const size_t pixelCount =
-      static_cast<size_t>(width) * static_cast<size_t>(height);
+  w.pconfig->IMAGE_WIDTH = width;
+  w.pconfig->IMAGE_HEIGHT = height;
+  w.pconfig->MAX_DEPTH = m_MaxBounces;
 
-  // Safety check: ensure buffers are properly sized
-  if (m_AccumulationBuffer.size() != pixelCount ||
-      m_Bitmap.size() != pixelCount) {
-    return; // Buffers not initialized, skip this frame
-  }
-
-  // Update camera from GUI state
+  // Camera from GUI state
   vec3 lookDir(std::sin(m_CameraRotation.y() * DEG_TO_RAD) *
                    std::cos(m_CameraRotation.x() * DEG_TO_RAD),
                -std::sin(m_CameraRotation.x() * DEG_TO_RAD),
                -std::cos(m_CameraRotation.y() * DEG_TO_RAD) *
                    std::cos(m_CameraRotation.x() * DEG_TO_RAD));
   vec3 lookAt = m_CameraPos + lookDir;
-
-  // Recreate camera with current GUI state
-  m_World->pcamera =
+  w.pcamera =
       std::make_shared<camera>(m_CameraPos, lookAt, vec3(0, 1, 0), m_CameraFOV,
                                (double)width / (double)height);
 
-  // Apply sky colors from GUI to world
-  m_World->skyColorTop =
+  // Sky colors from GUI
+  w.skyColorTop =
       color(m_SkyColorTop.x(), m_SkyColorTop.y(), m_SkyColorTop.z());
-  m_World->skyColorBottom =
+  w.skyColorBottom =
       color(m_SkyColorBottom.x(), m_SkyColorBottom.y(), m_SkyColorBottom.z());
-  m_World->groundColor =
+  w.groundColor =
       color(m_GroundColor.x(), m_GroundColor.y(), m_GroundColor.z());
+}
 
-  // Scattered pixel rendering - render pixels spread across entire image
-  // This gives instant (blurry) preview that refines over time
-  const int pixelsPerFrame =
-      std::max(1000, (int)pixelCount / 20); // ~5% per frame
-
-  static std::mt19937 rng(42);
+void GuiApplication::ApplyEdits(world &w) {
+  ApplyViewSettings(w);
+
+  // Moving an object only refits the scene BVH; meshes keep theirs
+  for (size_t i = 0; i < m_ObjectPlacements.size(); ++i) {
+    ObjectPlacement &p = m_ObjectPlacements[i];
+    if (!p.dirty)
+      continue;
+    const glm::vec3 pivot(p.center.x(), p.center.y(), p.center.z());
+    glm::mat4 m = glm::translate(
+        glm::mat4(1.0f),
+        pivot + glm::vec3(p.offset.x(), p.offset.y(), p.offset.z()));
+    m = glm::rotate(m, (float)p.rotation.y() * DEG_TO_RAD, glm::vec3(0, 1, 0));
+    m = glm::rotate(m, (float)p.rotation.x() * DEG_TO_RAD, glm::vec3(1, 0, 0));
+    m = glm::rotate(m, (float)p.rotation.z() * DEG_TO_RAD, glm::vec3(0, 0, 1));
+    m = glm::scale(m, glm::vec3(p.scale));
+    m = glm::translate(m, -pivot);
+    w.setObjectTransform(i, m);
+    p.dirty = false;
+  }
+}
 
-  for (int i = 0; i < pixelsPerFrame; ++i) {
-    // Pick a random pixel
-    int x = rng() % width;
-    int y = rng() % height;
+void GuiApplication::UpdatePreview() {
+  // Rays are traced by the preview workers; the UI thread only restarts
+  // them after a change and uploads finished tiles. While the camera moves
+  // the preview renders reduced-resolution motion frames, one at a time
+  // with the latest camera; full-resolution accumulation resumes once it
+  // stops, seeded from the previous view if only the camera changed, or
+  // from the cached primary hits if only shading settings did.
+  using ResetMode = render::ProgressiveRenderer::ResetMode;
+  if (m_CameraMoving && m_ViewDirty) {
+    if (!m_Preview.MotionFramePending()) {
+      m_ViewDirty = false;
+      m_PreviewMoving = true;
+      m_Preview.Reset([this](world &w) { ApplyEdits(w); }, ResetMode::Motion);
+    }
+  } else if (m_ViewDirty || (m_PreviewMoving && !m_CameraMoving)) {
+    m_ViewDirty = false;
+    m_PreviewMoving = false;
+    m_Preview.SetMaxSamples(m_RenderSamples);
+    ResetMode mode = ResetMode::Restart;
+    if (m_GeometryDirty)
+      mode = ResetMode::Restart;
+    else if (!m_SettingsDirty)
+      mode = ResetMode::Reproject;
+    else if (!m_CameraDirty)
+      mode = ResetMode::Reshade;
+    m_Preview.Reset([this](world &w) { ApplyEdits(w); }, mode);
+    m_CameraDirty = false;
+    m_SettingsDirty = false;
+    m_GeometryDirty = false;
+  }
+  m_CameraMoving = false;
+
+  // Workers have already converted finished tiles to RGBA8; only the
+  // region that changed since the last frame is uploaded
+  render::ProgressiveRenderer::Rect dirty;
+  int width = 0, height = 0;
+  if (m_Preview.TakeDirty(dirty, width, height)) {
+    if (width != m_Texture.GetWidth() || height != m_Texture.GetHeight()) {
+      m_Texture.Init(width, height);
+      dirty = render::ProgressiveRenderer::Rect{0, 0, width, height};
+    }
+    m_Texture.UploadRect(dirty.x, dirty.y, dirty.w, dirty.h,
+                         [&](unsigned char *dst) {
+                           return m_Preview.ReadDisplay(dirty, width, height,
+                                                        dst);
+                         });
+  }
+  m_SampleCount = m_Preview.Samples();
+}
 
-    color sample = render::RenderPixel(*m_World, x, y, m_SampleCount);
-    size_t idx = (height - 1 - y) * width + x;
+void GuiApplication::ResetObjectPlacements(const world &w) {
+  // Objects pivot about the centre of their loaded bounds
+  m_ObjectPlacements.assign(w.objects.size(), ObjectPlacement());
+  for (size_t i = 0; i < w.objects.size(); ++i) {
+    aabb box;
+    if (w.objects[i]->bounding_box(box))
+      m_ObjectPlacements[i].center = 0.5 * (box.min() + box.max());
+  }
+  m_SelectedObject = 0;
+}
 
-    // Blend new sample with existing (exponential moving average for smooth
-    // updates)
-    double alpha = 1.0 / (m_SampleCount + 1);
-    m_Bitmap[idx] = m_Bitmap[idx] * (1.0 - alpha) + sample * alpha;
-    m_AccumulationBuffer[idx] = m_AccumulationBuffer[idx] + sample;
+bool GuiApplication::LoadPreviewScene() {
+  m_Preview.Stop();
+  // The old scene stays alive while loading, so meshes that did not change
+  // on disk come from the asset cache with their BVH
+  std::shared_ptr<world> loaded = LoadScene(m_ScenePath);
+  if (!loaded) {
+    std::cerr << "Failed to load scene: " << m_ScenePath << std::endl;
+    if (m_World)
+      m_Preview.Start(m_World, m_RenderSamples);
+    return false;
+  }
+  m_World = loaded;
+  m_World->pconfig->SAMPLES_PER_PIXEL = 1; // Interactive uses 1 spp
+
+  // Get camera position from scene
+  if (m_World->pcamera) {
+    m_CameraPos = m_World->pcamera->LOOK_FROM;
+    // Calculate rotation from look direction
+    vec3 lookDir = m_World->pcamera->LOOK_AT - m_World->pcamera->LOOK_FROM;
+    lookDir = unit_vector(lookDir);
+    m_CameraRotation =
+        vec3(std::asin(-lookDir.y()) / DEG_TO_RAD,
+             std::atan2(lookDir.x(), -lookDir.z()) / DEG_TO_RAD, 0);
+    m_CameraFOV = (float)m_World->pcamera->FOV;
   }
 
-  // Track progress
-  m_CurrentRow += pixelsPerFrame;
-  if (m_CurrentRow >= (int)pixelCount) {
-    m_CurrentRow = 0;
-    m_SampleCount++;
+  // Initialize texture
+  m_Texture.Init(m_RenderWidth, m_RenderHeight);
+  m_SampleCount = 0;
+
+  // BVH for fast interactive rendering (built when the preview starts)
+  m_World->pconfig->acceleration = AccelerationMethod::BVH;
+  ApplyViewSettings(*m_World);
+  m_ViewDirty = false;
+  m_CameraDirty = false;
+  m_SettingsDirty = false;
+  m_GeometryDirty = false;
+
+  ResetObjectPlacements(*m_World);
+  WatchScene(*m_World);
+  m_Preview.Start(m_World, m_RenderSamples);
+
+  std::cout << "Scene loaded for interactive preview." << std::endl;
+  return true;
+}
+
+void GuiApplication::WatchScene(const world &w) {
+  std::vector<std::string> paths{m_ScenePath};
+  paths.insert(paths.end(), w.sourceFiles.begin(), w.sourceFiles.end());
+  m_SceneWatcher.watch(paths);
+}
+
+void GuiApplication::CheckSceneFiles() {
+  std::vector<std::string> changed = m_SceneWatcher.poll();
+  if (changed.empty())
+    return;
+
+  // A changed mesh, material library, texture, HDRI or grid needs a full
+  // load; unchanged assets still come from the asset cache
+  if (std::any_of(changed.begin(), changed.end(),
+                  [this](const std::string &p) { return p != m_ScenePath; })) {
+    m_ReloadStatus = LoadPreviewScene() ? "Reloaded scene (asset file changed)"
+                                        : "Scene reload failed";
+    return;
   }
 
-  // Update texture
-  m_Texture.Update(m_Bitmap, width, height);
+  // Only the XML changed: patch the loaded scene in place, keeping the
+  // objects (and BVH nodes) whose description did not change. The view
+  // stays where the user put it.
+  bool reloaded = false;
+  SceneChanges changes;
+  m_Preview.Reset([&](world &w) {
+    reloaded = ReloadScene(w, m_ScenePath, changes);
+    if (reloaded && changes.settings) {
+      w.pconfig->SAMPLES_PER_PIXEL = 1;
+      w.pconfig->acceleration = AccelerationMethod::BVH;
+    }
+    // Edited objects were replaced at their scene placement
+    if (reloaded && (changes.added > 0 || changes.removed > 0))
+      ResetObjectPlacements(w);
+    ApplyEdits(w);
+  });
+  if (!reloaded) {
+    // Usually a save still in progress; the next write triggers again
+    m_ReloadStatus = "Scene reload failed";
+    return;
+  }
+  WatchScene(*m_World);
+  m_ReloadStatus = "Reloaded: " + std::to_string(changes.kept) + " kept, " +
+                   std::to_string(changes.removed) + " removed, " +
+                   std::to_string(changes.added) + " added" +
+                   (changes.settings ? ", settings changed" : "");
 }
 
 void GuiApplication::HandleInput(float deltaTime) {
@@ -224,6 +365,7 @@ void GuiApplication::HandleInput(float deltaTime) {
   }
 
   if (moved) {
+    m_CameraMoving = true;
     ResetAccumulation();
   }
 
@@ -260,6 +402,7 @@ void GuiApplication::HandleInput(float deltaTime) {
       m_CameraRotation =
           vec3(pitch, m_CameraRotation.y(), m_CameraRotation.z());
 
+      m_CameraMoving = true;
       ResetAccumulation();
     }
   } else {
@@ -278,9 +421,11 @@ void GuiApplication::Run() {
     // Handle camera input
     HandleInput(deltaTime);
 
-    // Progressive rendering (if scene loaded and not batch rendering)
+    // Progressive preview (if scene loaded and not batch rendering)
     if (m_World && !m_IsRendering && m_InteractiveMode) {
-      RenderSingleSample();
+      if (m_HotReload)
+        CheckSceneFiles();
+      UpdatePreview();
     }
 
     // Start the Dear ImGui frame
@@ -342,8 +487,41 @@ void GuiApplication::RenderUI() {
     if (ImGui::DragFloat("FOV", &m_CameraFOV, 1.0f, 10.0f, 120.0f)) {
       changed = true;
     }
-    if (changed)
+    if (changed) {
+      m_CameraMoving = true; // Dragging behaves like navigation
+      ResetAccumulation();
+    }
+  }
+
+  // --- Objects Section ---
+  if (!m_ObjectPlacements.empty() && ImGui::CollapsingHeader("Objects")) {
+    const int count = (int)m_ObjectPlacements.size();
+    ImGui::SliderInt("Object", &m_SelectedObject, 0, count - 1);
+    m_SelectedObject = std::clamp(m_SelectedObject, 0, count - 1);
+    ObjectPlacement &p = m_ObjectPlacements[m_SelectedObject];
+
+    bool changed = false;
+    float offset[3] = {(float)p.offset.x(), (float)p.offset.y(),
+                       (float)p.offset.z()};
+    if (ImGui::DragFloat3("Offset", offset, 0.05f)) {
+      p.offset = vec3(offset[0], offset[1], offset[2]);
+      changed = true;
+    }
+    float rot[3] = {(float)p.rotation.x(), (float)p.rotation.y(),
+                    (float)p.rotation.z()};
+    if (ImGui::DragFloat3("Spin", rot, 1.0f)) {
+      p.rotation = vec3(rot[0], rot[1], rot[2]);
+      changed = true;
+    }
+    if (ImGui::DragFloat("Scale", &p.scale, 0.01f, 0.01f, 100.0f)) {
+      changed = true;
+    }
+    if (changed) {
+      p.dirty = true;
+      m_GeometryDirty = true;
+      m_CameraMoving = true; // Dragging renders motion frames too
       ResetAccumulation();
+    }
   }
 
   // --- Render Settings Section ---
@@ -358,8 +536,12 @@ void GuiApplication::RenderUI() {
       changed = true;
     if (ImGui::InputInt("Max Bounces", &m_MaxBounces))
       changed = true;
-    if (changed)
+    if (changed) {
+      m_RenderWidth = std::max(m_RenderWidth, 2);
+      m_RenderHeight = std::max(m_RenderHeight, 2);
+      m_RenderSamples = std::max(m_RenderSamples, 1);
       ResetAccumulation();
+    }
   }
 
   // --- Controls Section ---
@@ -420,46 +602,7 @@ void GuiApplication::RenderUI() {
   } else {
     // Load Scene for interactive preview
     if (ImGui::Button("Load Scene", ImVec2(120, 30))) {
-      m_World = LoadScene(m_ScenePath);
-      if (m_World) {
-        m_World->pconfig->IMAGE_WIDTH = m_RenderWidth;
-        m_World->pconfig->IMAGE_HEIGHT = m_RenderHeight;
-        m_World->pconfig->SAMPLES_PER_PIXEL = 1; // Interactive uses 1 spp
-        m_World->pconfig->MAX_DEPTH = m_MaxBounces;
-
-        // Get camera position from scene
-        if (m_World->pcamera) {
-          m_CameraPos = m_World->pcamera->LOOK_FROM;
-          // Calculate rotation from look direction
-          vec3 lookDir =
-              m_World->pcamera->LOOK_AT - m_World->pcamera->LOOK_FROM;
-          lookDir = unit_vector(lookDir);
-          m_CameraRotation =
-              vec3(std::asin(-lookDir.y()) / DEG_TO_RAD,
-                   std::atan2(lookDir.x(), -lookDir.z()) / DEG_TO_RAD, 0);
-          m_CameraFOV = (float)m_World->pcamera->FOV;
-        }
-
-        // Initialize buffers
-        size_t pixelCount = m_RenderWidth * m_RenderHeight;
-        m_AccumulationBuffer.resize(pixelCount);
-        m_Bitmap.resize(pixelCount);
-        std::fill(m_AccumulationBuffer.begin(), m_AccumulationBuffer.end(),
-                  color(0, 0, 0));
-        std::fill(m_Bitmap.begin(), m_Bitmap.end(), color(0, 0, 0));
-        m_SampleCount = 0;
-
-        // Initialize texture
-        m_Texture.Init(m_RenderWidth, m_RenderHeight);
-
-        // Build BVH for fast interactive rendering
-        m_World->pconfig->acceleration = AccelerationMethod::BVH;
-        m_World->buildBVH();
-
-        std::cout << "Scene loaded for interactive preview." << std::endl;
-      } else {
-        std::cerr << "Failed to load scene: " << m_ScenePath << std::endl;
-      }
+      LoadPreviewScene();
     }
     ImGui::SameLine();
     if (ImGui::Button("Batch Render", ImVec2(120, 30))) {
@@ -467,7 +610,20 @@ void GuiApplication::RenderUI() {
     }
   }
 
+  ImGui::Checkbox("Reload On Save", &m_HotReload);
+  if (ImGui::Checkbox("Denoise Preview", &m_DenoisePreview))
+    m_Preview.SetDenoise(m_DenoisePreview);
+  if (!m_ReloadStatus.empty())
+    ImGui::Text("%s", m_ReloadStatus.c_str());
+
   ImGui::Text("Accumulated Samples: %d", m_SampleCount);
+  if (m_PreviewMoving)
+    ImGui::Text("Motion Preview: 1/%d res, %.1f ms", m_Preview.MotionScale(),
+                m_Preview.LastPassMs());
+  else if (m_Preview.IsRunning())
+    ImGui::Text("Pass Time: %.1f ms", m_Preview.LastPassMs());
+  if (m_DenoisePreview && m_SampleCount > 0)
+    ImGui::Text("Denoise Time: %.1f ms", m_Preview.LastDenoiseMs());
 
   ImGui::End();
 
@@ -500,6 +656,7 @@ void GuiApplication::RenderUI() {
 void GuiApplication::StartRender() {
   if (m_IsRendering)
     return;
+  m_Preview.Stop();
 
   // Load Scene
   m_World = LoadScene(m_ScenePath);
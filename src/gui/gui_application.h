@@ -6,8 +6,10 @@
 #include <thread>
 #include <vector>
 
+#include "../engine/progressive_renderer.h"
 #include "../engine/render_runner.h"
 #include "../engine/world.h"
+#include "../util/file_watcher.h"
 #include "../util/vec3.h"
 #include "gl_texture.h"
 
@@ -24,8 +26,20 @@ public:
 private:
   void RenderUI();
   void HandleInput(float deltaTime);
-  void RenderSingleSample();
+  void UpdatePreview();
   void ResetAccumulation();
+  void ApplyViewSettings(world &w);
+  // View settings plus pending object placements
+  void ApplyEdits(world &w);
+
+  // Load m_ScenePath from scratch and start the interactive preview; on
+  // failure the current scene keeps running
+  bool LoadPreviewScene();
+  // Watch the scene XML and every file the loaded scene was built from
+  void WatchScene(const world &w);
+  // Apply edits saved to the watched files since the last frame
+  void CheckSceneFiles();
+  void ResetObjectPlacements(const world &w);
 
   // Raytracer interaction
   void StartRender();
@@ -39,8 +53,15 @@ private:
   // Raytracer State
   std::shared_ptr<world> m_World;
   std::vector<color> m_Bitmap;
-  std::vector<color> m_AccumulationBuffer;
   int m_SampleCount{0};
+  render::ProgressiveRenderer m_Preview;
+  bool m_ViewDirty{false}; // Camera or settings changed since last reset
+  bool m_CameraMoving{false};  // Camera moved since the last preview update
+  bool m_PreviewMoving{false}; // Last reset rendered a motion frame
+  bool m_CameraDirty{false};   // Camera change since last accumulation
+  bool m_SettingsDirty{false}; // Non-camera change since last accumulation
+  bool m_GeometryDirty{false}; // Object moved since last accumulation
+  bool m_DenoisePreview{false}; // Show finished passes through a-trous
   std::thread m_RenderThread;
   std::atomic<bool> m_IsRendering{false};
   std::atomic<bool> m_CancelFlag{false};
@@ -66,6 +87,22 @@ private:
   double m_LastMouseX{0}, m_LastMouseY{0};
   bool m_FirstMouse{true};
 
+  // Object placements on top of the loaded scene, one per world object
+  struct ObjectPlacement {
+    vec3 center{0, 0, 0}; // Pivot: centre of the loaded bounding box
+    vec3 offset{0, 0, 0};
+    vec3 rotation{0, 0, 0}; // Degrees
+    float scale{1.0f};
+    bool dirty{false}; // Not yet applied to the world
+  };
+  std::vector<ObjectPlacement> m_ObjectPlacements;
+  int m_SelectedObject{0};
+
+  // Scene hot-reload
+  file_watcher m_SceneWatcher;
+  bool m_HotReload{true};
+  std::string m_ReloadStatus;
+
   // Sky Settings
   vec3 m_SkyColorTop{0.5f, 0.7f, 1.0f};
   vec3 m_SkyColorBottom{1.0f, 1.0f, 1.0f};
@@ -81,7 +118,4 @@ private:
 
   // Timing
   float m_LastFrameTime{0};
-
-  // Progressive rendering state
-  int m_CurrentRow{0};
 };
@@ -1,10 +1,12 @@
 #include "defs.h"
 #include "engine/camera.h"
+#include "engine/asset_cache.h"
 #include "engine/config.h"
 #include "engine/factories/factory_methods.h"
 #include "engine/mesh.h"
 #include "engine/render_runner.h"
 #include "engine/sun.h"
+#include "engine/texture_cache.h"
 #include "engine/world.h"
 #include <atomic>
 #include <chrono>
@@ -87,6 +89,10 @@ shared_ptr<world> pworld;
 
 void SaveImage(world &sceneWorld, const string &fileName,
                const vector<color> &bitmap);
+void SaveAOVs(world &sceneWorld, const string &fileName,
+              const render::AOVBuffers &aovs);
+void WriteImage(const string &fileName, int W, int H,
+                const vector<unsigned char> &img);
 // int testObjLoader();
 
 // Logging flags defined in util/logging.cpp
@@ -102,6 +108,10 @@ int main(int argc, char **argv) {
   int samplesOverride = -1;
   bool useBVH = false;
   bool useDenoiser = true;
+  int denoiseIterations = -1;
+  bool writeAOVs = false;
+  string lightSamplingFlag;
+  string materialDispatchFlag;
   const Raytracer::presets::RenderPresetDefinition *presetDefinition = nullptr;
 
   // Simple argv parser
@@ -129,6 +139,20 @@ int main(int argc, char **argv) {
       useDenoiser = false;
     } else if (a == "--denoise") {
       useDenoiser = true;
+    } else if (a == "--denoise-iterations" && i + 1 < argc) {
+      denoiseIterations = atoi(argv[++i]);
+    } else if (a == "--aov") {
+      writeAOVs = true;
+    } else if (a == "--light-sampling" && i + 1 < argc) {
+      lightSamplingFlag = argv[++i];
+    } else if (a == "--material-dispatch" && i + 1 < argc) {
+      materialDispatchFlag = argv[++i];
+    } else if (a == "--no-mesh-cache") {
+      g_use_mesh_cache = false;
+    } else if (a == "--texture-cache" && i + 1 < argc) {
+      const long megabytes = atol(argv[++i]);
+      if (megabytes > 0)
+        texture_cache::instance().set_budget(size_t(megabytes) << 20);
     } else if (a == "--preset" && i + 1 < argc) {
       const std::string presetName = argv[++i];
       presetDefinition = Raytracer::presets::findPreset(presetName);
@@ -145,7 +169,11 @@ int main(int argc, char **argv) {
           << "Usage: Raytracer [--scene <file>] [--out <file>] [--threads N] "
              "[--preset NAME]\n"
           << "                 [--width W] [--samples S] [--bvh|--linear] "
-             "[--no-denoise]\n"
+             "[--no-denoise] [--aov]\n"
+          << "                 [--denoise-iterations N] "
+             "[--light-sampling tree|power]\n"
+          << "                 [--material-dispatch virtual|table]\n"
+          << "                 [--no-mesh-cache] [--texture-cache MB]\n"
           << "Options:\n"
           << "  --scene <file>   Scene XML file (default: objects.xml)\n"
           << "  --out <file>     Output image path (default: build/image.png)\n"
@@ -156,8 +184,24 @@ int main(int argc, char **argv) {
           << "  --bvh            Use BVH acceleration (faster for large "
              "scenes)\n"
           << "  --linear         Use linear traversal\n"
-          << "  --denoise        Enable OIDN AI denoiser (default)\n"
+          << "  --denoise        Enable denoiser (default; OIDN if "
+             "available, else a-trous)\n"
           << "  --no-denoise     Disable denoiser\n"
+          << "  --denoise-iterations N\n"
+          << "                   a-trous filter passes (default: 5)\n"
+          << "  --aov            Also write first-hit albedo, normal and "
+             "depth images\n"
+          << "                   (<out>_albedo, <out>_normal, <out>_depth)\n"
+          << "  --light-sampling tree|power\n"
+          << "                   Light selection for direct lighting "
+             "(default: tree)\n"
+          << "  --material-dispatch virtual|table\n"
+          << "                   Material calls via vtable or packed "
+             "variant table (default: virtual)\n"
+          << "  --no-mesh-cache  Always parse OBJ files (no .rtmesh cache)\n"
+          << "  --texture-cache MB\n"
+          << "                   Resident texture memory budget "
+             "(default: 512)\n"
           << "  --quiet          Suppress progress output\n"
           << "  --verbose        Extra debug output\n";
       return 0;
@@ -216,8 +260,33 @@ int main(int argc, char **argv) {
     pworld->pconfig->acceleration = AccelerationMethod::BVH;
   }
 
-  // Apply denoiser setting
+  // Apply denoiser settings
   pworld->pconfig->enableDenoiser = useDenoiser;
+  if (denoiseIterations > 0) {
+    pworld->pconfig->denoiseIterations = denoiseIterations;
+  }
+
+  // Apply light sampling strategy if requested
+  if (lightSamplingFlag == "tree") {
+    pworld->pconfig->lightSampling = LightSampling::TREE;
+  } else if (lightSamplingFlag == "power") {
+    pworld->pconfig->lightSampling = LightSampling::POWER;
+  } else if (!lightSamplingFlag.empty()) {
+    cerr << "Unknown light sampling '" << lightSamplingFlag
+         << "', expected tree or power" << endl;
+    return 4;
+  }
+
+  // Apply material dispatch mode if requested
+  if (materialDispatchFlag == "virtual") {
+    pworld->pconfig->materialDispatch = MaterialDispatch::VIRTUAL;
+  } else if (materialDispatchFlag == "table") {
+    pworld->pconfig->materialDispatch = MaterialDispatch::TABLE;
+  } else if (!materialDispatchFlag.empty()) {
+    cerr << "Unknown material dispatch '" << materialDispatchFlag
+         << "', expected virtual or table" << endl;
+    return 4;
+  }
 
   vector<color> bitmap;
 
@@ -281,6 +350,22 @@ int main(int argc, char **argv) {
              << s.load_ms << " ms\n";
       }
     }
+    if (!g_mesh_stats.empty()) {
+      double summed_ms = 0.0;
+      for (auto &s : g_mesh_stats)
+        summed_ms += s.load_ms;
+      cerr << "Mesh loading: " << g_mesh_stats.size() << " files in "
+           << g_objects_load_ms << " ms (" << summed_ms << " ms sequential";
+      if (g_objects_load_ms > 0.0)
+        cerr << ", " << summed_ms / g_objects_load_ms << "x";
+      cerr << ")\n";
+      const asset_cache::statistics assets = asset_cache::stats();
+      if (assets.obj_hits + assets.geometry_hits + assets.material_hits > 0) {
+        cerr << "Asset cache: " << assets.geometry_hits << " shared meshes, "
+             << assets.obj_hits << " reused OBJ parses, "
+             << assets.material_hits << " shared materials\n";
+      }
+    }
   }
 
   // Clamp tile_size to a sensible range
@@ -292,7 +377,10 @@ int main(int argc, char **argv) {
   // Time the render
   auto renderStart = std::chrono::high_resolution_clock::now();
 
-  render::RenderSceneToBitmap(*pworld, bitmap, threads, tile_size, tile_debug);
+  render::AOVBuffers aovs;
+  render::RenderSceneToBitmap(*pworld, bitmap, threads, tile_size, tile_debug,
+                              render::TileCallback(), nullptr,
+                              writeAOVs ? &aovs : nullptr);
 
   auto renderEnd = std::chrono::high_resolution_clock::now();
   double renderTimeSeconds =
@@ -304,9 +392,19 @@ int main(int argc, char **argv) {
     cerr << "Total render time: " << std::fixed << std::setprecision(2)
          << renderTimeSeconds << " seconds\n";
     cerr << "Acceleration method: " << (useBVH ? "BVH" : "Linear") << "\n";
+    const texture_cache::statistics textures = texture_cache::instance().stats();
+    if (textures.misses > 0) {
+      cerr << "Texture cache: " << textures.hits << " hits, "
+           << textures.misses << " misses, " << textures.evictions
+           << " evictions, " << textures.resident_tiles << "/"
+           << textures.capacity_tiles << " tiles resident\n";
+    }
   }
 
   SaveImage(*pworld, outPath, bitmap);
+  if (writeAOVs) {
+    SaveAOVs(*pworld, outPath, aovs);
+  }
 
   return 0;
 }
@@ -352,6 +450,61 @@ void SaveImage(world &sceneWorld, const string &fileName,
     }
   }
 
+  WriteImage(fileName, W, H, img);
+
+  std::cerr << "\nDone.\n";
+}
+
+// Feature images next to `fileName`: albedo gamma-encoded like the beauty
+// image, normals mapped from [-1, 1] to [0, 1], depth scaled so the
+// farthest first hit is white
+void SaveAOVs(world &sceneWorld, const string &fileName,
+              const render::AOVBuffers &aovs) {
+  const int W = sceneWorld.GetImageWidth();
+  const int H = sceneWorld.GetImageHeight();
+  const size_t count = static_cast<size_t>(W) * H;
+  if (aovs.albedo.size() != count) {
+    return;
+  }
+  const double scale = 1.0 / sceneWorld.GetSamplesPerPixel();
+
+  double maxDepth = 0.0;
+  for (double d : aovs.depth)
+    maxDepth = std::max(maxDepth, d * scale);
+
+  auto to_byte = [](double v) {
+    return static_cast<unsigned char>(256 * clamp(v, 0.0, 0.999));
+  };
+  vector<unsigned char> albedo, normal, depth;
+  albedo.reserve(count * 3);
+  normal.reserve(count * 3);
+  depth.reserve(count * 3);
+  for (size_t i = 0; i < count; ++i) {
+    const color a = aovs.albedo[i] * scale;
+    const color n = aovs.normal[i] * scale;
+    const double d = maxDepth > 0.0 ? aovs.depth[i] * scale / maxDepth : 0.0;
+    for (int c = 0; c < 3; ++c) {
+      albedo.push_back(to_byte(sqrt(std::max(a[c], 0.0))));
+      normal.push_back(to_byte(0.5 * n[c] + 0.5));
+      depth.push_back(to_byte(d));
+    }
+  }
+
+  // image.png -> image_albedo.png, ...
+  const std::filesystem::path path(fileName);
+  auto sibling = [&path](const string &suffix) {
+    std::filesystem::path p = path;
+    p.replace_filename(path.stem().string() + suffix +
+                       path.extension().string());
+    return p.string();
+  };
+  WriteImage(sibling("_albedo"), W, H, albedo);
+  WriteImage(sibling("_normal"), W, H, normal);
+  WriteImage(sibling("_depth"), W, H, depth);
+}
+
+void WriteImage(const string &fileName, int W, int H,
+                const vector<unsigned char> &img) {
   // If filename ends with .png, write PNG using stbi_write_png, else write PPM
   auto ends_with = [](const string &s, const string &suffix) {
     if (s.size() < suffix.size())
@@ -378,6 +531,5 @@ void SaveImage(world &sceneWorld, const string &fileName,
     if (!g_quiet.load())
       cerr << "Saved PPM to " << fileName << "\n";
   }
-
-  std::cerr << "\nDone.\n";
 }
+
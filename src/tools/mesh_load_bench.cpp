@@ -0,0 +1,227 @@
+// Times OBJ loading on the bundled assets: the parallel obj_reader against
+// the legacy objl::Loader it replaced. glTF/GLB files are timed through
+// gltf_loader.
+//
+//   MeshLoadBench                  all *.obj files in the assets directory
+//   MeshLoadBench a.obj b.glb ...  the given files
+//   MeshLoadBench --no-legacy ...  skip the objl::Loader comparison
+//   MeshLoadBench --synthetic-glb N
+//                                  write and time a GLB with an N-triangle
+//                                  interleaved mesh placed by two nodes
+
+#include "3rdParty/ObjLoader/OBJ_Loader.h"
+#include "engine/gltf_loader.h"
+#include "engine/obj_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef RAYTRACER_ASSET_DIR
+#define RAYTRACER_ASSET_DIR "assets"
+#endif
+
+namespace {
+
+constexpr int kRuns = 3;
+
+template <typename F> double best_of(F &&load) {
+  double best = 1e30;
+  for (int i = 0; i < kRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    if (!load())
+      return -1.0;
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::milli>(end - start)
+                        .count());
+  }
+  return best;
+}
+
+// Grid of `triangles` triangles with POSITION and TEXCOORD_0 interleaved in
+// one buffer view (byteStride 20), instanced by two nodes under a parent
+bool write_synthetic_glb(const std::string &path, size_t triangles) {
+  const size_t side =
+      std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(triangles / 2.0))));
+  const size_t verts = (side + 1) * (side + 1);
+
+  std::vector<float> vertex_data;
+  vertex_data.reserve(verts * 5);
+  for (size_t y = 0; y <= side; y++) {
+    for (size_t x = 0; x <= side; x++) {
+      const float u = float(x) / side, v = float(y) / side;
+      vertex_data.insert(vertex_data.end(),
+                         {u - 0.5f, 0.02f * std::sin(40.0f * u), v - 0.5f, u, v});
+    }
+  }
+  std::vector<uint32_t> index_data;
+  index_data.reserve(triangles * 3);
+  for (size_t y = 0; y < side && index_data.size() < triangles * 3; y++) {
+    for (size_t x = 0; x < side && index_data.size() < triangles * 3; x++) {
+      const uint32_t i = static_cast<uint32_t>(y * (side + 1) + x);
+      const uint32_t row = static_cast<uint32_t>(side + 1);
+      index_data.insert(index_data.end(), {i, i + row, i + 1});
+      if (index_data.size() < triangles * 3)
+        index_data.insert(index_data.end(), {i + 1, i + row, i + row + 1});
+    }
+  }
+
+  const size_t vbytes = vertex_data.size() * sizeof(float);
+  const size_t ibytes = index_data.size() * sizeof(uint32_t);
+  const size_t tris = index_data.size() / 3;
+  std::string json =
+      "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,"
+      "\"scenes\":[{\"nodes\":[0]}],"
+      "\"nodes\":[{\"children\":[1,2],\"translation\":[0,0.5,0]},"
+      "{\"mesh\":0},{\"mesh\":0,\"translation\":[1.5,0,0]}],"
+      "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,"
+      "\"TEXCOORD_0\":1},\"indices\":2}]}],"
+      "\"buffers\":[{\"byteLength\":" + std::to_string(vbytes + ibytes) + "}],"
+      "\"bufferViews\":[{\"buffer\":0,\"byteLength\":" + std::to_string(vbytes) +
+      ",\"byteStride\":20,\"target\":34962},{\"buffer\":0,\"byteOffset\":" +
+      std::to_string(vbytes) + ",\"byteLength\":" + std::to_string(ibytes) +
+      ",\"target\":34963}],"
+      "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":" +
+      std::to_string(verts) +
+      ",\"type\":\"VEC3\",\"min\":[-0.5,-0.02,-0.5],\"max\":[0.5,0.02,0.5]},"
+      "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,"
+      "\"count\":" + std::to_string(verts) + ",\"type\":\"VEC2\"},"
+      "{\"bufferView\":1,\"componentType\":5125,\"count\":" +
+      std::to_string(tris * 3) + ",\"type\":\"SCALAR\"}]}";
+  while (json.size() % 4)
+    json += ' ';
+
+  std::ofstream out(path, std::ios::binary);
+  auto put32 = [&](uint32_t v) {
+    out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+  };
+  const uint32_t total = 12 + 8 + static_cast<uint32_t>(json.size()) + 8 +
+                         static_cast<uint32_t>(vbytes + ibytes);
+  put32(0x46546C67); // "glTF"
+  put32(2);
+  put32(total);
+  put32(static_cast<uint32_t>(json.size()));
+  put32(0x4E4F534A); // "JSON"
+  out.write(json.data(), json.size());
+  put32(static_cast<uint32_t>(vbytes + ibytes));
+  put32(0x004E4942); // "BIN"
+  out.write(reinterpret_cast<const char *>(vertex_data.data()), vbytes);
+  out.write(reinterpret_cast<const char *>(index_data.data()), ibytes);
+  return static_cast<bool>(out);
+}
+
+void bench_gltf(const std::vector<std::string> &files, int &failures) {
+  std::printf("%-40s %10s %10s %12s\n", "file", "triangles", "instances",
+              "gltf_loader");
+  for (const auto &file : files) {
+    gltf_loader::LoadResult result;
+    // The loader reports progress on stderr; keep the table readable
+    std::streambuf *cerr_buf = std::cerr.rdbuf(nullptr);
+    double ms = best_of([&] {
+      result = gltf_loader::load(file);
+      return result.success;
+    });
+    std::cerr.rdbuf(cerr_buf);
+    if (ms < 0.0) {
+      std::cerr << file << ": " << result.error << std::endl;
+      failures++;
+      continue;
+    }
+    std::printf("%-40s %10zu %10zu %9.1f ms\n",
+                std::filesystem::path(file).filename().string().c_str(),
+                result.triangle_count, result.instance_count, ms);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool legacy = true;
+  std::vector<std::string> files, gltf_files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--no-legacy") {
+      legacy = false;
+    } else if (arg == "--synthetic-glb" && i + 1 < argc) {
+      const size_t triangles = std::strtoull(argv[++i], nullptr, 10);
+      const std::string path =
+          (std::filesystem::temp_directory_path() /
+           ("synthetic_" + std::to_string(triangles) + ".glb"))
+              .string();
+      if (!write_synthetic_glb(path, triangles)) {
+        std::cerr << "Could not write " << path << std::endl;
+        return 1;
+      }
+      gltf_files.push_back(path);
+    } else if (gltf_loader::is_gltf_file(arg)) {
+      gltf_files.push_back(arg);
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  int failures = 0;
+  if (!gltf_files.empty()) {
+    bench_gltf(gltf_files, failures);
+    if (files.empty())
+      return failures == 0 ? 0 : 1;
+  }
+
+  if (files.empty()) {
+    std::error_code ec;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(RAYTRACER_ASSET_DIR, ec)) {
+      if (entry.path().extension() == ".obj")
+        files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+  }
+
+  if (files.empty()) {
+    std::cerr << "No .obj files found" << std::endl;
+    return 1;
+  }
+
+  std::printf("%-40s %10s %10s %12s %12s\n", "file", "triangles", "vertices",
+              "obj_reader", "objl");
+
+  for (const auto &file : files) {
+    obj_mesh_data data;
+    std::string error;
+    double t_new = best_of([&] { return obj_reader::load(file, data, error); });
+    if (t_new < 0.0) {
+      std::cerr << file << ": " << error << std::endl;
+      failures++;
+      continue;
+    }
+
+    double t_old = -1.0;
+    if (legacy) {
+      // objl::Loader reports progress on stdout; keep the table readable
+      std::streambuf *cout_buf = std::cout.rdbuf(nullptr);
+      t_old = best_of([&] {
+        objl::Loader loader;
+        return loader.LoadFile(file);
+      });
+      std::cout.rdbuf(cout_buf);
+    }
+
+    char old_ms[32] = "-";
+    if (t_old >= 0.0)
+      std::snprintf(old_ms, sizeof(old_ms), "%.1f ms", t_old);
+
+    std::printf("%-40s %10zu %10zu %9.1f ms %12s\n",
+                std::filesystem::path(file).filename().string().c_str(),
+                data.triangle_count(), data.vertex_count(), t_new, old_ms);
+  }
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Times image_texture lookups: bilinear value() and trilinear
+// filtered_value(), both at random coordinates (memory bound) and along
+// scanlines a fraction of a texel apart (what neighbouring pixels of a
+// render do), on a synthetic texture or the given images.
+//
+//   TextureBench                 2048x2048 synthetic sRGB texture
+//   TextureBench image.png ...   the given images
+//   TextureBench --linear ...    declare the images linear instead of sRGB
+//   TextureBench --lookups N     lookups per run (default 4M)
+
+#include "3rdParty/stb_image_write.h"
+#include "engine/image_texture.h"
+#include "engine/texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kRuns = 3;
+
+template <typename F> double best_of(F &&run) {
+  double best = 1e30;
+  for (int i = 0; i < kRuns; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::milli>(end - start)
+                        .count());
+  }
+  return best;
+}
+
+// Colored 32x32 blocks with a per-texel ramp, so neighbouring lookups differ
+std::string write_synthetic_png(int size) {
+  std::vector<unsigned char> rgb(size_t(size) * size * 3);
+  std::mt19937 rng(7);
+  std::vector<unsigned char> blocks(size_t(size / 32 + 1) * (size / 32 + 1) *
+                                    3);
+  for (auto &b : blocks)
+    b = static_cast<unsigned char>(rng() & 0xff);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const unsigned char *b =
+          &blocks[(size_t(y / 32) * (size / 32 + 1) + x / 32) * 3];
+      unsigned char *p = &rgb[(size_t(y) * size + x) * 3];
+      for (int c = 0; c < 3; c++)
+        p[c] = static_cast<unsigned char>((b[c] + (x ^ y)) & 0xff);
+    }
+  }
+  const std::string path =
+      (std::filesystem::temp_directory_path() /
+       ("texture_bench_" + std::to_string(size) + ".png"))
+          .string();
+  if (!stbi_write_png(path.c_str(), size, size, 3, rgb.data(), size * 3))
+    return std::string();
+  return path;
+}
+
+void bench(const std::string &path, color_space space, size_t lookups) {
+  image_texture tex(path, space);
+  if (!tex.is_valid())
+    return;
+
+  // u, v, footprint per lookup
+  std::vector<double> random(lookups * 3), coherent(lookups * 3);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  const double texel = 1.0 / tex.get_width();
+  for (size_t i = 0; i < lookups; i++) {
+    random[i * 3] = unit(rng);
+    random[i * 3 + 1] = unit(rng);
+    // Footprints from a quarter texel up to a quarter of the texture
+    random[i * 3 + 2] =
+        std::exp2(-std::log2(double(tex.get_width())) * unit(rng) - 2.0);
+
+    const double s = i * 0.37 * texel;
+    coherent[i * 3] = s - std::floor(s);
+    coherent[i * 3 + 1] = std::floor(s) * 0.37 * texel;
+    coherent[i * 3 + 2] = 1.5 * texel;
+  }
+
+  // First lookup builds the tile file; keep it out of the timings
+  tex.value(0.5, 0.5, point3());
+
+  std::printf("%s (%dx%d, %s)\n", path.c_str(), tex.get_width(),
+              tex.get_height(),
+              space == color_space::srgb ? "sRGB" : "linear");
+  double sink = 0.0;
+  for (const auto *pattern : {&random, &coherent}) {
+    const std::vector<double> &c = *pattern;
+    const double bilinear_ms = best_of([&] {
+      for (size_t i = 0; i < lookups; i++)
+        sink += tex.value(c[i * 3], c[i * 3 + 1], point3()).x();
+    });
+    const double trilinear_ms = best_of([&] {
+      for (size_t i = 0; i < lookups; i++)
+        sink += tex.filtered_value(c[i * 3], c[i * 3 + 1], point3(),
+                                   c[i * 3 + 2])
+                    .x();
+    });
+    const char *label = pattern == &random ? "random" : "coherent";
+    std::printf("  %-9s bilinear  %8.2f ns/lookup\n", label,
+                bilinear_ms * 1e6 / lookups);
+    std::printf("  %-9s trilinear %8.2f ns/lookup\n", label,
+                trilinear_ms * 1e6 / lookups);
+  }
+
+  const auto stats = texture_cache::instance().stats();
+  std::printf("  cache     %llu hits, %llu misses (checksum %.3f)\n",
+              static_cast<unsigned long long>(stats.hits),
+              static_cast<unsigned long long>(stats.misses), sink);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> files;
+  color_space space = color_space::srgb;
+  size_t lookups = size_t(4) << 20;
+  for (int i = 1; i < argc; i++) {
+    const std::string a = argv[i];
+    if (a == "--linear") {
+      space = color_space::linear;
+    } else if (a == "--lookups" && i + 1 < argc) {
+      lookups = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+    } else {
+      files.push_back(a);
+    }
+  }
+  if (files.empty()) {
+    const std::string synthetic = write_synthetic_png(2048);
+    if (synthetic.empty()) {
+      std::fprintf(stderr, "Could not write synthetic texture\n");
+      return 1;
+    }
+    files.push_back(synthetic);
+  }
+
+  for (const auto &file : files)
+    bench(file, space, lookups);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "util/file_watcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+void stat_file(const std::string &path, uintmax_t &size, int64_t &mtime) {
+  std::error_code ec;
+  size = fs::file_size(path, ec);
+  if (ec) {
+    size = 0;
+    mtime = 0;
+    return;
+  }
+  auto time = fs::last_write_time(path, ec);
+  mtime = ec ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+} // namespace
+
+file_watcher::file_watcher() {
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+file_watcher::~file_watcher() {
+  close_watches();
+#ifdef __linux__
+  if (inotify_fd >= 0)
+    ::close(inotify_fd);
+#endif
+}
+
+void file_watcher::close_watches() {
+#ifdef __linux__
+  for (const auto &watch : directory_watches)
+    inotify_rm_watch(inotify_fd, watch.first);
+  directory_watches.clear();
+#endif
+  files.clear();
+}
+
+void file_watcher::watch(const std::vector<std::string> &paths) {
+  close_watches();
+  for (const auto &path : paths) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    if (ec)
+      continue;
+    watched_file file;
+    file.path = path;
+    file.directory = absolute.parent_path().lexically_normal().string();
+    file.name = absolute.filename().string();
+    stat_file(path, file.size, file.mtime);
+    files.push_back(file);
+
+#ifdef __linux__
+    if (inotify_fd < 0)
+      continue;
+    bool watched = std::any_of(
+        directory_watches.begin(), directory_watches.end(),
+        [&](const auto &watch) { return watch.second == file.directory; });
+    if (!watched) {
+      int wd = inotify_add_watch(inotify_fd, file.directory.c_str(),
+                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE);
+      if (wd >= 0)
+        directory_watches.emplace_back(wd, file.directory);
+    }
+#endif
+  }
+}
+
+std::vector<std::string> file_watcher::poll() {
+  std::vector<std::string> changed;
+  auto report = [&changed](const watched_file &file) {
+    if (std::find(changed.begin(), changed.end(), file.path) == changed.end())
+      changed.push_back(file.path);
+  };
+
+#ifdef __linux__
+  if (inotify_fd >= 0) {
+    // Drain every pending event; names are relative to the watched directory
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = ::read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+      for (char *p = buffer; p < buffer + length;) {
+        const auto *event = reinterpret_cast<const inotify_event *>(p);
+        p += sizeof(inotify_event) + event->len;
+        if (event->len == 0)
+          continue;
+        auto dir = std::find_if(
+            directory_watches.begin(), directory_watches.end(),
+            [&](const auto &watch) { return watch.first == event->wd; });
+        if (dir == directory_watches.end())
+          continue;
+        for (const auto &file : files) {
+          if (file.directory == dir->second && file.name == event->name)
+            report(file);
+        }
+      }
+    }
+    return changed;
+  }
+#endif
+
+  for (auto &file : files) {
+    uintmax_t size;
+    int64_t mtime;
+    stat_file(file.path, size, mtime);
+    if (size != file.size || mtime != file.mtime) {
+      file.size = size;
+      file.mtime = mtime;
+      report(file);
+    }
+  }
+  return changed;
+}
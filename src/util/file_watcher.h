@@ -0,0 +1,51 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reports when any of a set of files is written, replaced or removed
+ *
+ * On Linux the parent directories are watched with inotify, so editors that
+ * save through a temporary file and a rename are seen as well. Other
+ * platforms fall back to comparing each file's size and modification time
+ * when polled.
+ */
+class file_watcher {
+public:
+  file_watcher();
+  ~file_watcher();
+
+  file_watcher(const file_watcher &) = delete;
+  file_watcher &operator=(const file_watcher &) = delete;
+
+  // Replace the watched set; changes before this call are forgotten
+  void watch(const std::vector<std::string> &paths);
+
+  /**
+   * @brief Watched files that changed since the last call (non-blocking)
+   * @return Paths as passed to watch(), each at most once
+   */
+  std::vector<std::string> poll();
+
+private:
+  struct watched_file {
+    std::string path;
+    std::string directory; // Absolute parent directory
+    std::string name;      // File name within `directory`
+    uintmax_t size = 0;
+    int64_t mtime = 0;
+  };
+
+  void close_watches();
+
+  std::vector<watched_file> files;
+#ifdef __linux__
+  int inotify_fd = -1;
+  std::vector<std::pair<int, std::string>> directory_watches;
+#endif
+};
+
+#endif
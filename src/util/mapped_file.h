@@ -0,0 +1,89 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Read-only view of a whole file
+ *
+ * Uses mmap on POSIX systems so large assets are paged in on demand and
+ * can be used in place; other platforms fall back to reading the file into
+ * an owned buffer.
+ */
+class mapped_file {
+public:
+  explicit mapped_file(const std::string &filename) {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+      if (st.st_size == 0) {
+        bytes = "";
+      } else {
+        const size_t size = static_cast<size_t>(st.st_size);
+        void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+          mapping = p;
+          bytes = static_cast<const char *>(p);
+          length = size;
+        }
+      }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+      return;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    buffer = ss.str();
+    bytes = buffer.data();
+    length = buffer.size();
+#endif
+  }
+
+  ~mapped_file() {
+#ifndef _WIN32
+    if (mapping)
+      ::munmap(mapping, length);
+#endif
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  bool valid() const { return bytes != nullptr; }
+  const char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+  // Hint that the file will be read front to back (no-op without mmap)
+  void advise_sequential() const {
+#ifndef _WIN32
+    if (mapping)
+      ::madvise(mapping, length, MADV_SEQUENTIAL);
+#endif
+  }
+
+private:
+  const char *bytes = nullptr;
+  size_t length = 0;
+#ifndef _WIN32
+  void *mapping = nullptr;
+#else
+  std::string buffer;
+#endif
+};
+
+#endif
@@ -0,0 +1,75 @@
+// Checks that emitters moved through world::setObjectTransform stay
+// registered as lights, also when they sit inside nested transform wrappers.
+// Exits non-zero on the first failed check.
+
+#include "engine/emissive.h"
+#include "engine/quad.h"
+#include "engine/translate.h"
+#include "engine/world.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+// Shoot a ray down -z from (x, 0, 10) and return the light it hits, or -1
+int light_hit_at(const world &w, double x) {
+  hit_record rec;
+  ray r(point3(x, 0, 10), vec3(0, 0, -1));
+  if (!w.hit(r, 0.001, 1e9, rec))
+    return -2;
+  return w.lightIndexOf(rec.object);
+}
+
+} // namespace
+
+int main() {
+  // 2x2 emissive quad centred on the z axis, moved back by a translate
+  auto light = std::make_shared<emissive>(color(4, 4, 4));
+  auto panel = std::make_shared<quad>(point3(-1, -1, 0), vec3(2, 0, 0),
+                                      vec3(0, 2, 0), light);
+  world w;
+  w.objects.push_back(std::make_shared<translate>(panel, vec3(0, 0, -5)));
+  w.buildLights();
+
+  check(w.lights.size() == 1, "one emitter before the edit");
+  check(light_hit_at(w, 0.0) == 0, "hit on the translated emitter is a light");
+
+  // Keep the first placed copy alive so a new copy cannot reuse its address
+  // and hide a stale lookup
+  std::shared_ptr<hittable> first_copy;
+  if (!w.lights.empty())
+    first_copy = w.lights[0].emitter;
+
+  // Wraps the translate in an instance; the translate is now nested
+  w.setObjectTransform(0, glm::translate(glm::mat4(1.0f),
+                                         glm::vec3(3.0f, 0.0f, 0.0f)));
+  check(w.lights.size() == 1, "one emitter after the move");
+  check(light_hit_at(w, 0.0) == -2, "old placement is empty");
+  check(light_hit_at(w, 3.0) == 0, "hit on the moved emitter is a light");
+
+  // Moving the same wrapper again must keep the lookup current
+  w.setObjectTransform(0, glm::translate(glm::mat4(1.0f),
+                                         glm::vec3(-3.0f, 0.0f, 0.0f)));
+  check(light_hit_at(w, -3.0) == 0, "hit after a second move is a light");
+  if (!w.lights.empty()) {
+    const aabb &box = w.lights[0].bounds;
+    check(box.min().x() < -3.0 && box.max().x() > -3.0,
+          "sampled copy follows the move");
+  }
+
+  if (failures == 0)
+    std::printf("world edit tests passed\n");
+  return failures == 0 ? 0 : 1;
+}